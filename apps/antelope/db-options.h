@@ -152,6 +152,18 @@
 #define DB_MAX_CHAR_SIZE_PER_ROW	64
 #endif /* DB_MAX_CHAR_SIZE_PER_ROW */
 
+/* The size of each buffer used for reading rows in blocks. A value of
+   0 disables row buffering. */
+#ifndef DB_READ_BUFFER_SIZE
+#define DB_READ_BUFFER_SIZE		128
+#endif /* DB_READ_BUFFER_SIZE */
+
+/* The number of relations that can be scanned through read buffers at
+   the same time. A join needs two. */
+#ifndef DB_READ_BUFFER_COUNT
+#define DB_READ_BUFFER_COUNT		2
+#endif /* DB_READ_BUFFER_COUNT */
+
 /* The maximum file name length to use for creating various database file. */
 #ifndef DB_MAX_FILENAME_LENGTH
 #define DB_MAX_FILENAME_LENGTH		16
@@ -208,6 +220,26 @@
 
 /*----------------------------------------------------------------------------*/
 
+/* Join options. */
+
+/* The number of tuples that the hash join keeps in memory at a time. */
+#ifndef DB_JOIN_HASH_SIZE
+#define DB_JOIN_HASH_SIZE		32
+#endif /* DB_JOIN_HASH_SIZE */
+
+/* The number of buckets in the hash join table. */
+#ifndef DB_JOIN_HASH_BUCKETS
+#define DB_JOIN_HASH_BUCKETS		16
+#endif /* DB_JOIN_HASH_BUCKETS */
+
+/* The maximum number of partitions that the hash join writes to
+   storage when the right relation does not fit in the hash table. */
+#ifndef DB_JOIN_MAX_PARTITIONS
+#define DB_JOIN_MAX_PARTITIONS		8
+#endif /* DB_JOIN_MAX_PARTITIONS */
+
+/*----------------------------------------------------------------------------*/
+
 /* LVM options. */
 
 /* The maximum length of a variable in LVM. This value should preferably
@@ -79,6 +79,76 @@ struct source_map {
 };
 
 static struct source_map source_map[AQL_ATTRIBUTE_LIMIT];
+
+/*
+ * The join methods. The index join looks up each row of the left
+ * relation in an index of the right relation. The hash join and the
+ * merge join need no index, but only work on integer attributes. The
+ * merge join also requires both relations to be ordered by the join
+ * attribute, which is the case when the attribute has an inline index.
+ */
+#define JOIN_METHOD_INDEX	0
+#define JOIN_METHOD_HASH	1
+#define JOIN_METHOD_MERGE	2
+
+#define JOIN_NO_ENTRY		0xff
+
+#if DB_JOIN_HASH_SIZE >= JOIN_NO_ENTRY
+#error "DB_JOIN_HASH_SIZE must be less than 255."
+#endif
+
+struct join_pair {
+  long key;
+  tuple_id_t tuple_id;
+};
+
+/*
+ * A join source produces the join attribute value and the tuple ID of
+ * each row, either by reading the rows of a relation or by reading a
+ * range of pairs from a partition file.
+ */
+struct join_source {
+  relation_t *rel;
+  attribute_t *attr;
+  unsigned char *row;
+  db_storage_id_t fd;
+  tuple_id_t start;
+  tuple_id_t end;
+  tuple_id_t next;
+};
+
+struct hash_join {
+  struct join_pair entries[DB_JOIN_HASH_SIZE];
+  uint8_t chain[DB_JOIN_HASH_SIZE];
+  uint8_t buckets[DB_JOIN_HASH_BUCKETS];
+  struct join_source build;
+  struct join_source probe;
+  struct join_pair probe_pair;
+  uint8_t probe_entry;
+  uint8_t partition;
+  uint8_t partitions;
+  tuple_id_t left_start[DB_JOIN_MAX_PARTITIONS + 1];
+  tuple_id_t right_start[DB_JOIN_MAX_PARTITIONS + 1];
+};
+
+struct merge_join {
+  long left_key;
+  tuple_id_t left_id;
+  tuple_id_t right_id;
+  tuple_id_t run_start;
+  uint8_t in_run;
+  uint8_t need_left;
+};
+
+static uint8_t join_method;
+static union {
+  struct hash_join hash;
+  struct merge_join merge;
+} join_state;
+
+/* The partition files of the hash join. */
+static db_storage_id_t join_fd[2] = {-1, -1};
+static char join_file[2][DB_MAX_FILENAME_LENGTH];
 #endif /* DB_FEATURE_JOIN */
 
 static unsigned char row[DB_MAX_ATTRIBUTES_PER_RELATION * DB_MAX_ELEMENT_SIZE];
@@ -959,6 +1029,380 @@ relation_select(void *handle_ptr, relation_t *rel, void *adt_ptr)
 }
 
 #if DB_FEATURE_JOIN
+static db_result_t
+emit_join_row(db_handle_t *handle)
+{
+  relation_t *join_rel;
+  unsigned char *join_next_attribute_ptr;
+  size_t element_size;
+  int i;
+
+  join_rel = handle->join_rel;
+
+  /* Use the source attribute map to fill in the physical representation
+     of the resulting tuple. */
+  join_next_attribute_ptr = join_row;
+
+  for(i = 0; i < join_rel->attribute_count; i++) {
+    element_size = source_map[i].attr->element_size;
+
+    memcpy(join_next_attribute_ptr, source_map[i].from_ptr, element_size);
+    join_next_attribute_ptr += element_size;
+  }
+
+  if(((aql_adt_t *)handle->adt)->flags & AQL_FLAG_ASSIGN) {
+    if(DB_ERROR(storage_put_row(join_rel, join_row))) {
+      return DB_STORAGE_ERROR;
+    }
+  }
+
+  handle->current_row++;
+  return DB_GOT_ROW;
+}
+
+static db_result_t
+get_join_key(relation_t *rel, attribute_t *attr, tuple_id_t tuple_id,
+             unsigned char *row_ptr, long *key)
+{
+  attribute_value_t value;
+  db_result_t result;
+
+  result = storage_get_row(rel, &tuple_id, row_ptr);
+  if(result != DB_OK) {
+    return result;
+  }
+
+  if(DB_ERROR(relation_get_value(rel, attr, row_ptr, &value))) {
+    PRINTF("DB: Failed to get a value of the attribute \"%s\" to join on\n",
+	   attr->name);
+    return DB_IMPLEMENTATION_ERROR;
+  }
+  *key = db_value_to_long(&value);
+
+  return DB_OK;
+}
+
+static db_result_t
+join_source_next(struct join_source *source, struct join_pair *pair)
+{
+  db_result_t result;
+
+  if(source->fd < 0) {
+    result = get_join_key(source->rel, source->attr, source->next,
+                          source->row, &pair->key);
+    if(result != DB_OK) {
+      return result;
+    }
+    pair->tuple_id = source->next++;
+    return DB_OK;
+  }
+
+  if(source->next >= source->end) {
+    return DB_FINISHED;
+  }
+
+  if(DB_ERROR(storage_read(source->fd, pair,
+                           (unsigned long)source->next * sizeof(*pair),
+                           sizeof(*pair)))) {
+    return DB_STORAGE_ERROR;
+  }
+  source->next++;
+
+  return DB_OK;
+}
+
+static unsigned
+join_partition(long key)
+{
+  return crc16_data((unsigned char *)&key, sizeof(key), 0) %
+         join_state.hash.partitions;
+}
+
+static void
+join_cleanup(void)
+{
+  int i;
+
+  for(i = 0; i < 2; i++) {
+    if(join_fd[i] >= 0) {
+      storage_close(join_fd[i]);
+      join_fd[i] = -1;
+    }
+    if(join_file[i][0] != '\0') {
+      storage_remove(join_file[i]);
+      join_file[i][0] = '\0';
+    }
+  }
+}
+
+/*
+ * Write the join pairs of a relation to a file, grouped by partition.
+ * The first pass counts the pairs of each partition, so that the second
+ * pass can write each pair directly to its place in the file.
+ */
+static db_result_t
+partition_relation(struct join_source *source, tuple_id_t *start, int side)
+{
+  struct join_pair pair;
+  tuple_id_t fill[DB_JOIN_MAX_PARTITIONS];
+  unsigned partitions;
+  unsigned i;
+  char *filename;
+  db_result_t result;
+
+  partitions = join_state.hash.partitions;
+  memset(start, 0, (partitions + 1) * sizeof(*start));
+
+  source->next = 0;
+  while((result = join_source_next(source, &pair)) == DB_OK) {
+    start[join_partition(pair.key) + 1]++;
+  }
+  if(DB_ERROR(result)) {
+    return result;
+  }
+
+  for(i = 1; i <= partitions; i++) {
+    start[i] += start[i - 1];
+  }
+
+  filename = storage_generate_file("join",
+                                   (start[partitions] + 1) * sizeof(pair));
+  if(filename == NULL) {
+    return DB_STORAGE_ERROR;
+  }
+  strncpy(join_file[side], filename, sizeof(join_file[side]) - 1);
+
+  join_fd[side] = storage_open(join_file[side]);
+  if(join_fd[side] < 0) {
+    return DB_STORAGE_ERROR;
+  }
+
+  memcpy(fill, start, partitions * sizeof(*start));
+
+  source->next = 0;
+  while((result = join_source_next(source, &pair)) == DB_OK) {
+    i = join_partition(pair.key);
+    if(DB_ERROR(storage_write(join_fd[side], &pair,
+                              (unsigned long)fill[i]++ * sizeof(pair),
+                              sizeof(pair)))) {
+      return DB_STORAGE_ERROR;
+    }
+  }
+
+  PRINTF("DB: Wrote %lu join pairs of %s in %u partitions\n",
+	 (unsigned long)start[partitions], source->rel->name, partitions);
+
+  return DB_ERROR(result) ? result : DB_OK;
+}
+
+static void
+hash_join_select_partition(void)
+{
+  struct hash_join *hj;
+
+  hj = &join_state.hash;
+
+  hj->build.fd = join_fd[1];
+  hj->build.start = hj->build.next = hj->right_start[hj->partition];
+  hj->build.end = hj->right_start[hj->partition + 1];
+
+  hj->probe.fd = join_fd[0];
+  hj->probe.start = hj->probe.next = hj->left_start[hj->partition];
+  hj->probe.end = hj->left_start[hj->partition + 1];
+}
+
+/*
+ * Fill the hash table with the next chunk of pairs from the right
+ * side, moving on to the next partition when the current one has been
+ * consumed, and rewind the left side for probing.
+ */
+static db_result_t
+hash_join_build(void)
+{
+  struct hash_join *hj;
+  struct join_pair *entry;
+  unsigned count;
+  unsigned bucket;
+  db_result_t result;
+
+  hj = &join_state.hash;
+
+  for(;;) {
+    memset(hj->buckets, JOIN_NO_ENTRY, sizeof(hj->buckets));
+    for(count = 0; count < DB_JOIN_HASH_SIZE; count++) {
+      entry = &hj->entries[count];
+      result = join_source_next(&hj->build, entry);
+      if(DB_ERROR(result)) {
+        return result;
+      } else if(result == DB_FINISHED) {
+        break;
+      }
+      bucket = (unsigned long)entry->key % DB_JOIN_HASH_BUCKETS;
+      hj->chain[count] = hj->buckets[bucket];
+      hj->buckets[bucket] = count;
+    }
+
+    if(count > 0) {
+      hj->probe.next = hj->probe.start;
+      hj->probe_entry = JOIN_NO_ENTRY;
+      return DB_OK;
+    }
+
+    if(++hj->partition >= hj->partitions) {
+      join_cleanup();
+      return DB_FINISHED;
+    }
+    hash_join_select_partition();
+  }
+}
+
+static db_result_t
+hash_join_prepare(db_handle_t *handle, unsigned partitions)
+{
+  struct hash_join *hj;
+  db_result_t result;
+
+  hj = &join_state.hash;
+
+  hj->build.rel = handle->right_rel;
+  hj->build.attr = handle->right_join_attr;
+  hj->build.row = right_row;
+  hj->build.fd = -1;
+  hj->build.start = hj->build.next = 0;
+
+  hj->probe.rel = handle->left_rel;
+  hj->probe.attr = handle->left_join_attr;
+  hj->probe.row = left_row;
+  hj->probe.fd = -1;
+  hj->probe.start = hj->probe.next = 0;
+
+  hj->partition = 0;
+  hj->partitions = partitions;
+
+  if(hj->partitions > 1) {
+    /* The right relation does not fit in memory, so both relations
+       are split into partitions that are joined one at a time. */
+    result = partition_relation(&hj->build, hj->right_start, 1);
+    if(!DB_ERROR(result)) {
+      result = partition_relation(&hj->probe, hj->left_start, 0);
+    }
+    if(DB_ERROR(result)) {
+      join_cleanup();
+      return result;
+    }
+    hash_join_select_partition();
+  }
+
+  result = hash_join_build();
+  return result == DB_FINISHED ? DB_OK : result;
+}
+
+static db_result_t
+hash_join_next(db_handle_t *handle)
+{
+  struct hash_join *hj;
+  struct join_pair *entry;
+  db_result_t result;
+
+  hj = &join_state.hash;
+  if(hj->partition >= hj->partitions) {
+    return DB_FINISHED;
+  }
+
+  for(;;) {
+    /* Emit the remaining matches of the current left row. */
+    while(hj->probe_entry != JOIN_NO_ENTRY) {
+      entry = &hj->entries[hj->probe_entry];
+      hj->probe_entry = hj->chain[hj->probe_entry];
+      if(entry->key != hj->probe_pair.key) {
+        continue;
+      }
+
+      result = storage_get_row(handle->left_rel,
+                               &hj->probe_pair.tuple_id, left_row);
+      if(result == DB_OK) {
+        result = storage_get_row(handle->right_rel, &entry->tuple_id,
+                                 right_row);
+      }
+      if(result != DB_OK) {
+        PRINTF("DB: The join refers to an invalid row\n");
+        return DB_ERROR(result) ? result : DB_IMPLEMENTATION_ERROR;
+      }
+
+      return emit_join_row(handle);
+    }
+
+    result = join_source_next(&hj->probe, &hj->probe_pair);
+    if(result == DB_OK) {
+      hj->probe_entry = hj->buckets[(unsigned long)hj->probe_pair.key %
+                                    DB_JOIN_HASH_BUCKETS];
+      continue;
+    } else if(DB_ERROR(result)) {
+      return result;
+    }
+
+    /* The left side has been probed against the current chunk. */
+    result = hash_join_build();
+    if(result != DB_OK) {
+      return result;
+    }
+  }
+}
+
+static db_result_t
+merge_join_next(db_handle_t *handle)
+{
+  struct merge_join *mj;
+  long key;
+  db_result_t result;
+
+  mj = &join_state.merge;
+
+  for(;;) {
+    if(mj->need_left) {
+      result = get_join_key(handle->left_rel, handle->left_join_attr,
+                            mj->left_id, left_row, &key);
+      if(result != DB_OK) {
+        return result;
+      }
+      mj->need_left = 0;
+
+      if(mj->in_run && key == mj->left_key) {
+        /* Duplicate key on the left side: join it with the same run
+           of right rows again. */
+        mj->right_id = mj->run_start;
+      } else {
+        mj->in_run = 0;
+        mj->left_key = key;
+      }
+    }
+
+    result = get_join_key(handle->right_rel, handle->right_join_attr,
+                          mj->right_id, right_row, &key);
+    if(DB_ERROR(result)) {
+      return result;
+    }
+
+    if(result == DB_OK && key == mj->left_key) {
+      if(!mj->in_run) {
+        mj->run_start = mj->right_id;
+        mj->in_run = 1;
+      }
+      mj->right_id++;
+      return emit_join_row(handle);
+    } else if(result == DB_OK && key < mj->left_key) {
+      mj->right_id++;
+      continue;
+    } else if(result == DB_FINISHED && !mj->in_run) {
+      return DB_FINISHED;
+    }
+
+    /* No more right rows match the current left row. */
+    mj->left_id++;
+    mj->need_left = 1;
+  }
+}
+
 db_result_t
 relation_process_join(void *handle_ptr)
 {
@@ -966,17 +1410,21 @@ relation_process_join(void *handle_ptr)
   db_result_t result;
   relation_t *left_rel;
   relation_t *right_rel;
-  relation_t *join_rel;
-  unsigned char *join_next_attribute_ptr;
-  size_t element_size;
   tuple_id_t right_tuple_id;
   attribute_value_t value;
-  int i;
 
   handle = (db_handle_t *)handle_ptr;
   left_rel = handle->left_rel;
   right_rel = handle->right_rel;
-  join_rel = handle->join_rel;
+
+  switch(join_method) {
+  case JOIN_METHOD_HASH:
+    return hash_join_next(handle);
+  case JOIN_METHOD_MERGE:
+    return merge_join_next(handle);
+  default:
+    break;
+  }
 
   if(!(handle->flags & DB_HANDLE_FLAG_INDEX_STEP)) {
     goto inner_loop;
@@ -1030,29 +1478,92 @@ inner_loop:
         return DB_IMPLEMENTATION_ERROR;
       }
 
-      /* Use the source attribute map to fill in the physical representation
-	 of the resulting tuple. */
-      join_next_attribute_ptr = join_row;
+      return emit_join_row(handle);
+    }
+  }
 
-      for(i = 0; i < join_rel->attribute_count; i++) {
-	element_size = source_map[i].attr->element_size;
+  return DB_OK;
+}
 
-	memcpy(join_next_attribute_ptr, source_map[i].from_ptr, element_size);
-	join_next_attribute_ptr += element_size;
-      }
+static int
+is_integer_attribute(attribute_t *attr)
+{
+  return attr->domain == DOMAIN_INT || attr->domain == DOMAIN_LONG;
+}
 
-      if(((aql_adt_t *)handle->adt)->flags & AQL_FLAG_ASSIGN) {
-        if(DB_ERROR(storage_put_row(join_rel, join_row))) {
-          return DB_STORAGE_ERROR;
-        }
-      }
+static int
+has_inline_index(attribute_t *attr)
+{
+  return index_exists(attr) && ((index_t *)attr->index)->type == INDEX_INLINE;
+}
 
-      handle->current_row++;
-      return DB_GOT_ROW;
+/*
+ * Choose a join method. The merge join is used when both relations are
+ * ordered by the join attribute, since it reads each relation once and
+ * needs no memory. Otherwise, the index join costs roughly
+ * DB_INDEX_COST sequential row reads for each left row. The hash join
+ * reads both relations once if the right relation fits in memory. If
+ * it does not, the hash join either reads the left relation once for
+ * each chunk of the right relation, or writes both relations to
+ * partition files, which costs about three reads of each relation.
+ */
+static db_result_t
+select_join_method(db_handle_t *handle)
+{
+  tuple_id_t left_cardinality;
+  tuple_id_t right_cardinality;
+  unsigned long hash_cost;
+  unsigned long spill_cost;
+  unsigned chunks;
+  unsigned partitions;
+  int integer_keys;
+
+  left_cardinality = relation_cardinality(handle->left_rel);
+  right_cardinality = relation_cardinality(handle->right_rel);
+  if(left_cardinality == INVALID_TUPLE || right_cardinality == INVALID_TUPLE) {
+    return DB_STORAGE_ERROR;
+  }
+
+  integer_keys = is_integer_attribute(handle->left_join_attr) &&
+                 is_integer_attribute(handle->right_join_attr);
+
+  if(integer_keys && has_inline_index(handle->left_join_attr) &&
+     has_inline_index(handle->right_join_attr)) {
+    PRINTF("DB: Using a merge join\n");
+    join_method = JOIN_METHOD_MERGE;
+    memset(&join_state.merge, 0, sizeof(join_state.merge));
+    join_state.merge.need_left = 1;
+    return DB_OK;
+  }
+
+  chunks = (right_cardinality + DB_JOIN_HASH_SIZE - 1) / DB_JOIN_HASH_SIZE;
+  hash_cost = right_cardinality + (unsigned long)chunks * left_cardinality;
+  partitions = 1;
+  if(chunks > 1) {
+    spill_cost = 3 * ((unsigned long)left_cardinality + right_cardinality);
+    if(spill_cost < hash_cost) {
+      hash_cost = spill_cost;
+      partitions = chunks < DB_JOIN_MAX_PARTITIONS ?
+                   chunks : DB_JOIN_MAX_PARTITIONS;
     }
   }
 
-  return DB_OK;
+  if(index_exists(handle->right_join_attr) &&
+     (!integer_keys ||
+      (unsigned long)left_cardinality * DB_INDEX_COST < hash_cost)) {
+    PRINTF("DB: Using an index join\n");
+    join_method = JOIN_METHOD_INDEX;
+    return DB_OK;
+  }
+
+  if(!integer_keys) {
+    PRINTF("DB: The attribute to join on is not indexed\n");
+    return DB_INDEX_ERROR;
+  }
+
+  PRINTF("DB: Using a hash join\n");
+  join_method = JOIN_METHOD_HASH;
+  return hash_join_prepare(handle, partitions);
 }
 
 static db_result_t
@@ -1120,6 +1631,7 @@ relation_join(void *query_result, void *adt_ptr)
   int i;
   char *attribute_name;
   attribute_t *attr;
+  db_result_t result;
 
   adt = (aql_adt_t *)adt_ptr;
 
@@ -1158,11 +1670,6 @@ relation_join(void *query_result, void *adt_ptr)
     return DB_RELATIONAL_ERROR;
   }
 
-  if(!index_exists(handle->right_join_attr)) {
-    PRINTF("DB: The attribute to join on is not indexed\n");
-    return DB_INDEX_ERROR;
-  }
-
   /*
    * Define the resulting relation. We start from 1 when counting attributes
    * because the first attribute is only the one to join, and is not included
@@ -1189,7 +1696,15 @@ relation_join(void *query_result, void *adt_ptr)
     handle->ncolumns++;
   }
 
-  return generate_join_result(handle);
+  result = generate_join_result(handle);
+  if(DB_ERROR(result)) {
+    return result;
+  }
+
+  /* Remove the partitions of a hash join that was not run to the end. */
+  join_cleanup();
+
+  return select_join_method(handle);
 }
 #endif /* DB_FEATURE_JOIN */
 
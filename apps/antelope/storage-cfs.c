@@ -68,6 +68,28 @@ struct index_record {
 
 #define ROW_XOR 0xf6U
 
+#if DB_READ_BUFFER_SIZE > 0
+/*
+ * A read buffer holds a block of consecutive rows of a relation, along
+ * with the number of rows in the relation. Rows are only appended to
+ * the tuple file, so neither the buffered rows nor the row count go
+ * stale until the relation is unloaded or dropped.
+ */
+struct read_buffer {
+  relation_t *rel;
+  tuple_id_t first;
+  tuple_id_t count;
+  tuple_id_t nrows;
+  tuple_id_t last_access;
+  uint16_t age;
+  uint8_t nrows_known;
+  unsigned char rows[DB_READ_BUFFER_SIZE];
+};
+
+static struct read_buffer read_buffers[DB_READ_BUFFER_COUNT];
+static uint16_t read_buffer_clock;
+#endif /* DB_READ_BUFFER_SIZE > 0 */
+
 static void
 merge_strings(char *dest, char *prefix, char *suffix)
 {
@@ -75,6 +97,103 @@ merge_strings(char *dest, char *prefix, char *suffix)
   strcat(dest, suffix);
 }
 
+#if DB_READ_BUFFER_SIZE > 0
+static struct read_buffer *
+get_read_buffer(relation_t *rel, int allocate)
+{
+  struct read_buffer *buf;
+  struct read_buffer *oldest;
+
+  oldest = NULL;
+  for(buf = read_buffers; buf < &read_buffers[DB_READ_BUFFER_COUNT]; buf++) {
+    if(buf->rel == rel) {
+      buf->age = ++read_buffer_clock;
+      return buf;
+    }
+    if(oldest == NULL || (oldest->rel != NULL &&
+       (buf->rel == NULL ||
+        (uint16_t)(read_buffer_clock - buf->age) >
+        (uint16_t)(read_buffer_clock - oldest->age)))) {
+      oldest = buf;
+    }
+  }
+
+  if(!allocate || rel->row_length > DB_READ_BUFFER_SIZE) {
+    return NULL;
+  }
+
+  memset(oldest, 0, sizeof(*oldest) - sizeof(oldest->rows));
+  oldest->rel = rel;
+  oldest->last_access = INVALID_TUPLE;
+  oldest->age = ++read_buffer_clock;
+  return oldest;
+}
+
+static void
+release_read_buffer(relation_t *rel)
+{
+  struct read_buffer *buf;
+
+  buf = get_read_buffer(rel, 0);
+  if(buf != NULL) {
+    buf->rel = NULL;
+  }
+}
+
+static db_result_t
+fill_read_buffer(struct read_buffer *buf, tuple_id_t tuple_id)
+{
+  relation_t *rel;
+  tuple_id_t count;
+  unsigned length;
+  int r;
+
+  rel = buf->rel;
+
+  /*
+   * Read a full buffer of rows when the access pattern moves forward
+   * through the relation, as in a scan or when following an index that
+   * returns tuple IDs in order. Other accesses read a single row so that
+   * random lookups, such as a binary search, do not pay for the
+   * readahead.
+   */
+  if(tuple_id == 0 || (buf->last_access != INVALID_TUPLE &&
+     tuple_id > buf->last_access &&
+     tuple_id - buf->last_access <= DB_READ_BUFFER_SIZE / rel->row_length)) {
+    count = DB_READ_BUFFER_SIZE / rel->row_length;
+  } else {
+    count = 1;
+  }
+  if(count > buf->nrows - tuple_id) {
+    count = buf->nrows - tuple_id;
+  }
+
+  buf->count = 0;
+  if(cfs_seek(rel->tuple_storage, tuple_id * rel->row_length, CFS_SEEK_SET) ==
+              (cfs_offset_t)-1) {
+    return DB_STORAGE_ERROR;
+  }
+
+  length = count * rel->row_length;
+  r = cfs_read(rel->tuple_storage, buf->rows, length);
+  if(r < 0) {
+    PRINTF("DB: Reading failed on fd %d\n", rel->tuple_storage);
+    return DB_STORAGE_ERROR;
+  } else if(r < rel->row_length) {
+    PRINTF("DB: Incomplete record: %d < %d\n", r, rel->row_length);
+    return DB_STORAGE_ERROR;
+  }
+
+  buf->first = tuple_id;
+  buf->count = r / rel->row_length;
+
+  PRINTF("DB: Buffered %lu rows from relation %s\n",
+         (unsigned long)buf->count, rel->name);
+
+  return DB_OK;
+}
+#endif /* DB_READ_BUFFER_SIZE > 0 */
+
 char *
 storage_generate_file(char *prefix, unsigned long size)
 {
@@ -104,6 +223,9 @@ db_result_t
 storage_load(relation_t *rel)
 {
   PRINTF("DB: Opening the tuple file %s\n", rel->tuple_filename);
+#if DB_READ_BUFFER_SIZE > 0
+  release_read_buffer(rel);
+#endif
   rel->tuple_storage = cfs_open(rel->tuple_filename,
                                 CFS_READ | CFS_WRITE | CFS_APPEND);
   if(rel->tuple_storage < 0) {
@@ -117,6 +239,10 @@ storage_load(relation_t *rel)
 void
 storage_unload(relation_t *rel)
 {
+#if DB_READ_BUFFER_SIZE > 0
+  release_read_buffer(rel);
+#endif
+
   if(RELATION_HAS_TUPLES(rel)) {
     PRINTF("DB: Unload tuple file %s\n", rel->tuple_filename);
 
@@ -279,6 +405,10 @@ storage_put_attribute(relation_t *rel, attribute_t *attr)
 db_result_t
 storage_drop_relation(relation_t *rel, int remove_tuples)
 {
+#if DB_READ_BUFFER_SIZE > 0
+  release_read_buffer(rel);
+#endif
+
   if(remove_tuples && RELATION_HAS_TUPLES(rel)) {
     cfs_remove(rel->tuple_filename);
   }
@@ -405,6 +535,35 @@ storage_get_row(relation_t *rel, tuple_id_t *tuple_id, storage_row_t row)
 {
   int r;
   tuple_id_t nrows;
+#if DB_READ_BUFFER_SIZE > 0
+  struct read_buffer *buf;
+
+  buf = get_read_buffer(rel, 1);
+  if(buf != NULL) {
+    if(!buf->nrows_known &&
+       DB_ERROR(storage_get_row_amount(rel, &buf->nrows))) {
+      return DB_STORAGE_ERROR;
+    }
+    buf->nrows_known = 1;
+
+    if(*tuple_id >= buf->nrows) {
+      return DB_FINISHED;
+    }
+
+    if(*tuple_id < buf->first || *tuple_id >= buf->first + buf->count) {
+      if(DB_ERROR(fill_read_buffer(buf, *tuple_id))) {
+        return DB_STORAGE_ERROR;
+      }
+    }
+    buf->last_access = *tuple_id;
+
+    memcpy(row, &buf->rows[(*tuple_id - buf->first) * rel->row_length],
+           rel->row_length);
+    row[rel->row_length - 1] ^= ROW_XOR;
+
+    return DB_OK;
+  }
+#endif /* DB_READ_BUFFER_SIZE > 0 */
 
   if(DB_ERROR(storage_get_row_amount(rel, &nrows))) {
     return DB_STORAGE_ERROR;
@@ -448,6 +607,9 @@ storage_put_row(relation_t *rel, storage_row_t row)
   int missing_bytes;
   char buf[rel->row_length];
 #endif
+#if DB_READ_BUFFER_SIZE > 0
+  struct read_buffer *rbuf;
+#endif
 
   end = cfs_seek(rel->tuple_storage, 0, CFS_SEEK_END);
   if(end == (cfs_offset_t)-1) {
@@ -486,6 +648,16 @@ storage_put_row(relation_t *rel, storage_row_t row)
 
   *last_byte ^= ROW_XOR;
 
+#if DB_READ_BUFFER_SIZE > 0
+  /* The file now ends with the new row, so the row count can be
+     updated without seeking. */
+  rbuf = get_read_buffer(rel, 0);
+  if(rbuf != NULL) {
+    rbuf->nrows = (tuple_id_t)((end + rel->row_length - 1) / rel->row_length) + 1;
+    rbuf->nrows_known = 1;
+  }
+#endif
+
   return DB_OK;
 }
 
@@ -493,6 +665,15 @@ db_result_t
 storage_get_row_amount(relation_t *rel, tuple_id_t *amount)
 {
   cfs_offset_t offset;
+#if DB_READ_BUFFER_SIZE > 0
+  struct read_buffer *buf;
+
+  buf = get_read_buffer(rel, 0);
+  if(buf != NULL && buf->nrows_known) {
+    *amount = buf->nrows;
+    return DB_OK;
+  }
+#endif
 
   if(rel->row_length == 0) {
     *amount = 0;
@@ -528,6 +709,12 @@ storage_close(db_storage_id_t fd)
   cfs_close(fd);
 }
 
+void
+storage_remove(const char *filename)
+{
+  cfs_remove(filename);
+}
+
 db_result_t
 storage_read(db_storage_id_t fd,
 	     void *buffer, unsigned long offset, unsigned length)
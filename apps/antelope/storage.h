@@ -70,6 +70,7 @@ db_result_t storage_get_row_amount(relation_t *, tuple_id_t *);
 
 db_storage_id_t storage_open(const char *);
 void storage_close(db_storage_id_t);
+void storage_remove(const char *);
 db_result_t storage_read(db_storage_id_t, void *, unsigned long, unsigned);
 db_result_t storage_write(db_storage_id_t, void *, unsigned long, unsigned);
 
@@ -90,6 +90,11 @@ static struct ctimer profile_timer;
    the next_object_id parameter. */
 static deluge_object_id_t next_object_id;
 
+/* Set while a request for lost packets is scheduled. */
+static int nack_pending;
+
+struct deluge_stats deluge_stats;
+
 /* Rime callbacks. */
 static void broadcast_recv(struct broadcast_conn *, const rimeaddr_t *);
 static void unicast_recv(struct unicast_conn *, const rimeaddr_t *);
@@ -120,6 +125,20 @@ transition(int state)
   }
 }
 
+static int
+write_packet(struct deluge_object *obj, unsigned pagenum, unsigned packetnum,
+	     unsigned char *data)
+{
+  cfs_offset_t offset;
+
+  offset = pagenum * S_PAGE + packetnum * S_PKT;
+
+  if(cfs_seek(obj->cfs_fd, offset, CFS_SEEK_SET) != offset) {
+    return -1;
+  }
+  return cfs_write(obj->cfs_fd, (char *)data, S_PKT);
+}
+
 static int
 write_page(struct deluge_object *obj, unsigned pagenum, unsigned char *data)
 {
@@ -170,6 +189,164 @@ init_page(struct deluge_object *obj, int pagenum, int have)
   }
 }
 
+static int
+read_delta(unsigned pagenum, unsigned char *buf)
+{
+  int fd;
+  int len;
+  struct deluge_delta_header header;
+  uint8_t record[2];
+
+  fd = cfs_open(DELUGE_DELTA_FILE, CFS_READ);
+  if(fd < 0) {
+    return -1;
+  }
+
+  len = -1;
+  if(cfs_read(fd, (char *)&header, sizeof(header)) == sizeof(header)) {
+    while(cfs_read(fd, (char *)record, sizeof(record)) == sizeof(record)) {
+      if(record[1] > DELUGE_DELTA_MAX_SIZE) {
+	break;
+      }
+      if(record[0] == pagenum) {
+	if(cfs_read(fd, (char *)buf, record[1]) == record[1]) {
+	  len = record[1];
+	}
+	break;
+      }
+      cfs_seek(fd, record[1], CFS_SEEK_CUR);
+    }
+  }
+  cfs_close(fd);
+
+  return len;
+}
+
+static void
+write_delta(unsigned pagenum, unsigned char *buf, unsigned len)
+{
+  int fd;
+  uint8_t record[2];
+
+  fd = cfs_open(DELUGE_DELTA_FILE, CFS_WRITE | CFS_APPEND);
+  if(fd < 0) {
+    return;
+  }
+
+  record[0] = pagenum;
+  record[1] = len;
+  cfs_write(fd, (char *)record, sizeof(record));
+  cfs_write(fd, (char *)buf, len);
+  cfs_close(fd);
+}
+
+static void
+start_delta(struct deluge_object *obj, unsigned version, unsigned npages)
+{
+  int fd;
+  struct deluge_delta_header header;
+
+  cfs_remove(DELUGE_DELTA_FILE);
+  if(obj->delta_base == 0) {
+    return;
+  }
+
+  fd = cfs_open(DELUGE_DELTA_FILE, CFS_WRITE);
+  if(fd < 0) {
+    obj->delta_base = 0;
+    return;
+  }
+
+  header.magic[0] = DELUGE_DELTA_MAGIC0;
+  header.magic[1] = DELUGE_DELTA_MAGIC1;
+  header.base_version = obj->delta_base;
+  header.version = version;
+  header.npages = npages;
+  if(cfs_write(fd, (char *)&header, sizeof(header)) != sizeof(header)) {
+    obj->delta_base = 0;
+  }
+  cfs_close(fd);
+}
+
+static void
+open_delta(struct deluge_object *obj)
+{
+  int fd;
+  struct deluge_delta_header header;
+  uint8_t record[2];
+
+  obj->delta_base = 0;
+
+  fd = cfs_open(DELUGE_DELTA_FILE, CFS_READ);
+  if(fd < 0) {
+    return;
+  }
+
+  if(cfs_read(fd, (char *)&header, sizeof(header)) == sizeof(header) &&
+     header.magic[0] == DELUGE_DELTA_MAGIC0 &&
+     header.magic[1] == DELUGE_DELTA_MAGIC1 &&
+     header.version == obj->version &&
+     header.base_version < obj->version &&
+     header.npages == OBJECT_PAGE_COUNT(*obj)) {
+    obj->delta_base = header.base_version;
+    PRINTF("Delta against version %u available\n", obj->delta_base);
+
+    /* Pages that did not change keep the version of the base, so that
+       nodes that already have them do not request them. */
+    while(cfs_read(fd, (char *)record, sizeof(record)) == sizeof(record)) {
+      if(record[1] == 0 && record[0] < header.npages) {
+	obj->pages[record[0]].version = obj->delta_base;
+      }
+      cfs_seek(fd, record[1], CFS_SEEK_CUR);
+    }
+  }
+  cfs_close(fd);
+}
+
+static int
+apply_delta(struct deluge_object *obj, unsigned char *delta, unsigned len,
+	    unsigned char *page)
+{
+  unsigned i, n, run;
+  cfs_offset_t offset;
+  uint8_t op;
+
+  if(len < 2) {
+    return -1;
+  }
+
+  for(i = 2, n = 0; i < len; n += run) {
+    op = delta[i++];
+    run = (op & ~DELUGE_DELTA_LITERAL) + 1;
+    if(n + run > S_PAGE) {
+      return -1;
+    }
+    if(op & DELUGE_DELTA_LITERAL) {
+      if(i + run > len) {
+	return -1;
+      }
+      memcpy(&page[n], &delta[i], run);
+      i += run;
+    } else {
+      if(i + 2 > len) {
+	return -1;
+      }
+      offset = delta[i] | (delta[i + 1] << 8);
+      i += 2;
+      if(cfs_seek(obj->cfs_fd, offset, CFS_SEEK_SET) != offset ||
+	 cfs_read(obj->cfs_fd, (char *)&page[n], run) != run) {
+	return -1;
+      }
+    }
+  }
+
+  if(n != S_PAGE ||
+     crc16_data(page, S_PAGE, 0) != (delta[0] | (delta[1] << 8))) {
+    return -1;
+  }
+  return 0;
+}
+
 static cfs_offset_t
 file_size(const char *file)
 {
@@ -204,7 +381,8 @@ init_object(struct deluge_object *obj, char *filename, unsigned version)
   obj->version = obj->update_version = version;
   obj->current_rx_page = 0;
   obj->nrequests = 0;
-  obj->tx_set = 0;
+  memset(obj->tx_set, 0, sizeof(obj->tx_set));
+  memset(obj->sources, 0, sizeof(obj->sources));
 
   obj->pages = malloc(OBJECT_PAGE_COUNT(*obj) * sizeof(*obj->pages));
   if(obj->pages == NULL) {
@@ -217,6 +395,8 @@ init_object(struct deluge_object *obj, char *filename, unsigned version)
     init_page(&current_object, i, 1);
   }
 
+  open_delta(obj);
+
   memset(obj->current_page, 0, sizeof(obj->current_page));
 
   return 0;
@@ -236,24 +416,99 @@ highest_available_page(struct deluge_object *obj)
   return i;
 }
 
+static void
+add_source(struct deluge_object *obj, const rimeaddr_t *addr,
+	   unsigned highest_available)
+{
+  struct deluge_source *src, *oldest;
+
+  oldest = &obj->sources[0];
+  for(src = obj->sources; src < &obj->sources[DELUGE_SOURCES]; src++) {
+    if(rimeaddr_cmp(&src->addr, addr)) {
+      oldest = src;
+      break;
+    }
+    if(src->heard < oldest->heard) {
+      oldest = src;
+    }
+  }
+
+  rimeaddr_copy(&oldest->addr, addr);
+  oldest->highest_available = highest_available;
+  oldest->heard = clock_time();
+}
+
+static int
+source_usable(struct deluge_source *src, unsigned pagenum)
+{
+  return src->heard != 0 && src->highest_available > pagenum &&
+    clock_time() - src->heard < T_HIGH * CLOCK_SECOND;
+}
+
 static void
 send_request(void *arg)
 {
   struct deluge_object *obj;
   struct deluge_msg_request request;
+  struct deluge_source *src;
+  unsigned first, end, n, chunk, nsources, i;
 
   obj = (struct deluge_object *)arg;
+  nack_pending = 0;
+
+  /* Cover the pages following the first incomplete one. A delta is
+     applied in place against the pages after it, so those pages must
+     not be written before it is complete. */
+  first = obj->current_rx_page;
+  end = first + (obj->delta_base != 0 ? 1 : DELUGE_WINDOW);
+  if(end > OBJECT_PAGE_COUNT(*obj)) {
+    end = OBJECT_PAGE_COUNT(*obj);
+  }
+
+  nsources = 0;
+  for(src = obj->sources; src < &obj->sources[DELUGE_SOURCES]; src++) {
+    if(source_usable(src, first)) {
+      nsources++;
+    }
+  }
+
+  /* Split the window between the neighbors that have advertised the
+     pages, so that they can send in parallel. */
+  chunk = nsources > 0 ? (end - first + nsources - 1) / nsources : 0;
+  for(src = obj->sources;
+      src < &obj->sources[DELUGE_SOURCES] && first < end; src++) {
+    if(!source_usable(src, first)) {
+      continue;
+    }
+    n = first + chunk > end ? end - first : chunk;
+    if(first + n > src->highest_available) {
+      n = src->highest_available - first;
+    }
+
+    request.cmd = DELUGE_CMD_REQUEST;
+    request.pagenum = first;
+    request.npages = n;
+    request.version = obj->pages[first].version;
+    request.delta_base = 0;
+    if(obj->pages[first].flags & PAGE_DELTA) {
+      request.delta_base = obj->delta_base;
+    }
+    request.object_id = obj->object_id;
+    for(i = 0; i < DELUGE_WINDOW; i++) {
+      request.request_set[i] = 0;
+      if(i < n) {
+	request.request_set[i] = ALL_PACKETS & ~obj->pages[first + i].packet_set;
+      }
+    }
 
-  request.cmd = DELUGE_CMD_REQUEST;
-  request.pagenum = obj->current_rx_page;
-  request.version = obj->pages[request.pagenum].version;
-  request.request_set = ~obj->pages[obj->current_rx_page].packet_set;
-  request.object_id = obj->object_id;
+    PRINTF("Sending request for pages %u-%u, version %u, first request_set %u\n",
+	   first, first + n - 1, request.version, request.request_set[0]);
+    packetbuf_copyfrom(&request, sizeof(request));
+    unicast_send(&deluge_uc, &src->addr);
+    deluge_stats.requests_sent++;
 
-  PRINTF("Sending request for page %d, version %u, request_set %u\n", 
-	request.pagenum, request.version, request.request_set);
-  packetbuf_copyfrom(&request, sizeof(request));
-  unicast_send(&deluge_uc, &obj->summary_from);
+    first += n;
+  }
 
   /* Deluge R.2 */
   if(++obj->nrequests == CONST_LAMBDA) {
@@ -261,7 +516,20 @@ send_request(void *arg)
     obj->nrequests = 0;
     transition(DELUGE_STATE_MAINTAIN);
   } else {
-    ctimer_reset(&rx_timer);
+    ctimer_set(&rx_timer,
+	CONST_OMEGA * ESTIMATED_TX_TIME + ((unsigned)random_rand() % T_R),
+	send_request, obj);
+  }
+}
+
+static void
+schedule_nack(struct deluge_object *obj)
+{
+  if(!nack_pending) {
+    nack_pending = 1;
+    deluge_stats.nacks++;
+    ctimer_set(&rx_timer, T_NACK + ((unsigned)random_rand() % T_NACK),
+	       send_request, obj);
   }
 }
 
@@ -316,6 +584,8 @@ handle_summary(struct deluge_msg_summary *msg, const rimeaddr_t *sender)
       return;
     }
 
+    add_source(&current_object, sender, msg->highest_available);
+
     oldest_request = oldest_data = now = clock_time();
     for(i = 0; i < msg->highest_available; i++) {
       page = &current_object.pages[i];
@@ -332,7 +602,6 @@ handle_summary(struct deluge_msg_summary *msg, const rimeaddr_t *sender)
       return;
     }
 
-    rimeaddr_copy(&current_object.summary_from, sender);
     transition(DELUGE_STATE_RX);
 
     if(ctimer_expired(&rx_timer)) {
@@ -344,11 +613,13 @@ handle_summary(struct deluge_msg_summary *msg, const rimeaddr_t *sender)
 }
 
 static void
-send_page(struct deluge_object *obj, unsigned pagenum)
+send_page(struct deluge_object *obj, unsigned pagenum, uint8_t *tx_set)
 {
   unsigned char buf[S_PAGE];
   struct deluge_msg_packet pkt;
   unsigned char *cp;
+  unsigned char *end;
+  int len;
 
   pkt.cmd = DELUGE_CMD_PACKET;
   pkt.pagenum = pagenum;
@@ -357,34 +628,63 @@ send_page(struct deluge_object *obj, unsigned pagenum)
   pkt.object_id = obj->object_id;
   pkt.crc = 0;
 
-  read_page(obj, pagenum, buf);
+  len = obj->tx_delta ? read_delta(pagenum, buf) : -1;
+  if(len > 0) {
+    /* The delta only occupies the first packets of the page. */
+    pkt.flags = DELUGE_PACKET_DELTA;
+    pkt.delta_len = len;
+    memset(&buf[len], 0, S_PAGE - len);
+    end = &buf[((len + S_PKT - 1) / S_PKT) * S_PKT];
+  } else {
+    pkt.flags = 0;
+    pkt.delta_len = 0;
+    read_page(obj, pagenum, buf);
+    end = &buf[S_PAGE];
+  }
 
   /* Divide the page into packets and send them one at a time. */
-  for(cp = buf; cp + S_PKT <= (unsigned char *)&buf[S_PAGE]; cp += S_PKT) {
-    if(obj->tx_set & (1 << pkt.packetnum)) {
+  for(cp = buf; cp + S_PKT <= end; cp += S_PKT) {
+    if(*tx_set & (1 << pkt.packetnum)) {
       pkt.crc = crc16_data(cp, S_PKT, 0);
       memcpy(pkt.payload, cp, S_PKT);
       packetbuf_copyfrom(&pkt, sizeof(pkt));
       broadcast_send(&deluge_broadcast);
+      deluge_stats.packets_sent++;
     }
     pkt.packetnum++;
   }
-  obj->tx_set = 0;
+  *tx_set = 0;
+}
+
+static int
+tx_pending(struct deluge_object *obj)
+{
+  int i;
+
+  for(i = 0; i < DELUGE_WINDOW; i++) {
+    if(obj->tx_set[i]) {
+      return 1;
+    }
+  }
+  return 0;
 }
 
 static void
 tx_callback(void *arg)
 {
   struct deluge_object *obj;
+  int i;
 
   obj = (struct deluge_object *)arg;
-  if(obj->current_tx_page >= 0 && obj->tx_set) {
-    send_page(obj, obj->current_tx_page);
+  if(obj->current_tx_page >= 0 && tx_pending(obj)) {
+    /* Send one page of the window per round. */
+    for(i = 0; obj->tx_set[i] == 0; i++);
+    send_page(obj, obj->current_tx_page + i, &obj->tx_set[i]);
     /* Deluge T.2. */
-    if(obj->tx_set) {
+    if(tx_pending(obj)) {
       packetbuf_set_attr(PACKETBUF_ATTR_PACKET_TYPE,
 			 PACKETBUF_ATTR_PACKET_TYPE_STREAM);
-      ctimer_reset(&tx_timer);
+      ctimer_set(&tx_timer, T_TX_PAGE, tx_callback, obj);
     } else {
       packetbuf_set_attr(PACKETBUF_ATTR_PACKET_TYPE,
 			 PACKETBUF_ATTR_PACKET_TYPE_STREAM_END);
@@ -398,28 +698,60 @@ static void
 handle_request(struct deluge_msg_request *msg)
 {
   int highest_available;
+  int delta;
+  int serve;
+  unsigned i, n, offset;
 
   if(msg->pagenum >= OBJECT_PAGE_COUNT(current_object)) {
     return;
   }
 
-  if(msg->version != current_object.version) {
+  deluge_stats.requests_received++;
+  delta = msg->delta_base != 0 && msg->delta_base == current_object.delta_base;
+
+  /* The version vector holds the version in which each page last
+     changed, and receivers ask for that version. A node that does not
+     hold the base of our delta asks for an unchanged page by the base
+     version, and so does a node that is still updating, so a request
+     is also served when it names the page's own version. */
+  serve = msg->version == current_object.version ||
+    msg->version == current_object.pages[msg->pagenum].version;
+  if(!serve) {
     neighbor_inconsistency = 1;
   }
 
   highest_available = highest_available_page(&current_object);
 
-  /* Deluge M.6 */
-  if(msg->version == current_object.version &&
-      msg->pagenum <= highest_available) {
-    current_object.pages[msg->pagenum].last_request = clock_time();
+  /* Deluge M.6. Incomplete pages are partly written, so they are not
+     served. */
+  if(serve && msg->pagenum < highest_available) {
+    n = msg->npages;
+    if(n < 1) {
+      n = 1;
+    } else if(n > DELUGE_WINDOW) {
+      n = DELUGE_WINDOW;
+    }
+    if(msg->pagenum + n > highest_available) {
+      n = highest_available - msg->pagenum;
+    }
 
     /* Deluge T.1 */
-    if(msg->pagenum == current_object.current_tx_page) {
-      current_object.tx_set |= msg->request_set;
+    if(current_object.current_tx_page >= 0 &&
+       msg->pagenum >= current_object.current_tx_page &&
+       msg->pagenum + n <= current_object.current_tx_page + DELUGE_WINDOW) {
+      /* Full page data also serves the neighbors that asked for the
+	 delta. */
+      current_object.tx_delta &= delta;
     } else {
       current_object.current_tx_page = msg->pagenum;
-      current_object.tx_set = msg->request_set;
+      memset(current_object.tx_set, 0, sizeof(current_object.tx_set));
+      current_object.tx_delta = delta;
+    }
+
+    offset = msg->pagenum - current_object.current_tx_page;
+    for(i = 0; i < n; i++) {
+      current_object.pages[msg->pagenum + i].last_request = clock_time();
+      current_object.tx_set[offset + i] |= msg->request_set[i] & ALL_PACKETS;
     }
 
     transition(DELUGE_STATE_TX);
@@ -427,12 +759,53 @@ handle_request(struct deluge_msg_request *msg)
   }
 }
 
+static void
+page_completed(struct deluge_object *obj, unsigned pagenum, unsigned version)
+{
+  struct deluge_page *page;
+  unsigned end;
+
+  page = &obj->pages[pagenum];
+  page->version = version;
+  page->flags = PAGE_COMPLETE;
+  PRINTF("Page %u completed\n", pagenum);
+
+  deluge_stats.pages_received++;
+  obj->nrequests = 0;
+
+  /* Pages of a window may complete in any order. */
+  end = obj->current_rx_page + DELUGE_WINDOW;
+  obj->current_rx_page = highest_available_page(obj);
+  deluge_stats.pages_complete = obj->current_rx_page;
+
+  if(obj->current_rx_page == OBJECT_PAGE_COUNT(*obj)) {
+    obj->version = obj->update_version;
+    deluge_stats.update_time = clock_time() - deluge_stats.update_started;
+    leds_on(LEDS_RED);
+    PRINTF("Update completed for object %u, version %u\n",
+	   (unsigned)obj->object_id, version);
+    /* Deluge R.3 */
+    transition(DELUGE_STATE_MAINTAIN);
+  } else if(obj->current_rx_page >= end || obj->delta_base != 0) {
+    /* The window is done; ask for the next one right away instead of
+       waiting for the next advertisement round. */
+    if(!nack_pending) {
+      ctimer_set(&rx_timer, (unsigned)random_rand() % T_NACK + 1,
+		 send_request, obj);
+    }
+  }
+}
+
 static void
 handle_packet(struct deluge_msg_packet *msg)
 {
   struct deluge_page *page;
   uint16_t crc;
   struct deluge_msg_packet packet;
+  unsigned char buf[S_PAGE];
+  unsigned window;
+  uint32_t missing;
+  int delta;
 
   memcpy(&packet, msg, sizeof(packet));
 
@@ -440,7 +813,11 @@ handle_packet(struct deluge_msg_packet *msg)
 	(unsigned)packet.object_id, (unsigned)packet.version,
 	(unsigned)packet.pagenum, (unsigned)packet.packetnum);
 
-  if(packet.pagenum != current_object.current_rx_page) {
+  window = current_object.delta_base != 0 ? 1 : DELUGE_WINDOW;
+  if(packet.pagenum < current_object.current_rx_page ||
+     packet.pagenum >= current_object.current_rx_page + window ||
+     packet.pagenum >= OBJECT_PAGE_COUNT(current_object) ||
+     packet.packetnum >= N_PKT) {
     return;
   }
 
@@ -450,8 +827,22 @@ handle_packet(struct deluge_msg_packet *msg)
 
   page = &current_object.pages[packet.pagenum];
   if(packet.version == page->version && !(page->flags & PAGE_COMPLETE)) {
-    memcpy(&current_object.current_page[S_PKT * packet.packetnum],
-	packet.payload, S_PKT);
+    delta = (packet.flags & DELUGE_PACKET_DELTA) != 0;
+    if(delta) {
+      if(!(page->flags & PAGE_DELTA) || packet.delta_len == 0 ||
+	 packet.delta_len > DELUGE_DELTA_MAX_SIZE) {
+	return;
+      }
+    } else if(page->flags & PAGE_DELTA) {
+      /* A neighbor without the delta sends the full page; take it. */
+      page->flags &= ~PAGE_DELTA;
+      page->packet_set = 0;
+    }
+
+    if(page->packet_set & (1 << packet.packetnum)) {
+      deluge_stats.packets_duplicate++;
+      return;
+    }
 
     crc = crc16_data(packet.payload, S_PKT, 0);
     if(packet.crc != crc) {
@@ -459,39 +850,61 @@ handle_packet(struct deluge_msg_packet *msg)
       return;
     }
 
+    /* Page data goes straight to the file, a delta is collected in
+       RAM until it can be applied. */
+    if(delta) {
+      memcpy(&current_object.current_page[S_PKT * packet.packetnum],
+	     packet.payload, S_PKT);
+    } else if(write_packet(&current_object, packet.pagenum,
+			   packet.packetnum, packet.payload) != S_PKT) {
+      return;
+    }
+
+    deluge_stats.packets_received++;
     page->last_data = clock_time();
     page->packet_set |= (1 << packet.packetnum);
+    if(delta) {
+      /* Packets past the end of the delta are never sent. */
+      page->packet_set |= ALL_PACKETS &
+	~((1 << ((packet.delta_len + S_PKT - 1) / S_PKT)) - 1);
+    }
 
     if(page->packet_set == ALL_PACKETS) {
+      if(delta) {
+	if(apply_delta(&current_object, current_object.current_page,
+		       packet.delta_len, buf) < 0) {
+	  /* Fall back to requesting the full page. */
+	  PRINTF("Delta for page %u failed\n", packet.pagenum);
+	  page->flags &= ~PAGE_DELTA;
+	  page->packet_set = 0;
+	  schedule_nack(&current_object);
+	  return;
+	}
+	write_delta(packet.pagenum, current_object.current_page,
+		    packet.delta_len);
+	write_page(&current_object, packet.pagenum, buf);
+	deluge_stats.delta_pages++;
+      }
+      page_completed(&current_object, packet.pagenum, packet.version);
+    }
+
+    if(page->flags & PAGE_COMPLETE) {
       /* This is the last packet of the requested page; stop streaming. */
       packetbuf_set_attr(PACKETBUF_ATTR_PACKET_TYPE,
 			 PACKETBUF_ATTR_PACKET_TYPE_STREAM_END);
+      return;
+    }
 
-      write_page(&current_object, packet.pagenum, current_object.current_page);
-      page->version = packet.version;
-      page->flags = PAGE_COMPLETE;
-      PRINTF("Page %u completed\n", packet.pagenum);
-
-      current_object.current_rx_page++;
-
-      if(packet.pagenum == OBJECT_PAGE_COUNT(current_object) - 1) {
-	current_object.version = current_object.update_version;
-	leds_on(LEDS_RED);
-	PRINTF("Update completed for object %u, version %u\n", 
-	       (unsigned)current_object.object_id, packet.version);
-      } else if(current_object.current_rx_page < OBJECT_PAGE_COUNT(current_object)) {
-        if(ctimer_expired(&rx_timer)) {
-	  ctimer_set(&rx_timer,
-		CONST_OMEGA * ESTIMATED_TX_TIME + (random_rand() % T_R),
-		send_request, &current_object);
-	}
-      }
-      /* Deluge R.3 */
-      transition(DELUGE_STATE_MAINTAIN);
-    } else {
-      /* More packets to come. Put lower layers in streaming mode. */
-      packetbuf_set_attr(PACKETBUF_ATTR_PACKET_TYPE,
-			 PACKETBUF_ATTR_PACKET_TYPE_STREAM);
+    /* More packets to come. Put lower layers in streaming mode. */
+    packetbuf_set_attr(PACKETBUF_ATTR_PACKET_TYPE,
+		       PACKETBUF_ATTR_PACKET_TYPE_STREAM);
+
+    /* The packets of a page are sent in order, so a gap before this
+       packet means that packets were lost: ask for them again now
+       rather than after the request timeout. */
+    missing = ~page->packet_set & ((1 << packet.packetnum) - 1);
+    if(missing) {
+      schedule_nack(&current_object);
     }
   }
 }
@@ -510,6 +923,7 @@ send_profile(struct deluge_object *obj)
     msg->cmd = DELUGE_CMD_PROFILE;
     msg->version = obj->version;
     msg->npages = OBJECT_PAGE_COUNT(*obj);
+    msg->delta_base = obj->delta_base;
     msg->object_id = obj->object_id;
     for(i = 0; i < msg->npages; i++) {
       msg->version_vector[i] = obj->pages[i].version;
@@ -537,7 +951,7 @@ handle_profile(struct deluge_msg_profile *msg)
 	msg->version, msg->npages);
 
   leds_off(LEDS_RED);
-  current_object.tx_set = 0;
+  memset(current_object.tx_set, 0, sizeof(current_object.tx_set));
 
   npages = OBJECT_PAGE_COUNT(*obj);
   obj->size = msg->npages * S_PAGE;
@@ -556,21 +970,44 @@ handle_profile(struct deluge_msg_profile *msg)
     npages = msg->npages;
   }
 
+  /* The delta can only be used if this node holds the complete object
+     of the version that the delta was made against. */
+  if(msg->delta_base != 0 && msg->delta_base == obj->version &&
+     obj->version == obj->update_version) {
+    obj->delta_base = msg->delta_base;
+  } else {
+    obj->delta_base = 0;
+  }
+  start_delta(obj, msg->version, msg->npages);
+
   for(i = 0; i < npages; i++) {
     if(msg->version_vector[i] > obj->pages[i].version) {
       obj->pages[i].packet_set = 0;
       obj->pages[i].flags &= ~PAGE_COMPLETE;
       obj->pages[i].version = msg->version_vector[i];
+      if(obj->delta_base != 0) {
+	obj->pages[i].flags |= PAGE_DELTA;
+      }
     }
   }
 
   for(; i < msg->npages; i++) {
     init_page(obj, i, 0);
+    if(obj->delta_base != 0) {
+      obj->pages[i].flags |= PAGE_DELTA;
+    }
   }
 
   obj->current_rx_page = highest_available_page(obj);
   obj->update_version = msg->version;
 
+  /* Advertisements for the old version say nothing about the new. */
+  memset(obj->sources, 0, sizeof(obj->sources));
+
+  deluge_stats.pages_total = msg->npages;
+  deluge_stats.pages_complete = obj->current_rx_page;
+  deluge_stats.update_started = clock_time();
+
   transition(DELUGE_STATE_RX);
 
   ctimer_set(&rx_timer,
@@ -606,7 +1043,7 @@ command_dispatcher(const rimeaddr_t *sender)
   case DELUGE_CMD_PROFILE:
     profile = (struct deluge_msg_profile *)msg;
     if(len >= sizeof(*profile) &&
-       len >= sizeof(*profile) + profile->npages * profile->version_vector[0])
+       len >= sizeof(*profile) + profile->npages)
       handle_profile((struct deluge_msg_profile *)msg);
     break;
   default:
@@ -59,6 +59,8 @@ PROCESS_NAME(deluge_process);
 #define PAGE_COMPLETE	1
 /* All pages up to, and including, this page are complete. */
 #define PAGE_AVAILABLE	1
+/* The page is being received as a delta against the base version. */
+#define PAGE_DELTA	2
 
 #define S_PKT		64		/* Deluge packet size. */
 #define N_PKT		4		/* Packets per page. */
@@ -71,6 +73,26 @@ PROCESS_NAME(deluge_process);
 /* Random interval for request transmissions in jiffies. */
 #define T_R		(CLOCK_SECOND * 2)
 
+/* Delay before asking again for packets that were seen to be lost. */
+#define T_NACK		(CLOCK_SECOND / 4)
+
+/* Interval between the pages that a sender streams for one request. */
+#define T_TX_PAGE	(CLOCK_SECOND / 8)
+
+/* The number of pages that a request can cover. */
+#ifdef DELUGE_CONF_WINDOW
+#define DELUGE_WINDOW	DELUGE_CONF_WINDOW
+#else
+#define DELUGE_WINDOW	4
+#endif
+
+/* The number of neighbors that pages are requested from in parallel. */
+#ifdef DELUGE_CONF_SOURCES
+#define DELUGE_SOURCES	DELUGE_CONF_SOURCES
+#else
+#define DELUGE_SOURCES	3
+#endif
+
 /* Bound for the number of advertisements. */
 #define CONST_K		1
 
@@ -94,6 +116,41 @@ PROCESS_NAME(deluge_process);
 #define CONST_OMEGA		8
 #define ESTIMATED_TX_TIME	(CLOCK_SECOND)
 
+/*
+ * Delta dissemination. A delta file, made with tools/deluge-delta,
+ * describes how to build the pages of a new object version from the
+ * object of an older (base) version. It starts with a struct
+ * deluge_delta_header, followed by one record per page:
+ *
+ *   pagenum (1 byte), length (1 byte), length bytes of page delta.
+ *
+ * A record of length zero marks a page that has not changed since the
+ * base version. Pages without a record are sent in full. A page delta
+ * is the CRC-16 of the new page (2 bytes, little endian) followed by
+ * operations:
+ *
+ *   0x80 | (n - 1), n bytes        Append n literal bytes.
+ *   n - 1, offset (2 bytes, LE)    Append n bytes from the base object.
+ *
+ * Copies only refer to pages that the receiver has not yet rewritten,
+ * so the delta can be applied in place, page by page.
+ */
+#ifdef DELUGE_CONF_DELTA_FILE
+#define DELUGE_DELTA_FILE	DELUGE_CONF_DELTA_FILE
+#else
+#define DELUGE_DELTA_FILE	"deluge.delta"
+#endif
+
+#define DELUGE_DELTA_MAGIC0	'D'
+#define DELUGE_DELTA_MAGIC1	'L'
+#define DELUGE_DELTA_LITERAL	0x80
+#define DELUGE_DELTA_MAX_RUN	128
+/* A delta is only worth sending if it saves at least one packet. */
+#define DELUGE_DELTA_MAX_SIZE	((N_PKT - 1) * S_PKT)
+
+/* The packet carries a page delta instead of page data. */
+#define DELUGE_PACKET_DELTA	1
+
 typedef uint8_t deluge_object_id_t;
 
 struct deluge_msg_summary {
@@ -103,12 +160,16 @@ struct deluge_msg_summary {
   deluge_object_id_t object_id;
 };
 
+/* A request for npages pages from pagenum on. Each page has a NACK
+   bitmap in which set bits are the packets still missing. */
 struct deluge_msg_request {
   uint8_t cmd;
   uint8_t version;
   uint8_t pagenum;
-  uint8_t request_set;
+  uint8_t npages;
+  uint8_t delta_base;
   deluge_object_id_t object_id;
+  uint8_t request_set[DELUGE_WINDOW];
 };
 
 struct deluge_msg_packet {
@@ -116,6 +177,8 @@ struct deluge_msg_packet {
   uint8_t version;
   uint8_t pagenum;
   uint8_t packetnum;
+  uint8_t flags;
+  uint8_t delta_len;
   uint16_t crc;
   deluge_object_id_t object_id;
   unsigned char payload[S_PKT];
@@ -125,10 +188,17 @@ struct deluge_msg_profile {
   uint8_t cmd;
   uint8_t version;
   uint8_t npages;
+  uint8_t delta_base;
   deluge_object_id_t object_id;
   uint8_t version_vector[];
 };
 
+struct deluge_source {
+  rimeaddr_t addr;
+  clock_time_t heard;
+  uint8_t highest_available;
+};
+
 struct deluge_object {
   char *filename;
   uint16_t object_id;
@@ -140,9 +210,33 @@ struct deluge_object {
   int8_t current_tx_page;
   uint8_t nrequests;
   uint8_t current_page[S_PAGE];
-  uint8_t tx_set;
+  uint8_t tx_set[DELUGE_WINDOW];
+  uint8_t tx_delta;
+  uint8_t delta_base;
   int cfs_fd;
-  rimeaddr_t summary_from;
+  struct deluge_source sources[DELUGE_SOURCES];
+};
+
+struct deluge_delta_header {
+  uint8_t magic[2];
+  uint8_t base_version;
+  uint8_t version;
+  uint8_t npages;
+};
+
+struct deluge_stats {
+  uint16_t requests_sent;
+  uint16_t requests_received;
+  uint16_t packets_sent;
+  uint16_t packets_received;
+  uint16_t packets_duplicate;
+  uint16_t nacks;
+  uint8_t pages_received;
+  uint8_t delta_pages;
+  uint8_t pages_total;
+  uint8_t pages_complete;
+  clock_time_t update_started;
+  clock_time_t update_time;
 };
 
 struct deluge_page {
@@ -156,4 +250,9 @@ struct deluge_page {
 
 int deluge_disseminate(char *file, unsigned version);
 
+/* Dissemination statistics. pages_complete of pages_total shows the
+   progress of the update in course; update_time is the duration of the
+   last completed update, in clock ticks. */
+extern struct deluge_stats deluge_stats;
+
 #endif
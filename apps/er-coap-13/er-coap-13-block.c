@@ -0,0 +1,262 @@
+/*
+ * Copyright (c) 2026, the smart-HOP contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *      CoAP module for streaming blockwise transfers
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "cfs/cfs.h"
+#include "er-coap-13-block.h"
+
+#define DEBUG 0
+#if DEBUG
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+
+/*----------------------------------------------------------------------------*/
+/*- CFS-backed streams -------------------------------------------------------*/
+/*----------------------------------------------------------------------------*/
+static int
+cfs_stream_open(coap_block_stream_t *stream, uint8_t mode)
+{
+  if(stream->fd >= 0 && stream->mode == mode) {
+    return 1;
+  }
+  coap_block_stream_close(stream);
+
+  stream->fd = cfs_open((const char *)stream->data, mode);
+  if(stream->fd < 0) {
+    PRINTF("Block stream: cannot open %s\n", (const char *)stream->data);
+    return 0;
+  }
+  stream->mode = mode;
+  stream->cursor = 0;
+  stream->size = -1;
+
+  if(mode == CFS_READ) {
+    cfs_offset_t end = cfs_seek(stream->fd, 0, CFS_SEEK_END);
+    if(end >= 0) {
+      stream->size = end;
+    }
+    cfs_seek(stream->fd, 0, CFS_SEEK_SET);
+  } else {
+    /* Appending continues after what earlier blocks have stored. */
+    cfs_offset_t end = cfs_seek(stream->fd, 0, CFS_SEEK_END);
+    if(end < 0) {
+      coap_block_stream_close(stream);
+      return 0;
+    }
+    stream->cursor = end;
+  }
+  return 1;
+}
+/*----------------------------------------------------------------------------*/
+static int
+cfs_stream_read(coap_block_stream_t *stream, uint32_t offset, uint8_t *buffer, uint16_t len)
+{
+  int r;
+
+  if(!cfs_stream_open(stream, CFS_READ)) {
+    return -1;
+  }
+  if(offset != stream->cursor) {
+    if(cfs_seek(stream->fd, offset, CFS_SEEK_SET) != (cfs_offset_t)offset) {
+      return -1;
+    }
+    stream->cursor = offset;
+  }
+  r = cfs_read(stream->fd, buffer, len);
+  if(r > 0) {
+    stream->cursor += r;
+  }
+  return r;
+}
+/*----------------------------------------------------------------------------*/
+static int
+cfs_stream_write(coap_block_stream_t *stream, uint32_t offset, const uint8_t *buffer, uint16_t len)
+{
+  uint16_t stored;
+  int r;
+
+  if(offset == 0) {
+    /* Block 0 (re)starts an upload and replaces the previous content. */
+    coap_block_stream_close(stream);
+    cfs_remove((const char *)stream->data);
+  }
+  /* Any other block is appended, so an upload survives a Block2 GET on
+     the same stream or a resumed transfer. */
+  if(!cfs_stream_open(stream, CFS_WRITE | CFS_APPEND)) {
+    return -1;
+  }
+  if(offset > stream->cursor) {
+    return COAP_BLOCK_STREAM_GAP;
+  }
+
+  /* Retransmitted blocks are already (partly) stored. */
+  stored = stream->cursor - offset < len ? stream->cursor - offset : len;
+  if(stored == len) {
+    return len;
+  }
+  r = cfs_write(stream->fd, buffer + stored, len - stored);
+  if(r < 0) {
+    return r;
+  }
+  stream->cursor += r;
+  return stored + r;
+}
+/*----------------------------------------------------------------------------*/
+/*- Stream API ---------------------------------------------------------------*/
+/*----------------------------------------------------------------------------*/
+void
+coap_block_stream_init(coap_block_stream_t *stream, coap_block_read_t read, coap_block_write_t write, void *data)
+{
+  stream->read = read;
+  stream->write = write;
+  stream->data = data;
+  stream->cursor = 0;
+  stream->size = -1;
+  stream->fd = -1;
+  stream->mode = 0;
+}
+/*----------------------------------------------------------------------------*/
+void
+coap_block_stream_init_cfs(coap_block_stream_t *stream, const char *filename)
+{
+  coap_block_stream_init(stream, cfs_stream_read, cfs_stream_write, (void *)filename);
+}
+/*----------------------------------------------------------------------------*/
+void
+coap_block_stream_close(coap_block_stream_t *stream)
+{
+  if(stream->fd >= 0) {
+    cfs_close(stream->fd);
+    stream->fd = -1;
+  }
+  stream->mode = 0;
+  stream->cursor = 0;
+}
+/*----------------------------------------------------------------------------*/
+/*- Resource helpers ---------------------------------------------------------*/
+/*----------------------------------------------------------------------------*/
+int
+coap_block2_stream(coap_block_stream_t *stream, void *response, uint8_t *buffer, uint16_t preferred_size, int32_t *offset)
+{
+  int len;
+
+  if(stream->read == NULL) {
+    coap_set_status_code(response, METHOD_NOT_ALLOWED_4_05);
+    return -1;
+  }
+
+  if(stream->size >= 0 && *offset > stream->size) {
+    coap_set_status_code(response, BAD_OPTION_4_02);
+    coap_set_payload(response, "BlockOutOfScope", 15);
+    return -1;
+  }
+
+  len = stream->read(stream, (uint32_t)*offset, buffer, preferred_size);
+  if(len < 0) {
+    coap_block_stream_close(stream);
+    coap_set_status_code(response, INTERNAL_SERVER_ERROR_5_00);
+    return -1;
+  }
+
+  PRINTF("Block stream: read %d bytes at %ld\n", len, (long)*offset);
+
+  coap_set_payload(response, buffer, len);
+
+  /* Unknown sizes fall back to a short block marking the end. */
+  if((stream->size >= 0 && *offset + len >= stream->size)
+     || (stream->size < 0 && len < preferred_size)) {
+    *offset = -1;
+    coap_block_stream_close(stream);
+  } else {
+    *offset += len;
+  }
+  return len;
+}
+/*----------------------------------------------------------------------------*/
+int
+coap_block1_stream(coap_block_stream_t *stream, void *request, void *response)
+{
+  const uint8_t *payload = NULL;
+  uint32_t num = 0;
+  uint8_t more = 0;
+  uint16_t size = 0;
+  uint32_t offset = 0;
+  int blockwise;
+  int len;
+  int r;
+
+  if(stream->write == NULL) {
+    coap_set_status_code(response, METHOD_NOT_ALLOWED_4_05);
+    return -1;
+  }
+
+  len = coap_get_payload(request, &payload);
+  blockwise = coap_get_header_block1(request, &num, &more, &size, &offset);
+
+  if(len > 0 || offset == 0) {
+    r = stream->write(stream, offset, payload, len);
+
+    /* Retransmitted blocks may be written again, gaps cannot be filled. */
+    if(r == COAP_BLOCK_STREAM_GAP) {
+      PRINTF("Block stream: expected offset %lu, got %lu\n", (unsigned long)stream->cursor, (unsigned long)offset);
+      coap_set_status_code(response, REQUEST_ENTITY_INCOMPLETE_4_08);
+      return -1;
+    }
+    if(r != len) {
+      coap_block_stream_close(stream);
+      coap_set_status_code(response, REQUEST_ENTITY_TOO_LARGE_4_13);
+      return -1;
+    }
+  }
+
+  PRINTF("Block stream: wrote %d bytes at %lu%s\n", len, (unsigned long)offset, more ? " (more)" : "");
+
+  if(blockwise) {
+    coap_set_header_block1(response, num, more, size);
+  }
+  if(more) {
+    coap_set_status_code(response, CONTINUE_2_31);
+    return 0;
+  }
+
+  coap_block_stream_close(stream);
+  coap_set_status_code(response, CHANGED_2_04);
+  return 1;
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2026, the smart-HOP contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *      CoAP module for streaming blockwise transfers
+ */
+
+#ifndef COAP_BLOCK_H_
+#define COAP_BLOCK_H_
+
+#include "er-coap-13.h"
+
+/*
+ * A block stream lets a resource serve Block2 responses from, or accept Block1
+ * uploads into, a payload that never has to fit into RAM. The stream remembers
+ * where the previous block ended, so sequential transfers cost one read or
+ * write per block and no seek. Sources without a file behind them (e.g.,
+ * generators) pass their own read/write functions and may use 'data' for
+ * their state; a read at an offset other than 'cursor' means the client
+ * restarted or skipped and the source has to reposition itself. A write at
+ * offset 0 starts a new upload. A write past the data stored so far returns
+ * COAP_BLOCK_STREAM_GAP, which is answered with 4.08.
+ */
+typedef struct coap_block_stream coap_block_stream_t;
+
+#define COAP_BLOCK_STREAM_GAP -2
+
+typedef int (* coap_block_read_t)(coap_block_stream_t *stream, uint32_t offset, uint8_t *buffer, uint16_t len);
+typedef int (* coap_block_write_t)(coap_block_stream_t *stream, uint32_t offset, const uint8_t *buffer, uint16_t len);
+
+struct coap_block_stream {
+  coap_block_read_t read;
+  coap_block_write_t write;
+  void *data;
+
+  uint32_t cursor;   /* offset following the last block read or written */
+  int32_t size;      /* total payload length, -1 if unknown */
+  int fd;            /* CFS descriptor, -1 if closed */
+  uint8_t mode;      /* CFS_READ or CFS_WRITE while open */
+};
+
+void coap_block_stream_init(coap_block_stream_t *stream, coap_block_read_t read, coap_block_write_t write, void *data);
+void coap_block_stream_init_cfs(coap_block_stream_t *stream, const char *filename);
+void coap_block_stream_close(coap_block_stream_t *stream);
+
+/*
+ * To be called from a resource handler. coap_block2_stream() puts the block at
+ * *offset into the response and advances *offset, or sets it to -1 after the
+ * last block; the engine adds the Block2 option. coap_block1_stream() stores
+ * the payload of a (blockwise) PUT/POST and answers with 2.31 Continue or,
+ * once the last block arrived, 2.04 Changed. It returns 1 when the upload is
+ * complete, 0 while more blocks are expected, and -1 on errors.
+ */
+int coap_block2_stream(coap_block_stream_t *stream, void *response, uint8_t *buffer, uint16_t preferred_size, int32_t *offset);
+int coap_block1_stream(coap_block_stream_t *stream, void *request, void *response);
+
+#endif /* COAP_BLOCK_H_ */
@@ -229,6 +229,8 @@ coap_receive(void)
         {
           /* Transactions are closed through lookup below */
           PRINTF("Received ACK\n");
+          /* Acknowledged CON notifications are not transactions. */
+          coap_clear_notification_by_mid(&UIP_IP_BUF->srcipaddr, UIP_UDP_BUF->srcport, message->mid);
         }
         else if (message->type==COAP_TYPE_RST)
         {
@@ -242,6 +244,7 @@ coap_receive(void)
           /* Free transaction memory before callback, as it may create a new transaction. */
           restful_response_handler callback = transaction->callback;
           void *callback_data = transaction->callback_data;
+          coap_transaction_acked(transaction);
           coap_clear_transaction(transaction);
 
           /* Check if someone registered for the response */
@@ -352,7 +355,7 @@ well_known_core_handler(void* request, void* response, uint8_t *buffer, uint16_t
     }
 #endif
 
-    for (resource = (resource_t*)list_head(rest_get_resources()); resource; resource = resource->next)
+    for (resource = rest_get_next_resource(NULL); resource; resource = rest_get_next_resource(resource))
     {
 #if COAP_LINK_FORMAT_FILTERING
       /* Filtering */
@@ -510,6 +513,7 @@ PROCESS_THREAD(coap_receiver, ev, data)
     } else if (ev == PROCESS_EVENT_TIMER) {
       /* retransmissions are handled here */
       coap_check_transactions();
+      coap_check_notifications();
     }
   } /* while (1) */
 
@@ -53,9 +53,104 @@
 #endif
 
 
+/*
+ * An observee keeps the observers of one resource together with the
+ * latest notification of that resource. The notification is serialized
+ * once, without a Token, behind COAP_TOKEN_LEN bytes of headroom. Each
+ * observer gets its header and Token written in front of the shared
+ * options and payload right before sending, so a CON notification
+ * only needs a MID, a retransmission counter, and a timer per observer.
+ */
+typedef struct coap_observee {
+  struct coap_observee *next; /* for LIST */
+
+  const char *url;
+  LIST_STRUCT(observers);
+  uint8_t type;
+  uint8_t code;
+  uint16_t notification_len; /* serialized length without the Token */
+  uint8_t notification[COAP_TOKEN_LEN+COAP_MAX_PACKET_SIZE];
+} coap_observee_t;
+
 MEMB(observers_memb, coap_observer_t, COAP_MAX_OBSERVERS);
-LIST(observers_list);
+MEMB(observees_memb, coap_observee_t, COAP_MAX_OBSERVED_RESOURCES);
+LIST(observees_list);
+
+PROCESS_NAME(coap_receiver);
+
+static uint16_t observer_count = 0;
+static struct etimer notification_timer;
 
+/*-----------------------------------------------------------------------------------*/
+static coap_observee_t *
+get_observee(const char *url)
+{
+  coap_observee_t *o = NULL;
+
+  for (o = (coap_observee_t*)list_head(observees_list); o; o = o->next)
+  {
+    if (o->url==url) /* using RESOURCE url pointer as handle */
+    {
+      return o;
+    }
+  }
+  return NULL;
+}
+/*-----------------------------------------------------------------------------------*/
+static void
+send_notification(coap_observee_t *o, coap_observer_t *obs)
+{
+  uint8_t *start = o->notification + COAP_TOKEN_LEN - obs->token_len;
+  uint8_t type = obs->retrans_counter ? COAP_TYPE_CON : o->type;
+
+  start[0]  = COAP_HEADER_VERSION_MASK & 1<<COAP_HEADER_VERSION_POSITION;
+  start[0] |= COAP_HEADER_TYPE_MASK & type<<COAP_HEADER_TYPE_POSITION;
+  start[0] |= COAP_HEADER_TOKEN_LEN_MASK & obs->token_len<<COAP_HEADER_TOKEN_LEN_POSITION;
+  start[1] = o->code;
+  start[2] = (uint8_t) (obs->last_mid>>8);
+  start[3] = (uint8_t) (obs->last_mid);
+  memcpy(start+COAP_HEADER_LEN, obs->token, obs->token_len);
+
+  coap_send_message(&obs->addr, obs->port, start, o->notification_len + obs->token_len);
+}
+/*-----------------------------------------------------------------------------------*/
+static void
+schedule_retransmissions(void)
+{
+  coap_observee_t *o = NULL;
+  coap_observer_t *obs = NULL;
+  clock_time_t next = 0;
+  clock_time_t left;
+  int pending = 0;
+
+  for (o = (coap_observee_t*)list_head(observees_list); o; o = o->next)
+  {
+    for (obs = (coap_observer_t*)list_head(o->observers); obs; obs = obs->next)
+    {
+      if (obs->retrans_counter)
+      {
+        left = timer_expired(&obs->retrans_timer) ? 0 : timer_remaining(&obs->retrans_timer);
+        if (!pending || left<next)
+        {
+          next = left;
+        }
+        pending = 1;
+      }
+    }
+  }
+
+  if (pending)
+  {
+    /* The timer event is handled by the transaction handler process. */
+    PROCESS_CONTEXT_BEGIN(&coap_receiver);
+    etimer_set(&notification_timer, next);
+    PROCESS_CONTEXT_END(&coap_receiver);
+  }
+  else
+  {
+    etimer_stop(&notification_timer);
+  }
+}
 /*-----------------------------------------------------------------------------------*/
 coap_observer_t *
 coap_add_observer(uip_ipaddr_t *addr, uint16_t port, const uint8_t *token, size_t token_len, const char *url)
@@ -63,50 +158,94 @@ coap_add_observer(uip_ipaddr_t *addr, uint16_t port, const uint8_t *token, size_
   /* Remove existing observe relationship, if any. */
   coap_remove_observer_by_url(addr, port, url);
 
-  coap_observer_t *o = memb_alloc(&observers_memb);
+  coap_observee_t *o = get_observee(url);
 
-  if (o)
+  if (o==NULL)
   {
+    if ((o = memb_alloc(&observees_memb))==NULL)
+    {
+      PRINTF("No observee left for /%s\n", url);
+      return NULL;
+    }
     o->url = url;
-    uip_ipaddr_copy(&o->addr, addr);
-    o->port = port;
-    o->token_len = token_len;
-    memcpy(o->token, token, token_len);
-    o->last_mid = 0;
+    o->notification_len = 0;
+    LIST_STRUCT_INIT(o, observers);
+    list_add(observees_list, o);
+  }
 
-    stimer_set(&o->refresh_timer, COAP_OBSERVING_REFRESH_INTERVAL);
+  coap_observer_t *obs = memb_alloc(&observers_memb);
 
-    PRINTF("Adding observer for /%s [0x%02X%02X]\n", o->url, o->token[0], o->token[1]);
-    list_add(observers_list, o);
+  if (obs)
+  {
+    obs->url = url;
+    uip_ipaddr_copy(&obs->addr, addr);
+    obs->port = port;
+    obs->token_len = token_len;
+    memcpy(obs->token, token, token_len);
+    obs->last_mid = 0;
+    obs->retrans_counter = 0;
+
+    stimer_set(&obs->refresh_timer, COAP_OBSERVING_REFRESH_INTERVAL);
+
+    PRINTF("Adding observer for /%s [0x%02X%02X]\n", obs->url, obs->token[0], obs->token[1]);
+    list_add(o->observers, obs);
+    ++observer_count;
+  }
+  else if (list_head(o->observers)==NULL)
+  {
+    list_remove(observees_list, o);
+    memb_free(&observees_memb, o);
   }
 
-  return o;
+  return obs;
 }
 /*-----------------------------------------------------------------------------------*/
 void
-coap_remove_observer(coap_observer_t *o)
+coap_remove_observer(coap_observer_t *obs)
 {
-  PRINTF("Removing observer for /%s [0x%02X%02X]\n", o->url, o->token[0], o->token[1]);
+  coap_observee_t *o = get_observee(obs->url);
+
+  PRINTF("Removing observer for /%s [0x%02X%02X]\n", obs->url, obs->token[0], obs->token[1]);
 
-  memb_free(&observers_memb, o);
-  list_remove(observers_list, o);
+  if (o)
+  {
+    list_remove(o->observers, obs);
+
+    /* Release the notification buffer with the last observer. */
+    if (list_head(o->observers)==NULL)
+    {
+      list_remove(observees_list, o);
+      memb_free(&observees_memb, o);
+    }
+  }
+  memb_free(&observers_memb, obs);
+  --observer_count;
 }
 
 int
 coap_remove_observer_by_client(uip_ipaddr_t *addr, uint16_t port)
 {
   int removed = 0;
-  coap_observer_t* obs = NULL;
+  coap_observee_t *o = NULL;
+  coap_observee_t *next_o = NULL;
+  coap_observer_t *obs = NULL;
+  coap_observer_t *next = NULL;
+
+  PRINTF("Remove check client ");
+  PRINT6ADDR(addr);
+  PRINTF(":%u\n", port);
 
-  for (obs = (coap_observer_t*)list_head(observers_list); obs; obs = obs->next)
+  for (o = (coap_observee_t*)list_head(observees_list); o; o = next_o)
   {
-    PRINTF("Remove check client ");
-    PRINT6ADDR(addr);
-    PRINTF(":%u\n", port);
-    if (uip_ipaddr_cmp(&obs->addr, addr) && obs->port==port)
+    next_o = o->next;
+    for (obs = (coap_observer_t*)list_head(o->observers); obs; obs = next)
     {
-      coap_remove_observer(obs);
-      removed++;
+      next = obs->next;
+      if (uip_ipaddr_cmp(&obs->addr, addr) && obs->port==port)
+      {
+        coap_remove_observer(obs);
+        removed++;
+      }
     }
   }
   return removed;
@@ -116,15 +255,24 @@ int
 coap_remove_observer_by_token(uip_ipaddr_t *addr, uint16_t port, uint8_t *token, size_t token_len)
 {
   int removed = 0;
-  coap_observer_t* obs = NULL;
+  coap_observee_t *o = NULL;
+  coap_observee_t *next_o = NULL;
+  coap_observer_t *obs = NULL;
+  coap_observer_t *next = NULL;
+
+  PRINTF("Remove check Token 0x%02X%02X\n", token[0], token[1]);
 
-  for (obs = (coap_observer_t*)list_head(observers_list); obs; obs = obs->next)
+  for (o = (coap_observee_t*)list_head(observees_list); o; o = next_o)
   {
-    PRINTF("Remove check Token 0x%02X%02X\n", token[0], token[1]);
-    if (uip_ipaddr_cmp(&obs->addr, addr) && obs->port==port && obs->token_len==token_len && memcmp(obs->token, token, token_len)==0)
+    next_o = o->next;
+    for (obs = (coap_observer_t*)list_head(o->observers); obs; obs = next)
     {
-      coap_remove_observer(obs);
-      removed++;
+      next = obs->next;
+      if (uip_ipaddr_cmp(&obs->addr, addr) && obs->port==port && obs->token_len==token_len && memcmp(obs->token, token, token_len)==0)
+      {
+        coap_remove_observer(obs);
+        removed++;
+      }
     }
   }
   return removed;
@@ -134,15 +282,28 @@ int
 coap_remove_observer_by_url(uip_ipaddr_t *addr, uint16_t port, const char *url)
 {
   int removed = 0;
-  coap_observer_t* obs = NULL;
+  coap_observee_t *o = NULL;
+  coap_observee_t *next_o = NULL;
+  coap_observer_t *obs = NULL;
+  coap_observer_t *next = NULL;
+
+  PRINTF("Remove check URL %p\n", url);
 
-  for (obs = (coap_observer_t*)list_head(observers_list); obs; obs = obs->next)
+  for (o = (coap_observee_t*)list_head(observees_list); o; o = next_o)
   {
-    PRINTF("Remove check URL %p\n", url);
-    if ((addr==NULL || (uip_ipaddr_cmp(&obs->addr, addr) && obs->port==port)) && (obs->url==url || memcmp(obs->url, url, strlen(obs->url))==0))
+    next_o = o->next;
+    if (o->url!=url && memcmp(o->url, url, strlen(o->url))!=0)
+    {
+      continue;
+    }
+    for (obs = (coap_observer_t*)list_head(o->observers); obs; obs = next)
     {
-      coap_remove_observer(obs);
-      removed++;
+      next = obs->next;
+      if (addr==NULL || (uip_ipaddr_cmp(&obs->addr, addr) && obs->port==port))
+      {
+        coap_remove_observer(obs);
+        removed++;
+      }
     }
   }
   return removed;
@@ -152,70 +313,152 @@ int
 coap_remove_observer_by_mid(uip_ipaddr_t *addr, uint16_t port, uint16_t mid)
 {
   int removed = 0;
-  coap_observer_t* obs = NULL;
+  coap_observee_t *o = NULL;
+  coap_observee_t *next_o = NULL;
+  coap_observer_t *obs = NULL;
+  coap_observer_t *next = NULL;
 
-  for (obs = (coap_observer_t*)list_head(observers_list); obs; obs = obs->next)
+  PRINTF("Remove check MID %u\n", mid);
+
+  for (o = (coap_observee_t*)list_head(observees_list); o; o = next_o)
   {
-    PRINTF("Remove check MID %u\n", mid);
-    if (uip_ipaddr_cmp(&obs->addr, addr) && obs->port==port && obs->last_mid==mid)
+    next_o = o->next;
+    for (obs = (coap_observer_t*)list_head(o->observers); obs; obs = next)
     {
-      coap_remove_observer(obs);
-      removed++;
+      next = obs->next;
+      if (uip_ipaddr_cmp(&obs->addr, addr) && obs->port==port && obs->last_mid==mid)
+      {
+        coap_remove_observer(obs);
+        removed++;
+      }
     }
   }
   return removed;
 }
+
+int
+coap_clear_notification_by_mid(uip_ipaddr_t *addr, uint16_t port, uint16_t mid)
+{
+  coap_observee_t *o = NULL;
+  coap_observer_t *obs = NULL;
+
+  for (o = (coap_observee_t*)list_head(observees_list); o; o = o->next)
+  {
+    for (obs = (coap_observer_t*)list_head(o->observers); obs; obs = obs->next)
+    {
+      if (obs->retrans_counter && uip_ipaddr_cmp(&obs->addr, addr) && obs->port==port && obs->last_mid==mid)
+      {
+        PRINTF("Notification %u acknowledged\n", mid);
+        obs->retrans_counter = 0;
+        schedule_retransmissions();
+        return 1;
+      }
+    }
+  }
+  return 0;
+}
 /*-----------------------------------------------------------------------------------*/
 void
 coap_notify_observers(resource_t *resource, int32_t obs_counter, void *notification)
 {
   coap_packet_t *const coap_res = (coap_packet_t *) notification;
-  coap_observer_t* obs = NULL;
-  uint8_t preferred_type = coap_res->type;
+  coap_observee_t *o = get_observee(resource->url);
+  coap_observer_t *obs = NULL;
+  uint16_t len;
 
   PRINTF("Observing: Notification from %s\n", resource->url);
 
-  /* Iterate over observers. */
-  for (obs = (coap_observer_t*)list_head(observers_list); obs; obs = obs->next)
+  if (o==NULL)
+  {
+    return;
+  }
+
+  /* Serialize the notification once, leaving room for the longest Token in front. */
+  if (obs_counter>=0) coap_set_header_observe(coap_res, obs_counter);
+  coap_res->token_len = 0;
+  coap_res->mid = 0;
+  if ((len = coap_serialize_message(coap_res, o->notification+COAP_TOKEN_LEN))==0)
+  {
+    PRINTF("Observing: Serialization failed\n");
+    return;
+  }
+  o->notification_len = len;
+  o->type = coap_res->type;
+  o->code = coap_res->code;
+
+  /* Iterate over the observers of this resource only. */
+  for (obs = (coap_observer_t*)list_head(o->observers); obs; obs = obs->next)
   {
-    if (obs->url==resource->url) /* using RESOURCE url pointer as handle */
+    PRINTF("           Observer ");
+    PRINT6ADDR(&obs->addr);
+    PRINTF(":%u\n", obs->port);
+
+    /* Update last MID for ACK and RST matching. */
+    obs->last_mid = coap_get_mid();
+
+    /*
+     * Use CON to check whether client is still there/interested after COAP_OBSERVING_REFRESH_INTERVAL.
+     * A new notification replaces an unacknowledged one, but keeps its retransmission counter and timeout.
+     */
+    if (obs->retrans_counter==0 && (o->type==COAP_TYPE_CON || stimer_expired(&obs->refresh_timer)))
     {
-      coap_transaction_t *transaction = NULL;
+      PRINTF("           Sending CON\n");
+      stimer_restart(&obs->refresh_timer);
+      obs->retrans_counter = 1;
+      timer_set(&obs->retrans_timer, coap_get_initial_timeout(&obs->addr, NULL));
+    }
 
-      /*TODO implement special transaction for CON, sharing the same buffer to allow for more observers. */
+    send_notification(o, obs);
+  }
 
-      if ( (transaction = coap_new_transaction(coap_get_mid(), &obs->addr, obs->port)) )
+  schedule_retransmissions();
+}
+/*-----------------------------------------------------------------------------------*/
+void
+coap_check_notifications(void)
+{
+  coap_observee_t *o = NULL;
+  coap_observee_t *next_o = NULL;
+  coap_observer_t *obs = NULL;
+  coap_observer_t *next = NULL;
+  uip_ipaddr_t addr;
+  uint16_t port;
+
+restart:
+  for (o = (coap_observee_t*)list_head(observees_list); o; o = next_o)
+  {
+    next_o = o->next;
+    for (obs = (coap_observer_t*)list_head(o->observers); obs; obs = next)
+    {
+      next = obs->next;
+      if (obs->retrans_counter && timer_expired(&obs->retrans_timer))
       {
-        PRINTF("           Observer ");
-        PRINT6ADDR(&obs->addr);
-        PRINTF(":%u\n", obs->port);
-
-        /* Update last MID for RST matching. */
-        obs->last_mid = transaction->mid;
+        if (obs->retrans_counter>COAP_MAX_RETRANSMIT)
+        {
+          /* Timed out; the client is gone. */
+          PRINTF("Notification timeout\n");
+          ++coap_transaction_stats.timeouts;
 
-        /* Prepare response */
-        coap_res->mid = transaction->mid;
-        if (obs_counter>=0) coap_set_header_observe(coap_res, obs_counter);
-        coap_set_header_token(coap_res, obs->token, obs->token_len);
+          /* Copy the client first, as obs is freed during the removal. */
+          uip_ipaddr_copy(&addr, &obs->addr);
+          port = obs->port;
+          coap_remove_observer_by_client(&addr, port);
 
-        /* Use CON to check whether client is still there/interested after COAP_OBSERVING_REFRESH_INTERVAL. */
-        if (stimer_expired(&obs->refresh_timer))
-        {
-          PRINTF("           Refreshing with CON\n");
-          coap_res->type = COAP_TYPE_CON;
-          stimer_restart(&obs->refresh_timer);
-        }
-        else
-        {
-          coap_res->type = preferred_type;
+          /* The removal may have freed the observee and other observers. */
+          goto restart;
         }
 
-        transaction->packet_len = coap_serialize_message(coap_res, transaction->packet);
-
-        coap_send_transaction(transaction);
+        PRINTF("Retransmitting notification %u (%u)\n", obs->last_mid, obs->retrans_counter);
+        ++(obs->retrans_counter);
+        ++coap_transaction_stats.retransmissions;
+        obs->retrans_timer.start += obs->retrans_timer.interval;
+        obs->retrans_timer.interval <<= 1; /* double */
+        send_notification(o, obs);
       }
     }
   }
+
+  schedule_retransmissions();
 }
 /*-----------------------------------------------------------------------------------*/
 void
@@ -238,7 +481,7 @@ coap_observe_handler(resource_t *resource, void *request, void *response)
          * For demonstration purposes only. A subscription should return the same representation as a normal GET.
          * TODO: Comment the following line for any real application.
          */
-        coap_set_payload(coap_res, content, snprintf(content, sizeof(content), "Added %u/%u", list_length(observers_list), COAP_MAX_OBSERVERS));
+        coap_set_payload(coap_res, content, snprintf(content, sizeof(content), "Added %u/%u", observer_count, COAP_MAX_OBSERVERS));
       }
       else
       {
@@ -47,13 +47,17 @@
 #define COAP_MAX_OBSERVERS    COAP_MAX_OPEN_TRANSACTIONS-1
 #endif /* COAP_MAX_OBSERVERS */
 
+/*
+ * The number of resources that can be observed at the same time. Each one holds a notification buffer
+ * shared by all of its observers, so CON notifications do not need transaction buffers.
+ */
+#ifndef COAP_MAX_OBSERVED_RESOURCES
+#define COAP_MAX_OBSERVED_RESOURCES    2
+#endif /* COAP_MAX_OBSERVED_RESOURCES */
+
 /* Interval in seconds in which NON notifies are changed to CON notifies to check client. */
 #define COAP_OBSERVING_REFRESH_INTERVAL  60
 
-#if COAP_MAX_OPEN_TRANSACTIONS<COAP_MAX_OBSERVERS
-#warning "COAP_MAX_OPEN_TRANSACTIONS smaller than COAP_MAX_OBSERVERS: cannot handle CON notifications"
-#endif
-
 typedef struct coap_observer {
   struct coap_observer *next; /* for LIST */
 
@@ -64,9 +68,11 @@ typedef struct coap_observer {
   uint8_t token[COAP_TOKEN_LEN];
   uint16_t last_mid;
   struct stimer refresh_timer;
-} coap_observer_t;
 
-list_t coap_get_observers(void);
+  /* Retransmission state of an unacknowledged CON notification; the counter is 0 if there is none. */
+  uint8_t retrans_counter;
+  struct timer retrans_timer;
+} coap_observer_t;
 
 coap_observer_t *coap_add_observer(uip_ipaddr_t *addr, uint16_t port, const uint8_t *token, size_t token_len, const char *url);
 
@@ -75,8 +81,10 @@ int coap_remove_observer_by_client(uip_ipaddr_t *addr, uint16_t port);
 int coap_remove_observer_by_token(uip_ipaddr_t *addr, uint16_t port, uint8_t *token, size_t token_len);
 int coap_remove_observer_by_url(uip_ipaddr_t *addr, uint16_t port, const char *url);
 int coap_remove_observer_by_mid(uip_ipaddr_t *addr, uint16_t port, uint16_t mid);
+int coap_clear_notification_by_mid(uip_ipaddr_t *addr, uint16_t port, uint16_t mid);
 
 void coap_notify_observers(resource_t *resource, int32_t obs_counter, void *notification);
+void coap_check_notifications(void);
 
 void coap_observe_handler(resource_t *resource, void *request, void *response);
 
@@ -36,19 +36,14 @@
  *      Matthias Kovatsch <kovatsch@inf.ethz.ch>
  */
 
+#include <string.h>
+
 #include "contiki.h"
 #include "contiki-net.h"
 
 #include "er-coap-13-transactions.h"
 #include "er-coap-13-observing.h"
 
-/*
- * Modulo mask (+1 and +0.5 for rounding) for a random number to get the tick number for the random
- * retransmission time between COAP_RESPONSE_TIMEOUT and COAP_RESPONSE_TIMEOUT*COAP_RESPONSE_RANDOM_FACTOR.
- */
-#define COAP_RESPONSE_TIMEOUT_TICKS         (CLOCK_SECOND * COAP_RESPONSE_TIMEOUT)
-#define COAP_RESPONSE_TIMEOUT_BACKOFF_MASK  ((CLOCK_SECOND * COAP_RESPONSE_TIMEOUT * (COAP_RESPONSE_RANDOM_FACTOR - 1)) + 1.5)
-
 #define DEBUG 0
 #if DEBUG
 #include <stdio.h>
@@ -65,9 +60,253 @@
 MEMB(transactions_memb, coap_transaction_t, COAP_MAX_OPEN_TRANSACTIONS);
 LIST(transactions_list);
 
+#define TRANSACTION_IN_FLIGHT   0x01
+#define TRANSACTION_DEFERRED    0x02
+
+#define BACKOFF_DEFAULT         8 /* quarters, i.e., doubling */
+
+struct coap_transaction_stats coap_transaction_stats;
 
 static struct process *transaction_handler_process = NULL;
+static struct etimer retrans_etimer;
+
+#if COAP_CONGESTION_CONTROL
+/* Per-destination RTO state; index 0 is the strong, index 1 the weak estimator. */
+typedef struct coap_rto_entry {
+  uip_ipaddr_t addr;
+  clock_time_t rto;
+  clock_time_t srtt[2];
+  clock_time_t rttvar[2];
+  clock_time_t updated;
+  clock_time_t used;
+  uint8_t flags;
+} coap_rto_entry_t;
+
+#define RTO_ENTRY_USED          0x80
+#define RTO_ENTRY_ESTIMATOR(weak) (1<<(weak))
+
+static coap_rto_entry_t rto_entries[COAP_MAX_RTO_ENTRIES];
+#endif /* COAP_CONGESTION_CONTROL */
+
+/*----------------------------------------------------------------------------*/
+/*- RTO estimation -----------------------------------------------------------*/
+/*----------------------------------------------------------------------------*/
+#if COAP_CONGESTION_CONTROL
+static coap_rto_entry_t *
+get_rto_entry(uip_ipaddr_t *addr, int create)
+{
+  coap_rto_entry_t *e = NULL;
+  coap_rto_entry_t *lru = NULL;
+  clock_time_t now = clock_time();
+  int i;
+
+  for (i=0; i<COAP_MAX_RTO_ENTRIES; ++i)
+  {
+    e = &rto_entries[i];
+    if ((e->flags & RTO_ENTRY_USED) && uip_ipaddr_cmp(&e->addr, addr))
+    {
+      e->used = now;
+      return e;
+    }
+    if (lru==NULL || !(e->flags & RTO_ENTRY_USED) || ((lru->flags & RTO_ENTRY_USED) && (clock_time_t)(now - e->used) > (clock_time_t)(now - lru->used)))
+    {
+      lru = e;
+    }
+  }
+
+  if (!create)
+  {
+    return NULL;
+  }
+
+  PRINTF("New RTO entry for ");
+  PRINT6ADDR(addr);
+  PRINTF("\n");
+
+  memset(lru, 0, sizeof(*lru));
+  uip_ipaddr_copy(&lru->addr, addr);
+  lru->rto = COAP_RESPONSE_TIMEOUT_TICKS;
+  lru->updated = now;
+  lru->used = now;
+  lru->flags = RTO_ENTRY_USED;
+  return lru;
+}
+/*----------------------------------------------------------------------------*/
+static void
+age_rto(coap_rto_entry_t *e)
+{
+  clock_time_t idle = clock_time() - e->updated;
+
+  /* Unrefreshed estimates drift back towards the default. */
+  if (e->rto < CLOCK_SECOND && idle > 16 * e->rto)
+  {
+    e->rto <<= 1;
+    e->updated = clock_time();
+  }
+  else if (e->rto > 3 * CLOCK_SECOND && idle > 4 * e->rto)
+  {
+    e->rto = (e->rto + COAP_RESPONSE_TIMEOUT_TICKS) / 2;
+    e->updated = clock_time();
+  }
+}
+/*----------------------------------------------------------------------------*/
+static void
+update_rto(uip_ipaddr_t *addr, clock_time_t rtt, uint8_t weak)
+{
+  coap_rto_entry_t *e = get_rto_entry(addr, 1);
+  clock_time_t estimate;
+  clock_time_t diff;
+
+  if (!(e->flags & RTO_ENTRY_ESTIMATOR(weak)))
+  {
+    e->srtt[weak] = rtt;
+    e->rttvar[weak] = rtt / 2;
+    e->flags |= RTO_ENTRY_ESTIMATOR(weak);
+  }
+  else
+  {
+    diff = e->srtt[weak] > rtt ? e->srtt[weak] - rtt : rtt - e->srtt[weak];
+    e->rttvar[weak] = (3 * e->rttvar[weak] + diff) / 4;
+    e->srtt[weak] = (7 * e->srtt[weak] + rtt) / 8;
+  }
+
+  /* The weak estimator includes the backoff and is trusted less. */
+  if (weak)
+  {
+    estimate = e->srtt[1] + e->rttvar[1];
+    e->rto = (estimate + 3 * e->rto) / 4;
+  }
+  else
+  {
+    estimate = e->srtt[0] + 4 * e->rttvar[0];
+    e->rto = (estimate + e->rto) / 2;
+  }
+
+  if (e->rto==0) e->rto = 1;
+  if (e->rto > COAP_RTO_MAX_TICKS) e->rto = COAP_RTO_MAX_TICKS;
+  e->updated = clock_time();
+
+  PRINTF("RTT %lu (%s) -> RTO %lu\n", (unsigned long) rtt, weak ? "weak" : "strong", (unsigned long) e->rto);
+}
+#endif /* COAP_CONGESTION_CONTROL */
+/*----------------------------------------------------------------------------*/
+clock_time_t
+coap_get_initial_timeout(uip_ipaddr_t *addr, uint8_t *backoff)
+{
+#if COAP_CONGESTION_CONTROL
+  coap_rto_entry_t *e = get_rto_entry(addr, 0);
+  clock_time_t rto = COAP_RESPONSE_TIMEOUT_TICKS;
+
+  if (e)
+  {
+    age_rto(e);
+    rto = e->rto;
+  }
+
+  if (backoff)
+  {
+    /* Variable backoff: short RTOs back off faster, long ones slower. */
+    *backoff = rto < CLOCK_SECOND ? 12 : (rto > 3 * CLOCK_SECOND ? 6 : BACKOFF_DEFAULT);
+  }
+  return rto + (random_rand() % (rto / 2 + 1));
+#else
+  if (backoff)
+  {
+    *backoff = BACKOFF_DEFAULT;
+  }
+  return COAP_RESPONSE_TIMEOUT_TICKS + (random_rand() % (clock_time_t) COAP_RESPONSE_TIMEOUT_BACKOFF_MASK);
+#endif /* COAP_CONGESTION_CONTROL */
+}
+/*----------------------------------------------------------------------------*/
+/*- Shared retransmission timer ----------------------------------------------*/
+/*----------------------------------------------------------------------------*/
+static clock_time_t
+time_left(coap_transaction_t *t)
+{
+  return timer_expired(&t->retrans_timer) ? 0 : timer_remaining(&t->retrans_timer);
+}
+/*----------------------------------------------------------------------------*/
+static void
+schedule_timer(void)
+{
+  coap_transaction_t *t = (coap_transaction_t*)list_head(transactions_list);
+
+  if (t && (t->flags & TRANSACTION_IN_FLIGHT))
+  {
+    /* The timer event is handled by the transaction handler process. */
+    PROCESS_CONTEXT_BEGIN(transaction_handler_process);
+    etimer_set(&retrans_etimer, time_left(t));
+    PROCESS_CONTEXT_END(transaction_handler_process);
+  }
+  else
+  {
+    etimer_stop(&retrans_etimer);
+  }
+}
+/*----------------------------------------------------------------------------*/
+/* Keeps the list ordered by deadline, with unscheduled transactions at the end. */
+static void
+insert_transaction(coap_transaction_t *t)
+{
+  coap_transaction_t *prev = NULL;
+  coap_transaction_t *i = NULL;
+  clock_time_t left = time_left(t);
 
+  list_remove(transactions_list, t);
+
+  if (t->flags & TRANSACTION_IN_FLIGHT)
+  {
+    for (i = (coap_transaction_t*)list_head(transactions_list); i; i = i->next)
+    {
+      if (!(i->flags & TRANSACTION_IN_FLIGHT) || time_left(i) > left)
+      {
+        break;
+      }
+      prev = i;
+    }
+    list_insert(transactions_list, prev, t);
+  }
+  else
+  {
+    list_add(transactions_list, t);
+  }
+}
+/*----------------------------------------------------------------------------*/
+static int
+count_in_flight(uip_ipaddr_t *addr)
+{
+  coap_transaction_t *t = NULL;
+  int n = 0;
+
+  for (t = (coap_transaction_t*)list_head(transactions_list); t; t = t->next)
+  {
+    if ((t->flags & TRANSACTION_IN_FLIGHT) && uip_ipaddr_cmp(&t->addr, addr))
+    {
+      ++n;
+    }
+  }
+  return n;
+}
+/*----------------------------------------------------------------------------*/
+static void
+send_deferred(uip_ipaddr_t *addr)
+{
+  coap_transaction_t *t = NULL;
+
+  for (t = (coap_transaction_t*)list_head(transactions_list); t; t = t->next)
+  {
+    if ((t->flags & TRANSACTION_DEFERRED) && uip_ipaddr_cmp(&t->addr, addr))
+    {
+      PRINTF("Releasing deferred transaction %u\n", t->mid);
+      t->flags &= ~TRANSACTION_DEFERRED;
+      coap_send_transaction(t);
+      return;
+    }
+  }
+}
+/*----------------------------------------------------------------------------*/
+/*- Transaction API ----------------------------------------------------------*/
+/*----------------------------------------------------------------------------*/
 void
 coap_register_as_transaction_handler()
 {
@@ -83,6 +322,7 @@ coap_new_transaction(uint16_t mid, uip_ipaddr_t *addr, uint16_t port)
   {
     t->mid = mid;
     t->retrans_counter = 0;
+    t->flags = 0;
 
     /* save client address */
     uip_ipaddr_copy(&t->addr, addr);
@@ -97,60 +337,81 @@ coap_new_transaction(uint16_t mid, uip_ipaddr_t *addr, uint16_t port)
 void
 coap_send_transaction(coap_transaction_t *t)
 {
-  PRINTF("Sending transaction %u\n", t->mid);
+  clock_time_t interval;
 
-  coap_send_message(&t->addr, t->port, t->packet, t->packet_len);
+  if (COAP_TYPE_CON!=((COAP_HEADER_TYPE_MASK & t->packet[0])>>COAP_HEADER_TYPE_POSITION))
+  {
+    PRINTF("Sending transaction %u\n", t->mid);
+    coap_send_message(&t->addr, t->port, t->packet, t->packet_len);
+    coap_clear_transaction(t);
+    return;
+  }
 
-  if (COAP_TYPE_CON==((COAP_HEADER_TYPE_MASK & t->packet[0])>>COAP_HEADER_TYPE_POSITION))
+  if (t->retrans_counter==0)
   {
-    if (t->retrans_counter<COAP_MAX_RETRANSMIT)
+    if (!(t->flags & TRANSACTION_IN_FLIGHT) && count_in_flight(&t->addr)>=COAP_NSTART)
     {
-      /* Not timed out yet. */
-      PRINTF("Keeping transaction %u\n", t->mid);
-
-      if (t->retrans_counter==0)
+      /* Wait for an outstanding exchange with this destination to complete. */
+      PRINTF("Deferring transaction %u\n", t->mid);
+      if (!(t->flags & TRANSACTION_DEFERRED))
       {
-        t->retrans_timer.timer.interval = COAP_RESPONSE_TIMEOUT_TICKS + (random_rand() % (clock_time_t) COAP_RESPONSE_TIMEOUT_BACKOFF_MASK);
-        PRINTF("Initial interval %f\n", (float)t->retrans_timer.timer.interval/CLOCK_SECOND);
-      }
-      else
-      {
-        t->retrans_timer.timer.interval <<= 1; /* double */
-        PRINTF("Doubled (%u) interval %f\n", t->retrans_counter, (float)t->retrans_timer.timer.interval/CLOCK_SECOND);
+        t->flags |= TRANSACTION_DEFERRED;
+        ++coap_transaction_stats.deferred;
       }
+      return;
+    }
 
-      /*FIXME
-       * Hack: Setting timer for responsible process.
-       * Maybe there is a better way, but avoid posting everything to the process.
-       */
-      struct process *process_actual = PROCESS_CURRENT();
-      process_current = transaction_handler_process;
-      etimer_restart(&t->retrans_timer); /* interval updated above */
-      process_current = process_actual;
+    interval = coap_get_initial_timeout(&t->addr, &t->backoff);
+    t->flags = TRANSACTION_IN_FLIGHT;
+    t->first_sent = clock_time();
+    ++coap_transaction_stats.transmissions;
+    PRINTF("Initial interval %lu\n", (unsigned long) interval);
+  }
+  else if (t->retrans_counter<=COAP_MAX_RETRANSMIT)
+  {
+    interval = (clock_time_t) (((uint32_t) t->retrans_timer.interval * t->backoff) / 4);
+    if (interval > COAP_RTO_MAX_TICKS) interval = COAP_RTO_MAX_TICKS;
+    ++coap_transaction_stats.retransmissions;
+    PRINTF("Backed off (%u) interval %lu\n", t->retrans_counter, (unsigned long) interval);
+  }
+  else
+  {
+    /* Timed out. */
+    PRINTF("Timeout\n");
+    restful_response_handler callback = t->callback;
+    void *callback_data = t->callback_data;
 
-      t = NULL;
-    }
-    else
-    {
-      /* Timed out. */
-      PRINTF("Timeout\n");
-      restful_response_handler callback = t->callback;
-      void *callback_data = t->callback_data;
+    ++coap_transaction_stats.timeouts;
 
-      /* handle observers */
-      coap_remove_observer_by_client(&t->addr, t->port);
+    /* handle observers */
+    coap_remove_observer_by_client(&t->addr, t->port);
 
-      coap_clear_transaction(t);
+    coap_clear_transaction(t);
 
-      if (callback) {
-        callback(callback_data, NULL);
-      }
+    if (callback) {
+      callback(callback_data, NULL);
     }
+    return;
   }
-  else
+
+  PRINTF("Sending transaction %u\n", t->mid);
+  coap_send_message(&t->addr, t->port, t->packet, t->packet_len);
+
+  timer_set(&t->retrans_timer, interval);
+  insert_transaction(t);
+  schedule_timer();
+}
+
+void
+coap_transaction_acked(coap_transaction_t *t)
+{
+#if COAP_CONGESTION_CONTROL
+  /* Samples after more than two retransmissions are too ambiguous to use. */
+  if (t && (t->flags & TRANSACTION_IN_FLIGHT) && t->retrans_counter<=2)
   {
-    coap_clear_transaction(t);
+    update_rto(&t->addr, clock_time() - t->first_sent, t->retrans_counter>0);
   }
+#endif /* COAP_CONGESTION_CONTROL */
 }
 
 void
@@ -158,11 +419,21 @@ coap_clear_transaction(coap_transaction_t *t)
 {
   if (t)
   {
+    uint8_t in_flight = t->flags & TRANSACTION_IN_FLIGHT;
+    uip_ipaddr_t addr;
+
+    uip_ipaddr_copy(&addr, &t->addr);
+
     PRINTF("Freeing transaction %u: %p\n", t->mid, t);
 
-    etimer_stop(&t->retrans_timer);
     list_remove(transactions_list, t);
     memb_free(&transactions_memb, t);
+
+    if (in_flight)
+    {
+      schedule_timer();
+      send_deferred(&addr);
+    }
   }
 }
 
@@ -187,13 +458,13 @@ coap_check_transactions()
 {
   coap_transaction_t *t = NULL;
 
-  for (t = (coap_transaction_t*)list_head(transactions_list); t; t = t->next)
+  /* Only the head can expire first; deferred transactions are at the end. */
+  while ((t = (coap_transaction_t*)list_head(transactions_list)) && (t->flags & TRANSACTION_IN_FLIGHT) && timer_expired(&t->retrans_timer))
   {
-    if (etimer_expired(&t->retrans_timer))
-    {
-      ++(t->retrans_counter);
-      PRINTF("Retransmitting %u (%u)\n", t->mid, t->retrans_counter);
-      coap_send_transaction(t);
-    }
+    ++(t->retrans_counter);
+    PRINTF("Retransmitting %u (%u)\n", t->mid, t->retrans_counter);
+    coap_send_transaction(t);
   }
+
+  schedule_timer();
 }
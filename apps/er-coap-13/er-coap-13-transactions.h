@@ -48,13 +48,48 @@
 #define COAP_MAX_OPEN_TRANSACTIONS 4 
 #endif /* COAP_MAX_OPEN_TRANSACTIONS */
 
+/*
+ * Modulo mask (+1 and +0.5 for rounding) for a random number to get the tick number for the random
+ * retransmission time between COAP_RESPONSE_TIMEOUT and COAP_RESPONSE_TIMEOUT*COAP_RESPONSE_RANDOM_FACTOR.
+ */
+#define COAP_RESPONSE_TIMEOUT_TICKS         (CLOCK_SECOND * COAP_RESPONSE_TIMEOUT)
+#define COAP_RESPONSE_TIMEOUT_BACKOFF_MASK  ((CLOCK_SECOND * COAP_RESPONSE_TIMEOUT * (COAP_RESPONSE_RANDOM_FACTOR - 1)) + 1.5)
+
+/*
+ * Maximum number of outstanding CON messages per destination; further ones wait in the pool until
+ * an earlier one is acknowledged or times out.
+ */
+#ifndef COAP_NSTART
+#define COAP_NSTART 1
+#endif /* COAP_NSTART */
+
+/*
+ * Estimate the retransmission timeout per destination from measured round-trip times (CoCoA).
+ * When disabled, every destination uses COAP_RESPONSE_TIMEOUT with binary exponential backoff.
+ */
+#ifndef COAP_CONGESTION_CONTROL
+#define COAP_CONGESTION_CONTROL 1
+#endif /* COAP_CONGESTION_CONTROL */
+
+/*
+ * The number of destinations for which RTO estimates are kept (least recently used are replaced).
+ */
+#ifndef COAP_MAX_RTO_ENTRIES
+#define COAP_MAX_RTO_ENTRIES 4
+#endif /* COAP_MAX_RTO_ENTRIES */
+
+#define COAP_RTO_MAX_TICKS                  (CLOCK_SECOND * 60)
+
 /* container for transactions with message buffer and retransmission info */
 typedef struct coap_transaction {
-  struct coap_transaction *next; /* for LIST */
+  struct coap_transaction *next; /* for LIST, ordered by retransmission deadline */
 
   uint16_t mid;
-  struct etimer retrans_timer;
+  struct timer retrans_timer;
   uint8_t retrans_counter;
+  uint8_t backoff; /* timeout multiplier in quarters */
+  uint8_t flags;
+  clock_time_t first_sent;
 
   uip_ipaddr_t addr;
   uint16_t port;
@@ -66,13 +101,25 @@ typedef struct coap_transaction {
   uint8_t packet[COAP_MAX_PACKET_SIZE+1]; /* +1 for the terminating '\0' to simply and savely use snprintf(buf, len+1, "", ...) in the resource handler. */
 } coap_transaction_t;
 
+struct coap_transaction_stats {
+  uint16_t transmissions;   /* initial transmissions of CON messages */
+  uint16_t retransmissions;
+  uint16_t timeouts;
+  uint16_t deferred;        /* CON messages held back by NSTART */
+};
+
+extern struct coap_transaction_stats coap_transaction_stats;
+
 void coap_register_as_transaction_handler();
 
 coap_transaction_t *coap_new_transaction(uint16_t mid, uip_ipaddr_t *addr, uint16_t port);
 void coap_send_transaction(coap_transaction_t *t);
+void coap_transaction_acked(coap_transaction_t *t);
 void coap_clear_transaction(coap_transaction_t *t);
 coap_transaction_t *coap_get_transaction_by_mid(uint16_t mid);
 
+clock_time_t coap_get_initial_timeout(uip_ipaddr_t *addr, uint8_t *backoff);
+
 void coap_check_transactions();
 
 #endif /* COAP_TRANSACTIONS_H_ */
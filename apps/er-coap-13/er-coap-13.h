@@ -129,6 +129,7 @@ typedef enum {
   VALID_2_03 = 67,                      /* NOT_MODIFIED */
   CHANGED_2_04 = 68,                    /* CHANGED */
   CONTENT_2_05 = 69,                    /* OK */
+  CONTINUE_2_31 = 95,                   /* CONTINUE (blockwise transfers) */
 
   BAD_REQUEST_4_00 = 128,               /* BAD_REQUEST */
   UNAUTHORIZED_4_01 = 129,              /* UNAUTHORIZED */
@@ -137,6 +138,7 @@ typedef enum {
   NOT_FOUND_4_04 = 132,                 /* NOT_FOUND */
   METHOD_NOT_ALLOWED_4_05 = 133,        /* METHOD_NOT_ALLOWED */
   NOT_ACCEPTABLE_4_06 = 134,            /* NOT_ACCEPTABLE */
+  REQUEST_ENTITY_INCOMPLETE_4_08 = 136, /* REQUEST_ENTITY_INCOMPLETE (blockwise transfers) */
   PRECONDITION_FAILED_4_12 = 140,       /* BAD_REQUEST */
   REQUEST_ENTITY_TOO_LARGE_4_13 = 141,  /* REQUEST_ENTITY_TOO_LARGE */
   UNSUPPORTED_MEDIA_TYPE_4_15 = 143,    /* UNSUPPORTED_MEDIA_TYPE */
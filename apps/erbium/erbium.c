@@ -58,11 +58,273 @@ PROCESS_NAME(rest_manager_process);
 LIST(restful_services);
 LIST(restful_periodic_services);
 
+/*
+ * Resources are dispatched through a trie of URI-path segments, so the lookup time depends on the
+ * path length instead of the number of resources. The segments point into the resource URLs.
+ */
+struct rest_trie_node {
+  struct rest_trie_node *parent;
+  struct rest_trie_node *child;
+  struct rest_trie_node *next; /* sibling */
+  const char *segment;
+  uint8_t segment_len;
+  resource_t *resource;
+};
+
+MEMB(trie_nodes, struct rest_trie_node, REST_MAX_TRIE_NODES);
+static struct rest_trie_node trie_root;
+static uint8_t trie_complete = 1;
+
+/*-----------------------------------------------------------------------------------*/
+static int
+segment_length(const char *url, int len)
+{
+  int i;
+  for (i=0; i<len && url[i]!='/'; ++i);
+  return i;
+}
+
+static int
+trie_insert(resource_t* resource)
+{
+  struct rest_trie_node *node = &trie_root;
+  struct rest_trie_node *child = NULL;
+  struct rest_trie_node **last = NULL;
+  const char *url = resource->url;
+  int len = strlen(url);
+  int seg_len;
+
+  if (len && url[0]=='/')
+  {
+    ++url;
+    --len;
+  }
+
+  while (len>0)
+  {
+    seg_len = segment_length(url, len);
+
+    for (last = &node->child; (child = *last); last = &child->next)
+    {
+      if (child->segment_len==seg_len && memcmp(child->segment, url, seg_len)==0)
+      {
+        break;
+      }
+    }
+
+    /* Append new segments to keep the activation order for .well-known/core. */
+    if (child==NULL)
+    {
+      if (seg_len>0xFF || (child = memb_alloc(&trie_nodes))==NULL)
+      {
+        return 0;
+      }
+      child->parent = node;
+      child->child = NULL;
+      child->segment = url;
+      child->segment_len = seg_len;
+      child->resource = NULL;
+      child->next = NULL;
+      *last = child;
+    }
+
+    node = child;
+    url += seg_len;
+    len -= seg_len;
+    if (len>0)
+    {
+      /* skip '/' */
+      ++url;
+      --len;
+    }
+  }
+
+  /* The first resource activated for a URL handles it, as with the linear search. */
+  if (node->resource==NULL)
+  {
+    node->resource = resource;
+  }
+  resource->node = node;
+
+  return 1;
+}
+
+static resource_t *
+trie_lookup(struct rest_trie_node *node, const char *url, int len)
+{
+  struct rest_trie_node *child = NULL;
+  resource_t *resource = NULL;
+  int seg_len;
+  int rest;
+
+  if (len==0 && node->resource)
+  {
+    return node->resource;
+  }
+
+  if (len>0)
+  {
+    seg_len = segment_length(url, len);
+    rest = seg_len<len ? seg_len+1 : seg_len;
+
+    for (child = node->child; child; child = child->next)
+    {
+      if (child->segment_len==seg_len && memcmp(child->segment, url, seg_len)==0)
+      {
+        if ((resource = trie_lookup(child, url+rest, len-rest)))
+        {
+          return resource;
+        }
+        break;
+      }
+    }
+    for (child = node->child; child; child = child->next)
+    {
+      if (child->segment_len==1 && child->segment[0]=='*')
+      {
+        if ((resource = trie_lookup(child, url+rest, len-rest)))
+        {
+          return resource;
+        }
+        break;
+      }
+    }
+  }
+
+  if (node->resource && (node->resource->flags & HAS_SUB_RESOURCES))
+  {
+    return node->resource;
+  }
+
+  return NULL;
+}
+
+/*
+ * Linear fallback for an exhausted node pool. Resources are ranked the way trie_lookup() walks the
+ * trie, so the pool size does not change which resource handles a URL: segment by segment, a literal
+ * match beats a "*" segment, which beats a parent resource with HAS_SUB_RESOURCES.
+ */
+static int
+pattern_rank(const char **pattern, int *plen, const char *seg, int seg_len)
+{
+  int p_seg;
+  int rank;
+
+  if (*plen==0)
+  {
+    return 0;
+  }
+
+  p_seg = segment_length(*pattern, *plen);
+  if (p_seg==seg_len && memcmp(*pattern, seg, seg_len)==0)
+  {
+    rank = 2;
+  }
+  else if (p_seg==1 && **pattern=='*')
+  {
+    rank = 1;
+  }
+  else
+  {
+    return -1;
+  }
+
+  *pattern += p_seg;
+  *plen -= p_seg;
+  if (*plen>0)
+  {
+    /* skip '/' */
+    ++*pattern;
+    --*plen;
+  }
+  return rank;
+}
+
+static void
+pattern_start(resource_t *resource, const char **pattern, int *plen)
+{
+  *pattern = resource->url;
+  *plen = strlen(resource->url);
+  if (*plen && **pattern=='/')
+  {
+    ++*pattern;
+    --*plen;
+  }
+}
+
+static int
+linear_match(resource_t *resource, const char *url, int len)
+{
+  const char *pattern;
+  int plen;
+  int seg_len;
+  int rest;
+  int rank;
+
+  pattern_start(resource, &pattern, &plen);
+
+  while (len>0)
+  {
+    seg_len = segment_length(url, len);
+    rank = pattern_rank(&pattern, &plen, url, seg_len);
+    if (rank<0)
+    {
+      return 0;
+    }
+    if (rank==0)
+    {
+      return (resource->flags & HAS_SUB_RESOURCES)!=0;
+    }
+    rest = seg_len<len ? seg_len+1 : seg_len;
+    url += rest;
+    len -= rest;
+  }
+
+  return plen==0;
+}
+
+/* Returns non-zero if a, which matches url, ranks above b, which matches url too. */
+static int
+linear_better(resource_t *a, resource_t *b, const char *url, int len)
+{
+  const char *pa, *pb;
+  int la, lb;
+  int seg_len;
+  int rest;
+  int rank_a, rank_b;
+
+  pattern_start(a, &pa, &la);
+  pattern_start(b, &pb, &lb);
+
+  while (len>0)
+  {
+    seg_len = segment_length(url, len);
+    rank_a = pattern_rank(&pa, &la, url, seg_len);
+    rank_b = pattern_rank(&pb, &lb, url, seg_len);
+    if (rank_a!=rank_b)
+    {
+      return rank_a>rank_b;
+    }
+    if (rank_a==0)
+    {
+      break;
+    }
+    rest = seg_len<len ? seg_len+1 : seg_len;
+    url += rest;
+    len -= rest;
+  }
+
+  return 0;
+}
+/*-----------------------------------------------------------------------------------*/
 
 void
 rest_init_engine(void)
 {
   list_init(restful_services);
+  memb_init(&trie_nodes);
+  memset(&trie_root, 0, sizeof(trie_root));
+  trie_complete = 1;
 
   REST.set_service_callback(rest_invoke_restful_service);
 
@@ -88,6 +350,12 @@ rest_activate_resource(resource_t* resource)
   }
 
   list_add(restful_services, resource);
+
+  if (trie_complete && !trie_insert(resource))
+  {
+    PRINTF("Out of trie nodes, using linear dispatch\n");
+    trie_complete = 0;
+  }
 }
 
 void
@@ -112,6 +380,70 @@ rest_get_resources(void)
   return restful_services;
 }
 
+resource_t *
+rest_find_resource(const char *url, int url_len)
+{
+  resource_t* resource = NULL;
+  resource_t* best = NULL;
+
+  if (url_len && url[0]=='/')
+  {
+    ++url;
+    --url_len;
+  }
+
+  if (trie_complete)
+  {
+    return trie_lookup(&trie_root, url, url_len);
+  }
+
+  for (resource = (resource_t*)list_head(restful_services); resource; resource = resource->next)
+  {
+    /* The first resource activated wins a tie, as in trie_insert(). */
+    if (linear_match(resource, url, url_len) && (best==NULL || linear_better(resource, best, url, url_len)))
+    {
+      best = resource;
+    }
+  }
+  return best;
+}
+
+resource_t *
+rest_get_next_resource(resource_t *resource)
+{
+  struct rest_trie_node *node = NULL;
+
+  if (!trie_complete)
+  {
+    return resource ? resource->next : (resource_t*)list_head(restful_services);
+  }
+
+  node = resource ? resource->node : &trie_root;
+
+  /* Pre-order traversal, skipping nodes without a resource. */
+  do
+  {
+    if (node->child)
+    {
+      node = node->child;
+    }
+    else
+    {
+      while (node && node->next==NULL)
+      {
+        node = node->parent;
+      }
+      if (node==NULL)
+      {
+        return NULL;
+      }
+      node = node->next;
+    }
+  } while (node->resource==NULL);
+
+  return node->resource;
+}
+
 
 void*
 rest_get_user_data(resource_t* resource)
@@ -149,42 +481,37 @@ rest_invoke_restful_service(void* request, void* response, uint8_t *buffer, uint
   uint8_t found = 0;
   uint8_t allowed = 0;
 
-  PRINTF("rest_invoke_restful_service url /%.*s -->\n", url_len, url);
-
   resource_t* resource = NULL;
   const char *url = NULL;
+  int url_len = REST.get_url(request, &url);
 
-  for (resource = (resource_t*)list_head(restful_services); resource; resource = resource->next)
+  PRINTF("rest_invoke_restful_service url /%.*s -->\n", url_len, url);
+
+  if ((resource = rest_find_resource(url, url_len)))
   {
-    /*if the web service handles that kind of requests and urls matches*/
-    if ((REST.get_url(request, &url)==strlen(resource->url) || (REST.get_url(request, &url)>strlen(resource->url) && (resource->flags & HAS_SUB_RESOURCES)))
-        && strncmp(resource->url, url, strlen(resource->url)) == 0)
-    {
-      found = 1;
-      rest_resource_flags_t method = REST.get_method_type(request);
+    found = 1;
+    rest_resource_flags_t method = REST.get_method_type(request);
 
-      PRINTF("method %u, resource->flags %u\n", (uint16_t)method, resource->flags);
+    PRINTF("method %u, resource->flags %u\n", (uint16_t)method, resource->flags);
 
-      if (resource->flags & method)
+    if (resource->flags & method)
+    {
+      allowed = 1;
+
+      /*call pre handler if it exists*/
+      if (!resource->pre_handler || resource->pre_handler(resource, request, response))
       {
-        allowed = 1;
+        /* call handler function*/
+        resource->handler(request, response, buffer, buffer_size, offset);
 
-        /*call pre handler if it exists*/
-        if (!resource->pre_handler || resource->pre_handler(resource, request, response))
+        /*call post handler if it exists*/
+        if (resource->post_handler)
         {
-          /* call handler function*/
-          resource->handler(request, response, buffer, buffer_size, offset);
-
-          /*call post handler if it exists*/
-          if (resource->post_handler)
-          {
-            resource->post_handler(resource, request, response);
-          }
+          resource->post_handler(resource, request, response);
         }
-      } else {
-        REST.set_response_status(response, REST.status.METHOD_NOT_ALLOWED);
       }
-      break;
+    } else {
+      REST.set_response_status(response, REST.status.METHOD_NOT_ALLOWED);
     }
   }
 
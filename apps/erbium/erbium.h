@@ -56,6 +56,14 @@
 #define MIN(a, b) ((a) < (b)? (a) : (b))
 #endif /* MIN */
 
+/*
+ * The number of URI-path segment nodes used for resource dispatch. Each distinct segment of the activated
+ * resource URLs needs one node. If they run out, dispatch falls back to a linear search of all resources.
+ */
+#ifndef REST_MAX_TRIE_NODES
+#define REST_MAX_TRIE_NODES     16
+#endif
+
 /* REST method types */
 typedef enum {
   /* methods to handle */
@@ -135,6 +143,8 @@ struct rest_implementation_type
   unsigned int APPLICATION_X_OBIX_BINARY;
 };
 
+struct rest_trie_node;
+
 /*
  * Data structure representing a resource in REST.
  */
@@ -148,6 +158,7 @@ struct resource_s {
   restful_post_handler post_handler; /* to be called after handler, may perform finalizations (cleanup, etc) */
   void* user_data; /* pointer to user specific data */
   unsigned int benchmark; /* to benchmark resource handler, used for separate response */
+  struct rest_trie_node *node; /* URI-path node for dispatch, set on activation */
 };
 typedef struct resource_s resource_t;
 
@@ -317,6 +328,17 @@ int rest_invoke_restful_service(void* request, void* response, uint8_t *buffer,
  */
 list_t rest_get_resources(void);
 
+/*
+ * Returns the resource handling the given URI-path, or NULL. Exact matches take precedence over "*" segments,
+ * which match any single segment, and those over the closest parent resource flagged with HAS_SUB_RESOURCES.
+ */
+resource_t *rest_find_resource(const char *url, int url_len);
+
+/*
+ * Iterates over the activated resources in URI-path order, starting with NULL.
+ */
+resource_t *rest_get_next_resource(resource_t *resource);
+
 /*
  * Getter and setter methods for user specific data.
  */
@@ -339,6 +361,7 @@ void rest_set_post_handler(resource_t* resource, restful_post_handler post_handl
 
 /*
  * Sets resource flags for special properties, e.g., handling of sub-resources of URI-path.
+ * Sub-resources are matched per URI-path segment: a resource "a" handles "a/b", but not "ab".
  */
 void rest_set_special_flags(resource_t* resource, rest_resource_flags_t flags);
 
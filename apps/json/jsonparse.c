@@ -54,36 +54,50 @@ pop(struct jsonparse_state *state)
 }
 /*--------------------------------------------------------------------*/
 /* will pass by the value and store the start and length of the value for
-   atomic types */
+   atomic types; returns 0 if a string is not terminated */
 /*--------------------------------------------------------------------*/
-static void
+static int
 atomic(struct jsonparse_state *state, char type)
 {
-  char c;
+  char c = 0;
 
   state->vstart = state->pos;
   state->vtype = type;
   if(type == JSON_TYPE_STRING || type == JSON_TYPE_PAIR_NAME) {
-    while((c = state->json[state->pos++]) && c != '"') {
+    /* the input need not be null-terminated, e.g., a CoAP payload */
+    while(state->pos < state->len &&
+          (c = state->json[state->pos++]) && c != '"') {
       if(c == '\\') {
         state->pos++;           /* skip current char */
       }
     }
+    if(state->pos > state->len || c != '"') {
+      state->vlen = 0;
+      return 0;
+    }
     state->vlen = state->pos - state->vstart - 1;
   } else if(type == JSON_TYPE_NUMBER) {
-    do {
+    while(state->pos < state->len) {
       c = state->json[state->pos];
-      if((c < '0' || c > '9') && c != '.') {
-        c = 0;
-      } else {
-        state->pos++;
+      if((c < '0' || c > '9') && c != '.' && c != '-' && c != '+' &&
+         c != 'e' && c != 'E') {
+        break;
       }
-    } while(c);
+      state->pos++;
+    }
     /* need to back one step since first char is already gone */
     state->vstart--;
     state->vlen = state->pos - state->vstart;
+  } else if(type == JSON_TYPE_NULL || type == JSON_TYPE_TRUE ||
+            type == JSON_TYPE_FALSE) {
+    while(state->pos < state->len &&
+          (c = state->json[state->pos]) >= 'a' && c <= 'z') {
+      state->pos++;
+    }
+    state->vstart--;
+    state->vlen = state->pos - state->vstart;
   }
-  /* no other types for now... */
+  return 1;
 }
 /*--------------------------------------------------------------------*/
 static void
@@ -92,7 +106,8 @@ skip_ws(struct jsonparse_state *state)
   char c;
 
   while(state->pos < state->len &&
-        ((c = state->json[state->pos]) == ' ' || c == '\n')) {
+        ((c = state->json[state->pos]) == ' ' || c == '\n' ||
+         c == '\r' || c == '\t')) {
     state->pos++;
   }
 }
@@ -115,6 +130,9 @@ jsonparse_next(struct jsonparse_state *state)
   char s;
 
   skip_ws(state);
+  if(state->pos >= state->len) {
+    return 0;
+  }
   c = state->json[state->pos];
   s = jsonparse_get_type(state);
   state->pos++;
@@ -131,6 +149,9 @@ jsonparse_next(struct jsonparse_state *state)
     }
     if(s == '{') {
       pop(state);
+      /* a closed container completes the value of an enclosing pair */
+      state->vtype = c;
+      state->vlen = 0;
     } else {
       state->error = JSON_ERROR_SYNTAX;
       return JSON_TYPE_ERROR;
@@ -139,6 +160,8 @@ jsonparse_next(struct jsonparse_state *state)
   case ']':
     if(s == '[') {
       pop(state);
+      state->vtype = c;
+      state->vlen = 0;
     } else {
       state->error = JSON_ERROR_UNEXPECTED_END_OF_ARRAY;
       return JSON_TYPE_ERROR;
@@ -160,7 +183,11 @@ jsonparse_next(struct jsonparse_state *state)
     return c;
   case '"':
     if(s == '{' || s == '[' || s == ':') {
-      atomic(state, c = (s == '{' ? JSON_TYPE_PAIR_NAME : c));
+      if(!atomic(state, c = (s == '{' ? JSON_TYPE_PAIR_NAME : c))) {
+        /* the string runs to the end of the input */
+        state->error = JSON_ERROR_SYNTAX;
+        return JSON_TYPE_ERROR;
+      }
     } else {
       state->error = JSON_ERROR_UNEXPECTED_STRING;
       return JSON_TYPE_ERROR;
@@ -176,9 +203,13 @@ jsonparse_next(struct jsonparse_state *state)
     return c;
   default:
     if(s == ':' || s == '[') {
-      if(c <= '9' && c >= '0') {
+      if((c <= '9' && c >= '0') || c == '-') {
         atomic(state, JSON_TYPE_NUMBER);
         return JSON_TYPE_NUMBER;
+      } else if(c == JSON_TYPE_NULL || c == JSON_TYPE_TRUE ||
+                c == JSON_TYPE_FALSE) {
+        atomic(state, c);
+        return c;
       }
     }
   }
@@ -0,0 +1,546 @@
+/*
+ * Copyright (c) 2026, the smart-HOP contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         Schema-driven JSON decoding and encoding of C structs
+ */
+
+#include "jsonschema.h"
+#include "jsonparse.h"
+#include <string.h>
+
+#define DEBUG 0
+#if DEBUG
+#include <stdio.h>
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+
+struct output {
+  char *buf;
+  int size;
+  int pos;
+};
+
+/*---------------------------------------------------------------------------*/
+/* Decoding */
+/*---------------------------------------------------------------------------*/
+static const struct jsonschema_field *
+find_field(const struct jsonschema *schema, struct jsonparse_state *state)
+{
+  const struct jsonschema_field *f;
+  int len = jsonparse_get_len(state);
+  int i;
+
+  for(i = 0; i < schema->count; i++) {
+    f = &schema->fields[i];
+    /* the name sits between ,"  and ": */
+    if(f->key_len - 4 == len &&
+       memcmp(f->key + 2, &state->json[state->vstart], len) == 0) {
+      return f;
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static int
+skip_value(struct jsonparse_state *state, int type)
+{
+  int depth;
+
+  if(type != '{' && type != '[') {
+    return 1;
+  }
+  depth = state->depth - 1;
+  while(state->depth > depth) {
+    type = jsonparse_next(state);
+    if(type == JSON_TYPE_ERROR) {
+      return 0;
+    }
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static int
+store_int(const struct jsonschema_field *f, uint8_t *p,
+          struct jsonparse_state *state)
+{
+  const char *s = &state->json[state->vstart];
+  const char *end = s + state->vlen;
+  uint32_t v = 0;
+  uint32_t max;
+  uint8_t negative = 0;
+  uint8_t digit;
+
+  if(f->size != 1 && f->size != 2 && f->size != 4) {
+    return 0;
+  }
+
+  if(s < end && *s == '-') {
+    if(f->type == JSONSCHEMA_TYPE_UINT) {
+      return 0;
+    }
+    negative = 1;
+    s++;
+  }
+
+  /* The largest magnitude that fits the field: 2^(8n) - 1 unsigned,
+     2^(8n-1) - 1 signed, and one more for negative values. */
+  max = f->size == 4 ? 0xffffffffUL : (1UL << (f->size * 8)) - 1;
+  if(f->type != JSONSCHEMA_TYPE_UINT) {
+    max = (max >> 1) + negative;
+  }
+
+  if(s == end) {
+    return 0;
+  }
+  while(s < end) {
+    if(*s < '0' || *s > '9') {
+      /* Fractions and exponents do not fit an integer field. */
+      return 0;
+    }
+    digit = *s++ - '0';
+    if(v > (max - digit) / 10) {
+      return 0;
+    }
+    v = v * 10 + digit;
+  }
+  if(negative) {
+    v = -v;
+  }
+
+  switch(f->size) {
+  case 1:
+    *p = (uint8_t)v;
+    break;
+  case 2:
+    *(uint16_t *)p = (uint16_t)v;
+    break;
+  case 4:
+    *(uint32_t *)p = v;
+    break;
+  default:
+    return 0;
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static int
+hex4(const char *s, const char *end, uint16_t *v)
+{
+  int i;
+  char c;
+
+  if(end - s < 4) {
+    return 0;
+  }
+  *v = 0;
+  for(i = 0; i < 4; i++) {
+    c = s[i];
+    if(c >= '0' && c <= '9') {
+      c -= '0';
+    } else if(c >= 'a' && c <= 'f') {
+      c -= 'a' - 10;
+    } else if(c >= 'A' && c <= 'F') {
+      c -= 'A' - 10;
+    } else {
+      return 0;
+    }
+    *v = (*v << 4) | c;
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+/* Unescapes the character at *s into buf as UTF-8 and advances *s.
+   Returns the number of bytes, or 0 for an invalid escape, a lone
+   surrogate or a NUL, which the C string could not hold. */
+static int
+unescape_char(const char **s, const char *end, char *buf)
+{
+  uint32_t u;
+  uint16_t lo;
+  char c;
+
+  c = *(*s)++;
+  if(c != '\\') {
+    buf[0] = c;
+    return 1;
+  }
+  if(*s >= end) {
+    return 0;
+  }
+  c = *(*s)++;
+  switch(c) {
+  case '"':
+  case '\\':
+  case '/':
+    buf[0] = c;
+    return 1;
+  case 'b':
+    buf[0] = '\b';
+    return 1;
+  case 'f':
+    buf[0] = '\f';
+    return 1;
+  case 'n':
+    buf[0] = '\n';
+    return 1;
+  case 'r':
+    buf[0] = '\r';
+    return 1;
+  case 't':
+    buf[0] = '\t';
+    return 1;
+  case 'u':
+    if(!hex4(*s, end, &lo)) {
+      return 0;
+    }
+    *s += 4;
+    u = lo;
+    if(u >= 0xdc00 && u <= 0xdfff) {
+      return 0;
+    }
+    if(u >= 0xd800 && u <= 0xdbff) {
+      /* a high surrogate must be followed by an escaped low one */
+      if(end - *s < 6 || (*s)[0] != '\\' || (*s)[1] != 'u' ||
+         !hex4(*s + 2, end, &lo) || lo < 0xdc00 || lo > 0xdfff) {
+        return 0;
+      }
+      *s += 6;
+      u = 0x10000 + ((u - 0xd800) << 10) + (lo - 0xdc00);
+    }
+    break;
+  default:
+    return 0;
+  }
+
+  if(u == 0) {
+    return 0;
+  } else if(u < 0x80) {
+    buf[0] = u;
+    return 1;
+  } else if(u < 0x800) {
+    buf[0] = 0xc0 | (u >> 6);
+    buf[1] = 0x80 | (u & 0x3f);
+    return 2;
+  } else if(u < 0x10000) {
+    buf[0] = 0xe0 | (u >> 12);
+    buf[1] = 0x80 | ((u >> 6) & 0x3f);
+    buf[2] = 0x80 | (u & 0x3f);
+    return 3;
+  }
+  buf[0] = 0xf0 | (u >> 18);
+  buf[1] = 0x80 | ((u >> 12) & 0x3f);
+  buf[2] = 0x80 | ((u >> 6) & 0x3f);
+  buf[3] = 0x80 | (u & 0x3f);
+  return 4;
+}
+/*---------------------------------------------------------------------------*/
+static int
+store_string(const struct jsonschema_field *f, char *p,
+             struct jsonparse_state *state)
+{
+  const char *start = &state->json[state->vstart];
+  const char *end = start + state->vlen;
+  const char *s;
+  char *out = p;
+  char *last = p + f->size - 1;
+  char buf[4];
+  int n;
+
+  /* check the whole string first, so that a bad one leaves the field
+     untouched */
+  for(s = start; s < end;) {
+    if(unescape_char(&s, end, buf) == 0) {
+      return 0;
+    }
+  }
+
+  /* truncate at a character boundary */
+  for(s = start; s < end;) {
+    n = unescape_char(&s, end, buf);
+    if(n > last - out) {
+      break;
+    }
+    memcpy(out, buf, n);
+    out += n;
+  }
+  *out = '\0';
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static int
+store_value(const struct jsonschema_field *f, uint8_t *p, int type,
+            struct jsonparse_state *state)
+{
+  struct jsonschema_strref *ref;
+
+  switch(f->type) {
+  case JSON_TYPE_INT:
+  case JSONSCHEMA_TYPE_UINT:
+    return type == JSON_TYPE_NUMBER && store_int(f, p, state);
+  case JSONSCHEMA_TYPE_BOOL:
+    if(type != JSON_TYPE_TRUE && type != JSON_TYPE_FALSE) {
+      return 0;
+    }
+    *p = type == JSON_TYPE_TRUE;
+    return 1;
+  case JSON_TYPE_STRING:
+    return type == JSON_TYPE_STRING && store_string(f, (char *)p, state);
+  case JSONSCHEMA_TYPE_STRREF:
+    if(type != JSON_TYPE_STRING) {
+      return 0;
+    }
+    ref = (struct jsonschema_strref *)p;
+    ref->str = &state->json[state->vstart];
+    ref->len = state->vlen;
+    return 1;
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+/* called after the opening brace, returns after the closing one */
+static int
+decode_object(const struct jsonschema *schema, uint8_t *base,
+              struct jsonparse_state *state)
+{
+  const struct jsonschema_field *f;
+  int decoded = 0;
+  int type;
+  int r;
+
+  while((type = jsonparse_next(state)) != '}') {
+    if(type == ',') {
+      continue;
+    }
+    if(type != JSON_TYPE_PAIR_NAME) {
+      return -1;
+    }
+    f = find_field(schema, state);
+    if(jsonparse_next(state) != ':') {
+      return -1;
+    }
+    type = jsonparse_next(state);
+    if(type == JSON_TYPE_ERROR) {
+      return -1;
+    }
+
+    if(f == NULL) {
+      PRINTF("jsonschema: skipping unknown pair\n");
+      r = skip_value(state, type);
+    } else if(type == '{' && f->type == JSON_TYPE_OBJECT) {
+      r = decode_object(f->schema, base + f->offset, state);
+      if(r < 0) {
+        return -1;
+      }
+      decoded += r;
+      continue;
+    } else if(type == '{' || type == '[') {
+      r = skip_value(state, type);
+    } else {
+      decoded += store_value(f, base + f->offset, type, state);
+      r = 1;
+    }
+    if(!r) {
+      return -1;
+    }
+  }
+  return decoded;
+}
+/*---------------------------------------------------------------------------*/
+int
+jsonschema_decode(const struct jsonschema *schema, void *data,
+                  const char *json, int len)
+{
+  struct jsonparse_state state;
+
+  jsonparse_setup(&state, json, len);
+  if(jsonparse_next(&state) != '{') {
+    return -1;
+  }
+  return decode_object(schema, data, &state);
+}
+/*---------------------------------------------------------------------------*/
+/* Encoding */
+/*---------------------------------------------------------------------------*/
+static void
+put(struct output *out, const char *text, int len)
+{
+  if(out->pos + len <= out->size) {
+    memcpy(out->buf + out->pos, text, len);
+  }
+  /* keep counting so that the caller learns about the overflow */
+  out->pos += len;
+}
+/*---------------------------------------------------------------------------*/
+static void
+put_char(struct output *out, char c)
+{
+  if(out->pos < out->size) {
+    out->buf[out->pos] = c;
+  }
+  out->pos++;
+}
+/*---------------------------------------------------------------------------*/
+static void
+put_int(struct output *out, uint32_t value, uint8_t negative)
+{
+  char buf[11];
+  int l = sizeof(buf);
+
+  if(negative) {
+    put_char(out, '-');
+    value = -value;
+  }
+  do {
+    buf[--l] = '0' + (value % 10);
+    value /= 10;
+  } while(value > 0);
+  put(out, &buf[l], sizeof(buf) - l);
+}
+/*---------------------------------------------------------------------------*/
+static void
+put_string(struct output *out, const char *text, int len)
+{
+  static const char controls[] = "\b\f\n\r\t";
+  static const char escapes[] = "bfnrt";
+  static const char hex[] = "0123456789abcdef";
+  const char *run = text;
+  const char *end = text + len;
+  const char *e;
+  unsigned char c;
+
+  put_char(out, '"');
+  while(text < end) {
+    c = *text;
+    if(c == '"' || c == '\\' || c < 0x20) {
+      put(out, run, text - run);
+      put_char(out, '\\');
+      if(c >= 0x20) {
+        put_char(out, c);
+      } else if(c != 0 && (e = strchr(controls, c)) != NULL) {
+        put_char(out, escapes[e - controls]);
+      } else {
+        /* other control characters have no short escape */
+        put(out, "u00", 3);
+        put_char(out, hex[c >> 4]);
+        put_char(out, hex[c & 0x0f]);
+      }
+      run = text + 1;
+    }
+    text++;
+  }
+  put(out, run, text - run);
+  put_char(out, '"');
+}
+/*---------------------------------------------------------------------------*/
+static void
+encode_object(const struct jsonschema *schema, const uint8_t *base,
+              struct output *out)
+{
+  const struct jsonschema_field *f;
+  const uint8_t *p;
+  const uint8_t *nul;
+  const struct jsonschema_strref *ref;
+  uint32_t v;
+  int i;
+
+  put_char(out, '{');
+  for(i = 0; i < schema->count; i++) {
+    f = &schema->fields[i];
+    p = base + f->offset;
+    /* the first pair goes without the leading comma */
+    put(out, f->key + (i == 0), f->key_len - (i == 0));
+
+    switch(f->type) {
+    case JSON_TYPE_INT:
+    case JSONSCHEMA_TYPE_UINT:
+      if(f->size == 1) {
+        v = f->type == JSON_TYPE_INT ? (uint32_t)(int32_t)*(int8_t *)p : *p;
+      } else if(f->size == 2) {
+        v = f->type == JSON_TYPE_INT ?
+          (uint32_t)(int32_t)*(int16_t *)p : *(uint16_t *)p;
+      } else {
+        v = *(uint32_t *)p;
+      }
+      put_int(out, v, f->type == JSON_TYPE_INT && (int32_t)v < 0);
+      break;
+    case JSONSCHEMA_TYPE_BOOL:
+      if(*p) {
+        put(out, "true", 4);
+      } else {
+        put(out, "false", 5);
+      }
+      break;
+    case JSON_TYPE_STRING:
+      nul = memchr(p, '\0', f->size);
+      put_string(out, (const char *)p, nul ? nul - p : f->size);
+      break;
+    case JSONSCHEMA_TYPE_STRREF:
+      ref = (const struct jsonschema_strref *)p;
+      /* already escaped when it came from the decoder */
+      put_char(out, '"');
+      put(out, ref->str, ref->len);
+      put_char(out, '"');
+      break;
+    case JSON_TYPE_OBJECT:
+      encode_object(f->schema, p, out);
+      break;
+    default:
+      put(out, "null", 4);
+      break;
+    }
+  }
+  put_char(out, '}');
+}
+/*---------------------------------------------------------------------------*/
+int
+jsonschema_encode(const struct jsonschema *schema, const void *data,
+                  char *buf, int size)
+{
+  struct output out;
+
+  out.buf = buf;
+  out.size = size;
+  out.pos = 0;
+
+  encode_object(schema, data, &out);
+  if(out.pos > size) {
+    return -1;
+  }
+  if(out.pos < size) {
+    buf[out.pos] = '\0';
+  }
+  return out.pos;
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2026, the smart-HOP contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         Schema-driven JSON decoding and encoding of C structs
+ */
+
+#ifndef JSONSCHEMA_H_
+#define JSONSCHEMA_H_
+
+#include "contiki-conf.h"
+#include "json.h"
+#include <stddef.h>
+
+/*
+ * A schema binds the pairs of a JSON object to the fields of a C struct:
+ *
+ *   struct reading { int16_t temp; uint8_t on; char unit[4]; };
+ *
+ *   JSONSCHEMA(reading_schema,
+ *              JSONSCHEMA_INT(struct reading, temp, "temp"),
+ *              JSONSCHEMA_BOOL(struct reading, on, "on"),
+ *              JSONSCHEMA_STRING(struct reading, unit, "unit"));
+ *
+ * Decoding walks the input once and stores each value straight into its
+ * field. Encoding writes into a caller buffer; the quoted pair names are
+ * built at compile time and copied as a whole.
+ */
+
+#define JSONSCHEMA_TYPE_UINT   'U'
+#define JSONSCHEMA_TYPE_BOOL   'B'
+#define JSONSCHEMA_TYPE_STRREF 'R'
+
+/* A string left in the input buffer, escapes included. */
+struct jsonschema_strref {
+  const char *str;
+  uint16_t len;
+};
+
+struct jsonschema;
+
+struct jsonschema_field {
+  const char *key;              /* ,"name": */
+  uint8_t key_len;
+  uint8_t type;
+  uint16_t offset;
+  uint16_t size;
+  const struct jsonschema *schema;
+};
+
+struct jsonschema {
+  uint8_t count;
+  const struct jsonschema_field *fields;
+};
+
+#define JSONSCHEMA_FIELD_SIZE(type, field) sizeof(((type *)0)->field)
+
+#define JSONSCHEMA_FIELD(jtype, type, field, name, schema)               \
+  {",\"" name "\":", sizeof(",\"" name "\":") - 1, (jtype),             \
+   offsetof(type, field), JSONSCHEMA_FIELD_SIZE(type, field), (schema)}
+
+/* signed/unsigned integers of 1, 2 or 4 bytes */
+#define JSONSCHEMA_INT(type, field, name)                               \
+  JSONSCHEMA_FIELD(JSON_TYPE_INT, type, field, name, NULL)
+#define JSONSCHEMA_UINT(type, field, name)                              \
+  JSONSCHEMA_FIELD(JSONSCHEMA_TYPE_UINT, type, field, name, NULL)
+/* uint8_t, true or false */
+#define JSONSCHEMA_BOOL(type, field, name)                              \
+  JSONSCHEMA_FIELD(JSONSCHEMA_TYPE_BOOL, type, field, name, NULL)
+/* char array, unescaped to UTF-8 and truncated at a character on decoding */
+#define JSONSCHEMA_STRING(type, field, name)                            \
+  JSONSCHEMA_FIELD(JSON_TYPE_STRING, type, field, name, NULL)
+/* struct jsonschema_strref pointing into the decoded input */
+#define JSONSCHEMA_STRREF(type, field, name)                            \
+  JSONSCHEMA_FIELD(JSONSCHEMA_TYPE_STRREF, type, field, name, NULL)
+/* nested struct described by another schema */
+#define JSONSCHEMA_OBJECT(type, field, name, schema)                    \
+  JSONSCHEMA_FIELD(JSON_TYPE_OBJECT, type, field, name, &(schema))
+
+#define JSONSCHEMA(name, ...)                                           \
+  static const struct jsonschema_field jsonschema_field_##name[] = {__VA_ARGS__}; \
+  static const struct jsonschema name = {                               \
+    sizeof(jsonschema_field_##name)/sizeof(struct jsonschema_field),    \
+    jsonschema_field_##name }
+
+/**
+ * \brief      Decode a JSON object into a struct.
+ * \param schema The schema describing the struct
+ * \param data A pointer to the struct
+ * \param json The JSON text, need not be null-terminated
+ * \param len  The length of the JSON text
+ * \return     The number of fields set, or -1 on a syntax error
+ *
+ *             Pairs without a field in the schema, values of the
+ *             wrong type, numbers that do not fit their field and
+ *             strings with invalid escapes are skipped; fields
+ *             without a pair are left untouched.
+ */
+int jsonschema_decode(const struct jsonschema *schema, void *data,
+                      const char *json, int len);
+
+/**
+ * \brief      Encode a struct as a JSON object.
+ * \param schema The schema describing the struct
+ * \param data A pointer to the struct
+ * \param buf  The output buffer
+ * \param size The size of the output buffer
+ * \return     The length of the output, or -1 if it does not fit
+ *
+ *             The output is null-terminated if there is room for it.
+ */
+int jsonschema_encode(const struct jsonschema *schema, const void *data,
+                      char *buf, int size);
+
+#endif /* JSONSCHEMA_H_ */
@@ -0,0 +1,256 @@
+/*
+ * Copyright (c) 2026, the smart-HOP contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Powertrace: binary trace buffer and the process that drains it
+ */
+
+#include "contiki.h"
+#include "lib/crc16.h"
+#include "net/rime/rimeaddr.h"
+#include "powertrace-trace.h"
+
+#ifdef POWERTRACE_CONF_TRACE_FILE
+#include "cfs/cfs.h"
+#endif /* POWERTRACE_CONF_TRACE_FILE */
+
+#include <stdio.h>
+
+#if (POWERTRACE_TRACE_BUFSIZE & (POWERTRACE_TRACE_BUFSIZE - 1)) != 0
+#error POWERTRACE_CONF_TRACE_BUFSIZE must be a power of two
+#endif
+
+#define MASK (POWERTRACE_TRACE_BUFSIZE - 1)
+
+static uint8_t buf[POWERTRACE_TRACE_BUFSIZE];
+
+/* Free-running positions: put_ptr is only written by the writer and
+   get_ptr only by the drain process. A record becomes visible to the
+   reader when put_ptr moves past its last byte. As in lib/ringbuf,
+   this relies on the positions being read and written atomically. */
+static volatile uint16_t put_ptr, get_ptr;
+
+/* Set while a record is being written. Records come from process
+   context and from the radio and MAC paths, which may run in
+   interrupt handlers. Handlers nest, so a write that finds the flag
+   set has preempted another one and must not touch put_ptr; one that
+   finds it clear runs to completion before the preempted write goes
+   on. */
+static volatile uint8_t writing;
+
+/* Records lost since start, and how many of them have been reported. */
+static volatile uint16_t dropped;
+static uint16_t dropped_reported;
+
+#ifdef POWERTRACE_CONF_TRACE_FILE
+static int fd = -1;
+#endif /* POWERTRACE_CONF_TRACE_FILE */
+
+PROCESS(powertrace_trace_process, "Powertrace trace");
+/*---------------------------------------------------------------------------*/
+void
+powertrace_record_init(struct powertrace_record *r, uint8_t type)
+{
+  r->type = type;
+  r->len = 0;
+  powertrace_record_put32(r, clock_time());
+  powertrace_record_put8(r, rimeaddr_node_addr.u8[0]);
+  powertrace_record_put8(r, rimeaddr_node_addr.u8[1]);
+}
+/*---------------------------------------------------------------------------*/
+void
+powertrace_record_put8(struct powertrace_record *r, uint8_t v)
+{
+  if(r->len < POWERTRACE_TRACE_MAX_PAYLOAD) {
+    r->data[r->len++] = v;
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+powertrace_record_put16(struct powertrace_record *r, uint16_t v)
+{
+  powertrace_record_put8(r, v & 0xff);
+  powertrace_record_put8(r, v >> 8);
+}
+/*---------------------------------------------------------------------------*/
+void
+powertrace_record_put32(struct powertrace_record *r, uint32_t v)
+{
+  powertrace_record_put16(r, v & 0xffff);
+  powertrace_record_put16(r, v >> 16);
+}
+/*---------------------------------------------------------------------------*/
+int
+powertrace_trace_write(const struct powertrace_record *r)
+{
+  uint16_t pos;
+  uint16_t crc;
+  uint8_t i;
+
+  if(writing) {
+    dropped++;
+    process_poll(&powertrace_trace_process);
+    return 0;
+  }
+  writing = 1;
+
+  if((uint16_t)(put_ptr - get_ptr) + r->len + POWERTRACE_TRACE_OVERHEAD >
+     POWERTRACE_TRACE_BUFSIZE) {
+    dropped++;
+    writing = 0;
+    process_poll(&powertrace_trace_process);
+    return 0;
+  }
+
+  pos = put_ptr;
+  buf[pos++ & MASK] = POWERTRACE_TRACE_SYNC1;
+  buf[pos++ & MASK] = POWERTRACE_TRACE_SYNC2;
+  buf[pos++ & MASK] = r->type;
+  buf[pos++ & MASK] = r->len;
+  crc = crc16_add(r->type, 0);
+  crc = crc16_add(r->len, crc);
+  for(i = 0; i < r->len; i++) {
+    buf[pos++ & MASK] = r->data[i];
+    crc = crc16_add(r->data[i], crc);
+  }
+  buf[pos++ & MASK] = crc & 0xff;
+  buf[pos++ & MASK] = crc >> 8;
+  put_ptr = pos;
+  writing = 0;
+
+  process_poll(&powertrace_trace_process);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+sink_write(const uint8_t *data, uint16_t len)
+{
+#ifdef POWERTRACE_CONF_TRACE_FILE
+  if(fd >= 0) {
+    cfs_write(fd, data, len);
+  }
+#else /* POWERTRACE_CONF_TRACE_FILE */
+  uint16_t i;
+
+  for(i = 0; i < len; i++) {
+    putchar(data[i]);
+  }
+#endif /* POWERTRACE_CONF_TRACE_FILE */
+}
+/*---------------------------------------------------------------------------*/
+static void
+report_dropped(void)
+{
+  struct powertrace_record r;
+  uint8_t frame[POWERTRACE_TRACE_OVERHEAD + 8];
+  uint16_t count;
+  uint16_t crc;
+  uint8_t i;
+
+  count = dropped - dropped_reported;
+  if(count == 0) {
+    return;
+  }
+  dropped_reported += count;
+
+  /* The drain process is not the writer of the buffer, so the record
+     goes straight to the sink. */
+  powertrace_record_init(&r, POWERTRACE_TRACE_DROPPED);
+  powertrace_record_put16(&r, count);
+  frame[0] = POWERTRACE_TRACE_SYNC1;
+  frame[1] = POWERTRACE_TRACE_SYNC2;
+  frame[2] = r.type;
+  frame[3] = r.len;
+  crc = crc16_add(r.type, 0);
+  crc = crc16_add(r.len, crc);
+  for(i = 0; i < r.len; i++) {
+    frame[4 + i] = r.data[i];
+    crc = crc16_add(r.data[i], crc);
+  }
+  frame[4 + i] = crc & 0xff;
+  frame[5 + i] = crc >> 8;
+  sink_write(frame, 6 + i);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(powertrace_trace_process, ev, data)
+{
+  static uint16_t len;
+  uint16_t start;
+
+  PROCESS_EXITHANDLER(
+#ifdef POWERTRACE_CONF_TRACE_FILE
+    if(fd >= 0) {
+      cfs_close(fd);
+      fd = -1;
+    }
+#endif /* POWERTRACE_CONF_TRACE_FILE */
+  );
+
+  PROCESS_BEGIN();
+
+#ifdef POWERTRACE_CONF_TRACE_FILE
+  fd = cfs_open(POWERTRACE_CONF_TRACE_FILE, CFS_WRITE | CFS_APPEND);
+#endif /* POWERTRACE_CONF_TRACE_FILE */
+
+  while(1) {
+    PROCESS_YIELD_UNTIL(ev == PROCESS_EVENT_POLL);
+
+    report_dropped();
+
+    /* Write the buffer out in chunks, and let other processes run in
+       between so that tracing never holds up the rest of the system. */
+    while((len = put_ptr - get_ptr) > 0) {
+      if(len > POWERTRACE_TRACE_CHUNK) {
+        len = POWERTRACE_TRACE_CHUNK;
+      }
+      start = get_ptr & MASK;
+      if(start + len > POWERTRACE_TRACE_BUFSIZE) {
+        len = POWERTRACE_TRACE_BUFSIZE - start;
+      }
+      sink_write(&buf[start], len);
+      get_ptr += len;
+      PROCESS_PAUSE();
+    }
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+void
+powertrace_trace_start(void)
+{
+  if(!process_is_running(&powertrace_trace_process)) {
+    process_start(&powertrace_trace_process, NULL);
+  }
+}
+/*---------------------------------------------------------------------------*/
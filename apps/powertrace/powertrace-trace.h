@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2026, the smart-HOP contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Binary trace records for powertrace
+ *
+ *         Records are written into a ring buffer, in interrupt or
+ *         process context, and a process drains the buffer to the
+ *         serial line or to a CFS file in bulk. The host-side
+ *         decoder in tools/powertrace turns the trace back into the
+ *         text reports that powertrace prints.
+ *
+ *         On the wire every record is framed as
+ *
+ *           0xa5 0x5a type len payload[len] crc16-lo crc16-hi
+ *
+ *         where the CRC (lib/crc16) covers type, len and the payload.
+ *         All payload fields are little endian.
+ */
+
+#ifndef POWERTRACE_TRACE_H
+#define POWERTRACE_TRACE_H
+
+#include "contiki-conf.h"
+
+#define POWERTRACE_TRACE_SYNC1        0xa5
+#define POWERTRACE_TRACE_SYNC2        0x5a
+
+/* Framing overhead: two sync bytes, type, length and the CRC. */
+#define POWERTRACE_TRACE_OVERHEAD     6
+
+/*
+ * Record types. Every payload starts with the 32-bit clock time and
+ * the two first bytes of the node's Rime address.
+ *
+ * POWER:    seqno(4) cpu(4) lpm(4) transmit(4) listen(4)
+ *           idle_transmit(4) idle_listen(4), all cumulative
+ * STATS:    seqno(4) channel(2) num_input(4) input_txtime(4)
+ *           input_rxtime(4) num_output(4) output_txtime(4)
+ *           output_rxtime(4), all cumulative
+ * STATS6:   as STATS, with proto(2) before the channel
+ * PACKET:   direction(1, 'I' or 'O') seqno(2) channel(2) type(1)
+ *           esender(2) txtime(4) rxtime(4)
+ * DROPPED:  count(2), records lost because the buffer was full
+ */
+#define POWERTRACE_TRACE_POWER        1
+#define POWERTRACE_TRACE_STATS        2
+#define POWERTRACE_TRACE_STATS6       3
+#define POWERTRACE_TRACE_PACKET       4
+#define POWERTRACE_TRACE_DROPPED      5
+
+/* Largest payload of the record types above. */
+#define POWERTRACE_TRACE_MAX_PAYLOAD  38
+
+#ifdef POWERTRACE_CONF_TRACE_BUFSIZE
+#define POWERTRACE_TRACE_BUFSIZE POWERTRACE_CONF_TRACE_BUFSIZE
+#else
+#define POWERTRACE_TRACE_BUFSIZE 512
+#endif
+
+/* Number of bytes the drain process writes before it yields. */
+#ifdef POWERTRACE_CONF_TRACE_CHUNK
+#define POWERTRACE_TRACE_CHUNK POWERTRACE_CONF_TRACE_CHUNK
+#else
+#define POWERTRACE_TRACE_CHUNK 64
+#endif
+
+/**
+ * A record being built. len is the number of payload bytes written so
+ * far; bytes that would not fit are silently left out.
+ */
+struct powertrace_record {
+  uint8_t type;
+  uint8_t len;
+  uint8_t data[POWERTRACE_TRACE_MAX_PAYLOAD];
+};
+
+void powertrace_record_init(struct powertrace_record *r, uint8_t type);
+void powertrace_record_put8(struct powertrace_record *r, uint8_t v);
+void powertrace_record_put16(struct powertrace_record *r, uint16_t v);
+void powertrace_record_put32(struct powertrace_record *r, uint32_t v);
+
+/**
+ * \brief      Queue a record for output
+ * \param r    The record
+ * \retval 1   The record was queued
+ * \retval 0   The buffer was full, or the call interrupted another
+ *             write, and the record was dropped
+ *
+ *             The whole record is queued, or nothing is. Records may
+ *             be written from process context and from interrupt
+ *             handlers: a write that preempts one in progress is
+ *             counted as dropped instead of interleaving with it.
+ */
+int powertrace_trace_write(const struct powertrace_record *r);
+
+/**
+ * \brief      Start the process that drains the trace buffer
+ *
+ *             The buffer is written to the serial line, or to the
+ *             CFS file POWERTRACE_CONF_TRACE_FILE if it is defined.
+ */
+void powertrace_trace_start(void);
+
+#endif /* POWERTRACE_TRACE_H */
@@ -41,6 +41,7 @@
 #include "contiki-lib.h"
 #include "sys/compower.h"
 #include "powertrace.h"
+#include "powertrace-trace.h"
 #include "net/rime.h"
 
 #include <stdio.h>
@@ -64,11 +65,78 @@ struct powertrace_sniff_stats {
 
 #define MAX_NUM_STATS  16
 
+/* Write binary trace records instead of printing text reports. */
+#ifdef POWERTRACE_CONF_BINARY
+#define POWERTRACE_BINARY POWERTRACE_CONF_BINARY
+#else
+#define POWERTRACE_BINARY 0
+#endif
+
 MEMB(stats_memb, struct powertrace_sniff_stats, MAX_NUM_STATS);
 LIST(stats_list);
 
 PROCESS(powertrace_process, "Periodic power output");
 /*---------------------------------------------------------------------------*/
+#if POWERTRACE_BINARY
+static void
+trace_print(uint32_t seqno)
+{
+  struct powertrace_record r;
+  struct powertrace_sniff_stats *s;
+
+  /* Only the cumulative values are recorded; the decoder computes the
+     per-period differences and percentages. */
+  powertrace_record_init(&r, POWERTRACE_TRACE_POWER);
+  powertrace_record_put32(&r, seqno);
+  powertrace_record_put32(&r, energest_type_time(ENERGEST_TYPE_CPU));
+  powertrace_record_put32(&r, energest_type_time(ENERGEST_TYPE_LPM));
+  powertrace_record_put32(&r, energest_type_time(ENERGEST_TYPE_TRANSMIT));
+  powertrace_record_put32(&r, energest_type_time(ENERGEST_TYPE_LISTEN));
+  powertrace_record_put32(&r, compower_idle_activity.transmit);
+  powertrace_record_put32(&r, compower_idle_activity.listen);
+  powertrace_trace_write(&r);
+
+  for(s = list_head(stats_list); s != NULL; s = list_item_next(s)) {
+#if UIP_CONF_IPV6
+    powertrace_record_init(&r, POWERTRACE_TRACE_STATS6);
+    powertrace_record_put32(&r, seqno);
+    powertrace_record_put16(&r, s->proto);
+#else
+    powertrace_record_init(&r, POWERTRACE_TRACE_STATS);
+    powertrace_record_put32(&r, seqno);
+#endif
+    powertrace_record_put16(&r, s->channel);
+    powertrace_record_put32(&r, s->num_input);
+    powertrace_record_put32(&r, s->input_txtime);
+    powertrace_record_put32(&r, s->input_rxtime);
+    powertrace_record_put32(&r, s->num_output);
+    powertrace_record_put32(&r, s->output_txtime);
+    powertrace_record_put32(&r, s->output_rxtime);
+    powertrace_trace_write(&r);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+trace_packet(uint8_t direction, uint16_t seqno)
+{
+  struct powertrace_record r;
+  const rimeaddr_t *esender;
+
+  esender = packetbuf_addr(PACKETBUF_ADDR_ESENDER);
+
+  powertrace_record_init(&r, POWERTRACE_TRACE_PACKET);
+  powertrace_record_put8(&r, direction);
+  powertrace_record_put16(&r, seqno);
+  powertrace_record_put16(&r, packetbuf_attr(PACKETBUF_ATTR_CHANNEL));
+  powertrace_record_put8(&r, packetbuf_attr(PACKETBUF_ATTR_PACKET_TYPE));
+  powertrace_record_put8(&r, esender->u8[0]);
+  powertrace_record_put8(&r, esender->u8[1]);
+  powertrace_record_put32(&r, packetbuf_attr(PACKETBUF_ATTR_TRANSMIT_TIME));
+  powertrace_record_put32(&r, packetbuf_attr(PACKETBUF_ATTR_LISTEN_TIME));
+  powertrace_trace_write(&r);
+}
+#endif /* POWERTRACE_BINARY */
+/*---------------------------------------------------------------------------*/
 void
 powertrace_print(char *str)
 {
@@ -88,6 +156,11 @@ powertrace_print(char *str)
 
   energest_flush();
 
+#if POWERTRACE_BINARY
+  trace_print(seqno++);
+  return;
+#endif /* POWERTRACE_BINARY */
+
   all_cpu = energest_type_time(ENERGEST_TYPE_CPU);
   all_lpm = energest_type_time(ENERGEST_TYPE_LPM);
   all_transmit = energest_type_time(ENERGEST_TYPE_TRANSMIT);
@@ -216,6 +289,9 @@ PROCESS_THREAD(powertrace_process, ev, data)
 void
 powertrace_start(clock_time_t period)
 {
+#if POWERTRACE_BINARY
+  powertrace_trace_start();
+#endif /* POWERTRACE_BINARY */
   process_start(&powertrace_process, (void *)&period);
 }
 /*---------------------------------------------------------------------------*/
@@ -274,12 +350,22 @@ add_packet_stats(int input_or_output)
 static void
 input_sniffer(void)
 {
+#if POWERTRACE_BINARY
+  static uint16_t seqno;
+
+  trace_packet('I', seqno++);
+#endif /* POWERTRACE_BINARY */
   add_packet_stats(INPUT);
 }
 /*---------------------------------------------------------------------------*/
 static void
 output_sniffer(int mac_status)
 {
+#if POWERTRACE_BINARY
+  static uint16_t seqno;
+
+  trace_packet('O', seqno++);
+#endif /* POWERTRACE_BINARY */
   add_packet_stats(OUTPUT);
 }
 /*---------------------------------------------------------------------------*/
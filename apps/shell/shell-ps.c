@@ -49,6 +49,39 @@ SHELL_COMMAND(ps_command,
 	      "ps",
 	      "ps: list all running processes",
 	      &shell_ps_process);
+#if PROCESS_CONF_PROFILE
+PROCESS(shell_procstat_process, "procstat");
+SHELL_COMMAND(procstat_command,
+	      "procstat",
+	      "procstat [reset]: print CPU time and call counts per process",
+	      &shell_procstat_process);
+PROCESS(shell_procstat_bin_process, "procstat-bin");
+SHELL_COMMAND(procstat_bin_command,
+	      "procstat-bin",
+	      "procstat-bin: output CPU time per process in binary format",
+	      &shell_procstat_bin_process);
+
+/* Binary records of procstat-bin. The len field holds the number of
+   16-bit words that follow it. A process record is followed by the
+   process name as data2. */
+struct procstat_msg {
+  uint16_t len;
+  uint16_t type;
+  uint32_t ticks;
+  uint32_t calls;
+  uint32_t max;
+};
+
+struct procstat_histogram_msg {
+  uint16_t len;
+  uint16_t type;
+  uint16_t event;
+  uint16_t buckets[PROCESS_PROFILE_BUCKETS];
+};
+
+#define PROCSTAT_TYPE_PROCESS   1
+#define PROCSTAT_TYPE_HISTOGRAM 2
+#endif /* PROCESS_CONF_PROFILE */
 /*---------------------------------------------------------------------------*/
 PROCESS_THREAD(shell_ps_process, ev, data)
 {
@@ -65,9 +98,107 @@ PROCESS_THREAD(shell_ps_process, ev, data)
   PROCESS_END();
 }
 /*---------------------------------------------------------------------------*/
+#if PROCESS_CONF_PROFILE
+static int
+histogram_used(int slot)
+{
+  int i;
+
+  for(i = 0; i < PROCESS_PROFILE_BUCKETS; i++) {
+    if(process_profile_histogram[slot][i] != 0) {
+      return 1;
+    }
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(shell_procstat_process, ev, data)
+{
+  struct process *p;
+  char buf[60];
+  int slot, i, n;
+  PROCESS_BEGIN();
+
+  if(data != NULL && strcmp((char *)data, "reset") == 0) {
+    process_profile_reset();
+    PROCESS_EXIT();
+  }
+
+  shell_output_str(&procstat_command,
+                   "Process: calls, rtimer ticks, longest call", "");
+  for(p = PROCESS_LIST(); p != NULL; p = p->next) {
+    snprintf(buf, sizeof(buf), "%.30s: %lu, %lu, %u",
+             PROCESS_NAME_STRING(p),
+             (unsigned long)p->profile.calls,
+             (unsigned long)p->profile.ticks,
+             (unsigned)p->profile.max);
+    shell_output_str(&procstat_command, buf, "");
+  }
+
+  shell_output_str(&procstat_command, "Event: calls per duration bucket", "");
+  for(slot = 0; slot < PROCESS_PROFILE_EVENTS; slot++) {
+    if(!histogram_used(slot)) {
+      continue;
+    }
+    if(slot == PROCESS_PROFILE_EVENTS - 1) {
+      n = snprintf(buf, sizeof(buf), "other:");
+    } else {
+      n = snprintf(buf, sizeof(buf), "0x%02x:", PROCESS_EVENT_NONE + slot);
+    }
+    for(i = 0; i < PROCESS_PROFILE_BUCKETS && n < sizeof(buf); i++) {
+      n += snprintf(&buf[n], sizeof(buf) - n, " %u",
+                    process_profile_histogram[slot][i]);
+    }
+    shell_output_str(&procstat_command, buf, "");
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(shell_procstat_bin_process, ev, data)
+{
+  struct process *p;
+  struct procstat_msg msg;
+  struct procstat_histogram_msg hmsg;
+  const char *name;
+  int slot;
+  PROCESS_BEGIN();
+
+  for(p = PROCESS_LIST(); p != NULL; p = p->next) {
+    msg.len = (sizeof(msg) - sizeof(msg.len)) / 2;
+    msg.type = PROCSTAT_TYPE_PROCESS;
+    msg.ticks = p->profile.ticks;
+    msg.calls = p->profile.calls;
+    msg.max = p->profile.max;
+    name = PROCESS_NAME_STRING(p);
+    shell_output(&procstat_bin_command, &msg, sizeof(msg),
+                 name, strlen(name) + 1);
+  }
+
+  for(slot = 0; slot < PROCESS_PROFILE_EVENTS; slot++) {
+    if(!histogram_used(slot)) {
+      continue;
+    }
+    hmsg.len = (sizeof(hmsg) - sizeof(hmsg.len)) / 2;
+    hmsg.type = PROCSTAT_TYPE_HISTOGRAM;
+    hmsg.event = slot == PROCESS_PROFILE_EVENTS - 1 ?
+      0 : PROCESS_EVENT_NONE + slot;
+    memcpy(hmsg.buckets, process_profile_histogram[slot],
+           sizeof(hmsg.buckets));
+    shell_output(&procstat_bin_command, &hmsg, sizeof(hmsg), "", 0);
+  }
+
+  PROCESS_END();
+}
+#endif /* PROCESS_CONF_PROFILE */
+/*---------------------------------------------------------------------------*/
 void
 shell_ps_init(void)
 {
   shell_register_command(&ps_command);
+#if PROCESS_CONF_PROFILE
+  shell_register_command(&procstat_command);
+  shell_register_command(&procstat_bin_command);
+#endif /* PROCESS_CONF_PROFILE */
 }
 /*---------------------------------------------------------------------------*/
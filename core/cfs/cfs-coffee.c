@@ -58,6 +58,7 @@
 #include "cfs/cfs.h"
 #include "cfs-coffee-arch.h"
 #include "cfs/cfs-coffee.h"
+#include "sys/rtimer.h"
 
 /* Micro logs enable modifications on storage types that do not support
    in-place updates. This applies primarily to flash memories. */
@@ -90,6 +91,35 @@
 #define COFFEE_EXTENDED_WEAR_LEVELLING	1
 #endif
 
+/*
+ * The name index maps file names to the first page of the file and
+ * caches the end offset of each file, so that opening a file does not
+ * require a scan of the whole storage. Set to 0 to disable the index.
+ */
+#ifndef COFFEE_NAME_INDEX_SIZE
+#define COFFEE_NAME_INDEX_SIZE	8
+#endif
+
+/*
+ * Incremental garbage collection moves sector erasure out of the file
+ * operations and into a process that erases at most
+ * COFFEE_GC_SECTORS_PER_SLICE sectors before yielding. The process is
+ * started whenever fewer than COFFEE_GC_WATERMARK pages are estimated
+ * to be free. File operations only collect garbage themselves if the
+ * background collection could not keep up.
+ */
+#ifndef COFFEE_GC_INCREMENTAL
+#define COFFEE_GC_INCREMENTAL	0
+#endif
+
+#ifndef COFFEE_GC_SECTORS_PER_SLICE
+#define COFFEE_GC_SECTORS_PER_SLICE	1
+#endif
+
+#ifndef COFFEE_GC_WATERMARK
+#define COFFEE_GC_WATERMARK	(2 * COFFEE_PAGES_PER_SECTOR)
+#endif
+
 #if COFFEE_START & (COFFEE_SECTOR_SIZE - 1)
 #error COFFEE_START must point to the first byte in a sector.
 #endif
@@ -193,6 +223,15 @@ struct file_header {
   char name[COFFEE_NAME_LENGTH];
 };
 
+#if COFFEE_NAME_INDEX_SIZE > 0
+/* An entry in the name index. Free entries have a zero hash. */
+struct name_index_entry {
+  cfs_offset_t end;
+  coffee_page_t page;
+  uint16_t hash;
+};
+#endif /* COFFEE_NAME_INDEX_SIZE > 0 */
+
 /* This is needed because of a buggy compiler. */
 struct log_param {
   cfs_offset_t offset;
@@ -211,11 +250,115 @@ static struct protected_mem_t {
   struct file_desc coffee_fd_set[COFFEE_FD_SET_SIZE];
   coffee_page_t next_free;
   char gc_wait;
+#if COFFEE_NAME_INDEX_SIZE > 0
+  struct name_index_entry name_index[COFFEE_NAME_INDEX_SIZE];
+  char name_index_complete;
+#endif
 } protected_mem;
 static struct file * const coffee_files = protected_mem.coffee_files;
 static struct file_desc * const coffee_fd_set = protected_mem.coffee_fd_set;
 static coffee_page_t * const next_free = &protected_mem.next_free;
 static char * const gc_wait = &protected_mem.gc_wait;
+#if COFFEE_NAME_INDEX_SIZE > 0
+static struct name_index_entry * const name_index = protected_mem.name_index;
+static char * const name_index_complete = &protected_mem.name_index_complete;
+#endif
+
+static struct cfs_coffee_gc_stats gc_stats;
+
+#if COFFEE_GC_INCREMENTAL
+#include "sys/process.h"
+
+PROCESS(coffee_gc_process, "Coffee GC");
+
+/* Set when a background slice found nothing to erase; cleared when
+   a file is removed. */
+static char gc_futile;
+
+/* The number of free pages counted by the last garbage collection,
+   minus the pages reserved since then. */
+static coffee_page_t free_page_estimate;
+#endif /* COFFEE_GC_INCREMENTAL */
+
+/*---------------------------------------------------------------------------*/
+#if COFFEE_NAME_INDEX_SIZE > 0
+static uint16_t
+name_hash(const char *name)
+{
+  uint16_t hash;
+  int i;
+
+  /* Only the stored part of the name is hashed; see reserve(). */
+  hash = 0;
+  for(i = 0; i < COFFEE_NAME_LENGTH - 1 && name[i] != '\0'; i++) {
+    hash = hash * 31 + (unsigned char)name[i];
+  }
+  return hash == 0 ? 1 : hash;
+}
+/*---------------------------------------------------------------------------*/
+static struct name_index_entry *
+index_find_page(coffee_page_t page)
+{
+  int i;
+
+  for(i = 0; i < COFFEE_NAME_INDEX_SIZE; i++) {
+    if(name_index[i].hash != 0 && name_index[i].page == page) {
+      return &name_index[i];
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static void
+index_insert(const char *name, coffee_page_t page, cfs_offset_t end)
+{
+  struct name_index_entry *entry;
+  int i;
+
+  entry = index_find_page(page);
+  if(entry == NULL) {
+    for(i = 0; i < COFFEE_NAME_INDEX_SIZE; i++) {
+      if(name_index[i].hash == 0) {
+        entry = &name_index[i];
+        break;
+      }
+    }
+  }
+
+  if(entry == NULL) {
+    /* The index cannot hold all files; lookups of names that are not
+       in the index must fall back to scanning the storage. */
+    *name_index_complete = 0;
+    return;
+  }
+
+  entry->hash = name_hash(name);
+  entry->page = page;
+  entry->end = end;
+}
+/*---------------------------------------------------------------------------*/
+static void
+index_remove(coffee_page_t page)
+{
+  struct name_index_entry *entry;
+
+  entry = index_find_page(page);
+  if(entry != NULL) {
+    entry->hash = 0;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+index_set_end(coffee_page_t page, cfs_offset_t end)
+{
+  struct name_index_entry *entry;
+
+  entry = index_find_page(page);
+  if(entry != NULL) {
+    entry->end = end;
+  }
+}
+#endif /* COFFEE_NAME_INDEX_SIZE > 0 */
 
 /*---------------------------------------------------------------------------*/
 static void
@@ -362,31 +505,36 @@ isolate_pages(coffee_page_t start, coffee_page_t skip_pages)
 
 }
 /*---------------------------------------------------------------------------*/
-static void
-collect_garbage(int mode)
+static unsigned
+collect_sectors(int mode, unsigned max_erased)
 {
   uint16_t sector;
   struct sector_status stats;
-  coffee_page_t first_page, isolation_count;
+  coffee_page_t first_page, isolation_count, head_isolation_count;
+  coffee_page_t free_pages;
+  unsigned erased;
 
   PRINTF("Coffee: Running the file system garbage collector in %s mode\n",
 	 mode == GC_RELUCTANT ? "reluctant" : "greedy");
   /*
-   * The garbage collector erases as many sectors as possible. A sector is
-   * erasable if there are only free or obsolete pages in it.
+   * The garbage collector erases as many sectors as possible, but at
+   * most max_erased of them. A sector is erasable if there are only
+   * free or obsolete pages in it. The remaining sectors are still
+   * examined to count the free pages.
    */
+  head_isolation_count = 0;
+  free_pages = 0;
+  erased = 0;
   for(sector = 0; sector < COFFEE_SECTOR_COUNT; sector++) {
     isolation_count = get_sector_status(sector, &stats);
     PRINTF("Coffee: Sector %u has %u active, %u obsolete, and %u free pages.\n",
         sector, (unsigned)stats.active,
 	(unsigned)stats.obsolete, (unsigned)stats.free);
 
-    if(stats.active > 0) {
-      continue;
-    }
-
-    if((mode == GC_RELUCTANT && stats.free == 0) ||
-       (mode == GC_GREEDY && stats.obsolete > 0)) {
+    /* Obsolete pages that must be isolated again are not reclaimed. */
+    if(stats.active == 0 && erased < max_erased &&
+       ((mode == GC_RELUCTANT && stats.free == 0) ||
+        (mode == GC_GREEDY && stats.obsolete > head_isolation_count))) {
       first_page = sector * COFFEE_PAGES_PER_SECTOR;
       if(first_page < *next_free) {
         *next_free = first_page;
@@ -398,13 +546,107 @@ collect_garbage(int mode)
 
       COFFEE_ERASE(sector);
       PRINTF("Coffee: Erased sector %d!\n", sector);
+      erased++;
+
+      /*
+       * An obsolete file that starts in the previous, non-erased sector
+       * still covers the first pages of this sector. These pages must
+       * not be reallocated, or a scan that skips over the obsolete file
+       * would miss the files allocated in them.
+       */
+      if(head_isolation_count > 0) {
+        isolate_pages(first_page, head_isolation_count);
+      }
+      free_pages += COFFEE_PAGES_PER_SECTOR - head_isolation_count;
+      head_isolation_count = 0;
 
       if(mode == GC_RELUCTANT && isolation_count > 0) {
         break;
       }
+    } else {
+      head_isolation_count = isolation_count;
+      free_pages += stats.free;
+    }
+  }
+
+#if COFFEE_GC_INCREMENTAL
+  if(sector >= COFFEE_SECTOR_COUNT) {
+    free_page_estimate = free_pages;
+  }
+#endif
+  gc_stats.erased_sectors += erased;
+  return erased;
+}
+/*---------------------------------------------------------------------------*/
+static void
+collect_garbage(int mode)
+{
+  rtimer_clock_t start;
+  unsigned long elapsed;
+
+  /* This collection blocks the file operation that triggered it. */
+  start = RTIMER_NOW();
+  collect_sectors(mode, COFFEE_SECTOR_COUNT);
+  elapsed = (rtimer_clock_t)(RTIMER_NOW() - start);
+
+  gc_stats.blocking_runs++;
+  if(elapsed > gc_stats.max_blocking_time) {
+    gc_stats.max_blocking_time = elapsed;
+  }
+}
+/*---------------------------------------------------------------------------*/
+#if COFFEE_GC_INCREMENTAL
+static int
+below_watermark(void)
+{
+  return free_page_estimate < COFFEE_GC_WATERMARK;
+}
+/*---------------------------------------------------------------------------*/
+static void
+request_background_gc(void)
+{
+  if(gc_futile || !below_watermark()) {
+    return;
+  }
+  if(!process_is_running(&coffee_gc_process)) {
+    process_start(&coffee_gc_process, NULL);
+  }
+  process_poll(&coffee_gc_process);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(coffee_gc_process, ev, data)
+{
+  rtimer_clock_t start;
+  unsigned erased;
+  unsigned long elapsed;
+
+  PROCESS_BEGIN();
+
+  while(1) {
+    PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_POLL);
+
+    while(below_watermark()) {
+      start = RTIMER_NOW();
+      erased = collect_sectors(GC_GREEDY, COFFEE_GC_SECTORS_PER_SLICE);
+      elapsed = (rtimer_clock_t)(RTIMER_NOW() - start);
+
+      gc_stats.background_slices++;
+      if(elapsed > gc_stats.max_slice_time) {
+        gc_stats.max_slice_time = elapsed;
+      }
+
+      if(erased == 0) {
+        gc_futile = 1;
+        break;
+      }
+      /* Let other processes run before erasing more sectors. */
+      PROCESS_PAUSE();
     }
   }
+
+  PROCESS_END();
 }
+#endif /* COFFEE_GC_INCREMENTAL */
 /*---------------------------------------------------------------------------*/
 static coffee_page_t
 next_file(coffee_page_t page, struct file_header *hdr)
@@ -458,6 +700,16 @@ load_file(coffee_page_t start, struct file_header *hdr)
   file = &coffee_files[i];
   file->page = start;
   file->end = UNKNOWN_OFFSET;
+#if COFFEE_NAME_INDEX_SIZE > 0
+  {
+    struct name_index_entry *entry;
+
+    entry = index_find_page(start);
+    if(entry != NULL) {
+      file->end = entry->end;
+    }
+  }
+#endif
   file->max_pages = hdr->max_pages;
   file->flags = 0;
   if(HDR_MODIFIED(*hdr)) {
@@ -470,11 +722,59 @@ load_file(coffee_page_t start, struct file_header *hdr)
 }
 /*---------------------------------------------------------------------------*/
 static struct file *
+cached_file(coffee_page_t page)
+{
+  int i;
+
+  for(i = 0; i < COFFEE_MAX_OPEN_FILES; i++) {
+    if(!FILE_FREE(&coffee_files[i]) && coffee_files[i].page == page) {
+      return &coffee_files[i];
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+#if COFFEE_NAME_INDEX_SIZE > 0
+static struct file *
+find_indexed_file(const char *name)
+{
+  int i;
+  uint16_t hash;
+  struct file_header hdr;
+  struct file *file;
+
+  hash = name_hash(name);
+  for(i = 0; i < COFFEE_NAME_INDEX_SIZE; i++) {
+    if(name_index[i].hash != hash) {
+      continue;
+    }
+
+    /* Rule out hash collisions by reading the candidate's header. */
+    read_header(&hdr, name_index[i].page);
+    if(HDR_ACTIVE(hdr) && !HDR_LOG(hdr) && strcmp(name, hdr.name) == 0) {
+      file = cached_file(name_index[i].page);
+      return file != NULL ? file : load_file(name_index[i].page, &hdr);
+    }
+  }
+  return NULL;
+}
+#endif /* COFFEE_NAME_INDEX_SIZE > 0 */
+/*---------------------------------------------------------------------------*/
+static struct file *
 find_file(const char *name)
 {
   int i;
   struct file_header hdr;
   coffee_page_t page;
+#if COFFEE_NAME_INDEX_SIZE > 0
+  struct file *file;
+  coffee_page_t found;
+
+  file = find_indexed_file(name);
+  if(file != NULL || *name_index_complete) {
+    return file;
+  }
+#endif
   
   /* First check if the file metadata is cached. */
   for(i = 0; i < COFFEE_MAX_OPEN_FILES; i++) {
@@ -488,6 +788,35 @@ find_file(const char *name)
     }
   }
   
+#if COFFEE_NAME_INDEX_SIZE > 0
+  /*
+   * Scan the whole flash memory and rebuild the name index on the way,
+   * so that subsequent lookups, including those of non-existent files,
+   * can be answered from the index.
+   */
+  *name_index_complete = 1;
+  found = INVALID_PAGE;
+  for(page = 0; page < COFFEE_PAGE_COUNT; page = next_file(page, &hdr)) {
+    read_header(&hdr, page);
+    if(HDR_ACTIVE(hdr) && !HDR_LOG(hdr)) {
+      if(index_find_page(page) == NULL) {
+        index_insert(hdr.name, page, UNKNOWN_OFFSET);
+      }
+      if(found == INVALID_PAGE && strcmp(name, hdr.name) == 0) {
+        found = page;
+      }
+      if(found != INVALID_PAGE && !*name_index_complete) {
+        /* The index overflowed, so finishing the scan is futile. */
+        break;
+      }
+    }
+  }
+
+  if(found != INVALID_PAGE) {
+    read_header(&hdr, found);
+    return load_file(found, &hdr);
+  }
+#else
   /* Scan the flash memory sequentially otherwise. */
   for(page = 0; page < COFFEE_PAGE_COUNT; page = next_file(page, &hdr)) {
     read_header(&hdr, page);
@@ -495,6 +824,7 @@ find_file(const char *name)
       return load_file(page, &hdr);
     }
   }
+#endif /* COFFEE_NAME_INDEX_SIZE > 0 */
 
   return NULL;
 }
@@ -591,6 +921,9 @@ remove_by_page(coffee_page_t page, int remove_log, int close_fds,
   write_header(&hdr, page);
 
   *gc_wait = 0;
+#if COFFEE_GC_INCREMENTAL
+  gc_futile = 0;
+#endif
 
   /* Close all file descriptors that reference the removed file. */
   if(close_fds) {
@@ -609,9 +942,17 @@ remove_by_page(coffee_page_t page, int remove_log, int close_fds,
     }
   }
 
+#if COFFEE_NAME_INDEX_SIZE > 0
+  index_remove(page);
+#endif
+
 #if !COFFEE_EXTENDED_WEAR_LEVELLING
   if(gc_allowed) {
+#if COFFEE_GC_INCREMENTAL
+    request_background_gc();
+#else
     collect_garbage(GC_RELUCTANT);
+#endif
   }
 #endif
 
@@ -659,11 +1000,23 @@ reserve(const char *name, coffee_page_t pages,
   PRINTF("Coffee: Reserved %u pages starting from %u for file %s\n",
       pages, page, name);
 
+#if COFFEE_NAME_INDEX_SIZE > 0
+  if(!(flags & HDR_FLAG_LOG)) {
+    index_insert(name, page, 0);
+  }
+#endif
+
   file = load_file(page, &hdr);
   if(file != NULL) {
     file->end = 0;
   }
 
+#if COFFEE_GC_INCREMENTAL
+  free_page_estimate = free_page_estimate > pages ?
+                       free_page_estimate - pages : 0;
+  request_background_gc();
+#endif
+
   return file;
 }
 /*---------------------------------------------------------------------------*/
@@ -1019,6 +1372,9 @@ cfs_open(const char *name, int flags)
     fdp->file->end = 0;
   } else if(fdp->file->end == UNKNOWN_OFFSET) {
     fdp->file->end = file_end(fdp->file->page);
+#if COFFEE_NAME_INDEX_SIZE > 0
+    index_set_end(fdp->file->page, fdp->file->end);
+#endif
   }
 
   fdp->flags |= flags;
@@ -1032,6 +1388,10 @@ void
 cfs_close(int fd)
 {
   if(FD_VALID(fd)) {
+#if COFFEE_NAME_INDEX_SIZE > 0
+    /* Remember the end of the file after it leaves the file cache. */
+    index_set_end(coffee_fd_set[fd].file->page, coffee_fd_set[fd].file->end);
+#endif
     coffee_fd_set[fd].flags = COFFEE_FD_FREE;
     coffee_fd_set[fd].file->references--;
     coffee_fd_set[fd].file = NULL;
@@ -1257,6 +1617,7 @@ cfs_readdir(struct cfs_dir *dir, struct cfs_dirent *record)
 {
   struct file_header hdr;
   coffee_page_t page;
+  struct file *file;
 
   memcpy(&page, dir->dummy_space, sizeof(coffee_page_t));
 
@@ -1266,7 +1627,21 @@ cfs_readdir(struct cfs_dir *dir, struct cfs_dirent *record)
       coffee_page_t next_page;
       memcpy(record->name, hdr.name, sizeof(record->name));
       record->name[sizeof(record->name) - 1] = '\0';
-      record->size = file_end(page);
+      file = cached_file(page);
+      record->size = file != NULL ? file->end : UNKNOWN_OFFSET;
+#if COFFEE_NAME_INDEX_SIZE > 0
+      if(record->size == UNKNOWN_OFFSET) {
+        struct name_index_entry *entry;
+
+        entry = index_find_page(page);
+        if(entry != NULL) {
+          record->size = entry->end;
+        }
+      }
+#endif
+      if(record->size == UNKNOWN_OFFSET) {
+        record->size = file_end(page);
+      }
 
       next_page = next_file(page, &hdr);
       memcpy(dir->dummy_space, &next_page, sizeof(coffee_page_t));
@@ -1350,12 +1725,21 @@ cfs_coffee_format(void)
 
   /* Formatting invalidates the file information. */
   memset(&protected_mem, 0, sizeof(protected_mem));
+#if COFFEE_GC_INCREMENTAL
+  free_page_estimate = COFFEE_PAGE_COUNT;
+#endif
 
   PRINTF(" done!\n");
 
   return 0;
 }
 /*---------------------------------------------------------------------------*/
+const struct cfs_coffee_gc_stats *
+cfs_coffee_get_gc_stats(void)
+{
+  return &gc_stats;
+}
+/*---------------------------------------------------------------------------*/
 void *
 cfs_coffee_get_protected_mem(unsigned *size)
 {
@@ -63,6 +63,24 @@
  */
 #define CFS_COFFEE_IO_FIRM_SIZE		0x2
 
+/**
+ * Garbage collection statistics. Times are measured in rtimer ticks.
+ *
+ * \sa cfs_coffee_get_gc_stats()
+ */
+struct cfs_coffee_gc_stats {
+  /** The number of sectors erased by the garbage collector. */
+  unsigned long erased_sectors;
+  /** The number of collections that blocked a file operation. */
+  unsigned long blocking_runs;
+  /** The number of slices run by the incremental garbage collector. */
+  unsigned long background_slices;
+  /** The longest time that a file operation was blocked by a collection. */
+  unsigned long max_blocking_time;
+  /** The longest time spent in a single incremental slice. */
+  unsigned long max_slice_time;
+};
+
 /**
  * \file
  *	Header for the Coffee file system.
@@ -126,6 +144,18 @@ int cfs_coffee_set_io_semantics(int fd, unsigned flags);
  */
 int cfs_coffee_format(void);
 
+/**
+ * \brief Get the garbage collection statistics.
+ * \return A pointer to the statistics.
+ *
+ * When COFFEE_GC_INCREMENTAL is set, sectors are erased by a
+ * background process a bounded number at a time, and blocking_runs
+ * counts the reservations that still had to collect garbage
+ * synchronously because the process could not keep up. Such runs can
+ * be avoided by raising COFFEE_GC_WATERMARK.
+ */
+const struct cfs_coffee_gc_stats *cfs_coffee_get_gc_stats(void);
+
 /**
  * \brief Points out a memory region that may not be altered during
  * checkpointing operations that use the file system.
@@ -131,6 +131,40 @@ struct relevant_section {
   char *address;
 };
 
+/* Relocation entries, symbols and names are read through small RAM
+   windows instead of one cfs_seek()/cfs_read() per item. */
+#ifdef ELFLOADER_CONF_WINDOW_SIZE
+#define WINDOW_SIZE ELFLOADER_CONF_WINDOW_SIZE
+#else
+#define WINDOW_SIZE 64
+#endif
+
+struct window {
+  unsigned int offset;
+  unsigned short len;
+  char buf[WINDOW_SIZE];
+};
+
+static struct window relwin, symwin, strwin, secwin;
+
+/* Hash index over the symbols defined in the loaded module, so that
+   local symbols need not be found with a scan of the symbol
+   table. Must be a power of two. If the module defines more symbols
+   than fit, lookups that miss the index fall back to the scan. */
+#ifdef ELFLOADER_CONF_SYMBOL_INDEX_SIZE
+#define SYMBOL_INDEX_SIZE ELFLOADER_CONF_SYMBOL_INDEX_SIZE
+#else
+#define SYMBOL_INDEX_SIZE 64
+#endif
+
+struct symbol_index_entry {
+  unsigned short hash;
+  unsigned short symbol;        /* Symbol number + 1, 0 if unused. */
+};
+
+static struct symbol_index_entry symbol_index[SYMBOL_INDEX_SIZE];
+static unsigned char symbol_index_full;
+
 char elfloader_unknown[30];	/* Name that caused link error. */
 
 struct process * const * elfloader_autostart_processes;
@@ -163,6 +197,36 @@ seek_read(int fd, unsigned int offset, char *buf, int len)
 #endif /* DEBUG */
 }
 /*---------------------------------------------------------------------------*/
+static void
+window_reset(struct window *w)
+{
+  w->offset = 0;
+  w->len = 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+window_read(struct window *w, int fd, unsigned int offset, char *buf, int len)
+{
+  int n;
+
+  if(len > WINDOW_SIZE) {
+    seek_read(fd, offset, buf, len);
+    return;
+  }
+
+  if(offset < w->offset || offset + len > w->offset + w->len) {
+    cfs_seek(fd, offset, CFS_SEEK_SET);
+    n = cfs_read(fd, w->buf, WINDOW_SIZE);
+    w->offset = offset;
+    w->len = n > 0 ? n : 0;
+    if(len > w->len) {
+      /* Short read at the end of the file. */
+      len = w->len;
+    }
+  }
+  memcpy(buf, &w->buf[offset - w->offset], len);
+}
+/*---------------------------------------------------------------------------*/
 /*
 static void
 seek_write(int fd, unsigned int offset, char *buf, int len)
@@ -172,6 +236,70 @@ seek_write(int fd, unsigned int offset, char *buf, int len)
 }
 */
 /*---------------------------------------------------------------------------*/
+static struct relevant_section *
+find_section(unsigned short shndx)
+{
+  if(shndx == bss.number) {
+    return &bss;
+  } else if(shndx == data.number) {
+    return &data;
+  } else if(shndx == rodata.number) {
+    return &rodata;
+  } else if(shndx == text.number) {
+    return &text;
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static unsigned short
+symbol_hash(const char *name)
+{
+  unsigned short hash;
+
+  for(hash = 0; *name != 0; name++) {
+    hash = hash * 31 + (unsigned char)*name;
+  }
+  return hash;
+}
+/*---------------------------------------------------------------------------*/
+static void
+build_symbol_index(int fd, unsigned int symtab, unsigned short symtabsize,
+		   unsigned int strtab)
+{
+  struct elf32_sym s;
+  unsigned int a;
+  unsigned short num, hash, i;
+  char name[30];
+
+  memset(symbol_index, 0, sizeof(symbol_index));
+  symbol_index_full = 0;
+
+  for(a = symtab, num = 0; a < symtab + symtabsize; a += sizeof(s), num++) {
+    window_read(&symwin, fd, a, (char *)&s, sizeof(s));
+    if(s.st_name == 0 || find_section(s.st_shndx) == NULL) {
+      continue;
+    }
+    window_read(&strwin, fd, strtab + s.st_name, name, sizeof(name));
+    name[sizeof(name) - 1] = 0;
+    hash = symbol_hash(name);
+
+    for(i = 0; i < SYMBOL_INDEX_SIZE; i++) {
+      struct symbol_index_entry *e;
+      e = &symbol_index[(hash + i) & (SYMBOL_INDEX_SIZE - 1)];
+      if(e->symbol == 0) {
+	e->hash = hash;
+	e->symbol = num + 1;
+	break;
+      }
+    }
+    if(i == SYMBOL_INDEX_SIZE) {
+      PRINTF("elfloader: symbol index full\n");
+      symbol_index_full = 1;
+      return;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
 static void *
 find_local_symbol(int fd, const char *symbol,
 		  unsigned int symtab, unsigned short symtabsize,
@@ -179,24 +307,44 @@ find_local_symbol(int fd, const char *symbol,
 {
   struct elf32_sym s;
   unsigned int a;
+  unsigned short hash, i;
   char name[30];
   struct relevant_section *sect;
-  
+  struct symbol_index_entry *e;
+
+  hash = symbol_hash(symbol);
+  for(i = 0; i < SYMBOL_INDEX_SIZE; i++) {
+    e = &symbol_index[(hash + i) & (SYMBOL_INDEX_SIZE - 1)];
+    if(e->symbol == 0) {
+      break;
+    }
+    if(e->hash != hash) {
+      continue;
+    }
+    window_read(&symwin, fd,
+		symtab + sizeof(struct elf32_sym) * (e->symbol - 1),
+		(char *)&s, sizeof(s));
+    window_read(&strwin, fd, strtab + s.st_name, name, sizeof(name));
+    name[sizeof(name) - 1] = 0;
+    if(strcmp(name, symbol) == 0) {
+      sect = find_section(s.st_shndx);
+      return &(sect->address[s.st_value]);
+    }
+  }
+
+  if(!symbol_index_full) {
+    return NULL;
+  }
+
   for(a = symtab; a < symtab + symtabsize; a += sizeof(s)) {
-    seek_read(fd, a, (char *)&s, sizeof(s));
+    window_read(&symwin, fd, a, (char *)&s, sizeof(s));
 
     if(s.st_name != 0) {
-      seek_read(fd, strtab + s.st_name, name, sizeof(name));
+      window_read(&strwin, fd, strtab + s.st_name, name, sizeof(name));
+      name[sizeof(name) - 1] = 0;
       if(strcmp(name, symbol) == 0) {
-	if(s.st_shndx == bss.number) {
-	  sect = &bss;
-	} else if(s.st_shndx == data.number) {
-	  sect = &data;
-  } else if(s.st_shndx == rodata.number) {
-    sect = &rodata;
-	} else if(s.st_shndx == text.number) {
-	  sect = &text;
-	} else {
+	sect = find_section(s.st_shndx);
+	if(sect == NULL) {
 	  return NULL;
 	}
 	return &(sect->address[s.st_value]);
@@ -221,6 +369,7 @@ relocate_section(int fd,
   int rel_size = 0;
   struct elf32_sym s;
   unsigned int a;
+  elf32_addr next_offset;
   char name[30];
   char *addr;
   struct relevant_section *sect;
@@ -231,14 +380,23 @@ relocate_section(int fd,
   } else {
     rel_size = sizeof(struct elf32_rel);
   }
-  
+
+  /* The section contents are rewritten by elfloader_arch_relocate(),
+     so the window over them is only trusted while the relocations
+     come in increasing, non-overlapping order. */
+  window_reset(&secwin);
+  next_offset = 0;
+
   for(a = section; a < section + size; a += rel_size) {
-    seek_read(fd, a, (char *)&rela, rel_size);
-    seek_read(fd,
-	      symtab + sizeof(struct elf32_sym) * ELF32_R_SYM(rela.r_info),
-	      (char *)&s, sizeof(s));
+    window_read(&relwin, fd, a, (char *)&rela, rel_size);
+    window_read(&symwin, fd,
+		symtab + sizeof(struct elf32_sym) * ELF32_R_SYM(rela.r_info),
+		(char *)&s, sizeof(s));
     if(s.st_name != 0) {
-      seek_read(fd, strtab + s.st_name, name, sizeof(name));
+      /* Names are truncated the same way as in build_symbol_index(),
+	 so that long local names hash to their index entry. */
+      window_read(&strwin, fd, strtab + s.st_name, name, sizeof(name));
+      name[sizeof(name) - 1] = 0;
       PRINTF("name: %s\n", name);
       addr = (char *)symtab_lookup(name);
       /* ADDED */
@@ -248,32 +406,14 @@ relocate_section(int fd,
 	PRINTF("found address %p\n", addr);
       }
       if(addr == NULL) {
-	if(s.st_shndx == bss.number) {
-	  sect = &bss;
-	} else if(s.st_shndx == data.number) {
-	  sect = &data;
-	} else if(s.st_shndx == rodata.number) {
-	  sect = &rodata;
-	} else if(s.st_shndx == text.number) {
-	  sect = &text;
-	} else {
-	  PRINTF("elfloader unknown name: '%30s'\n", name);
-	  memcpy(elfloader_unknown, name, sizeof(elfloader_unknown));
-	  elfloader_unknown[sizeof(elfloader_unknown) - 1] = 0;
-	  return ELFLOADER_SYMBOL_NOT_FOUND;
-	}
-	addr = sect->address;
+	PRINTF("elfloader unknown name: '%30s'\n", name);
+	memcpy(elfloader_unknown, name, sizeof(elfloader_unknown));
+	elfloader_unknown[sizeof(elfloader_unknown) - 1] = 0;
+	return ELFLOADER_SYMBOL_NOT_FOUND;
       }
     } else {
-      if(s.st_shndx == bss.number) {
-	sect = &bss;
-      } else if(s.st_shndx == data.number) {
-	sect = &data;
-      } else if(s.st_shndx == rodata.number) {
-	sect = &rodata;
-      } else if(s.st_shndx == text.number) {
-	sect = &text;
-      } else {
+      sect = find_section(s.st_shndx);
+      if(sect == NULL) {
 	return ELFLOADER_SEGMENT_NOT_FOUND;
       }
       
@@ -282,7 +422,12 @@ relocate_section(int fd,
 
     if(!using_relas) {
       /* copy addend to rela structure */
-      seek_read(fd, sectionaddr + rela.r_offset, (char *)&rela.r_addend, 4);
+      if(rela.r_offset < next_offset) {
+	window_reset(&secwin);
+      }
+      window_read(&secwin, fd, sectionaddr + rela.r_offset,
+		  (char *)&rela.r_addend, 4);
+      next_offset = rela.r_offset + 4;
     }
 
     elfloader_arch_relocate(fd, sectionaddr, sectionbase, &rela, addr);
@@ -438,7 +583,8 @@ elfloader_load(int fd)
       PRINTF("symtab\n");
       symtaboff = shdr.sh_offset;
       symtabsize = shdr.sh_size;
-    } else if(shdr.sh_type == SHT_STRTAB/*strncmp(name, ".strtab", 7) == 0*/) {
+    } else if(shdr.sh_type == SHT_STRTAB && i != ehdr.e_shstrndx
+	      /*strncmp(name, ".strtab", 7) == 0*/) {
       PRINTF("strtab\n");
       strtaboff = shdr.sh_offset;
       strtabsize = shdr.sh_size;
@@ -518,6 +664,13 @@ elfloader_load(int fd)
   PRINTF("rodata base address: rodata.address = 0x%08x\n", rodata.address);
 
 
+  /* Index the symbols of the module once, so that relocations against
+     local symbols do not have to scan the symbol table. */
+  window_reset(&relwin);
+  window_reset(&symwin);
+  window_reset(&strwin);
+  build_symbol_index(fd, symtaboff, symtabsize, strtaboff);
+
   /* If we have text segment relocations, we process them. */
   PRINTF("elfloader: relocate text\n");
   if(textrelasize > 0) {
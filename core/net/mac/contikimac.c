@@ -615,6 +615,10 @@ send_packet(mac_callback_t mac_callback, void *mac_callback_ptr,
   }
 #endif
 
+  /* Gather chained payload segments first, so that the data ends at
+     packetbuf_dataptr() + packetbuf_datalen() before it is padded. */
+  packetbuf_compact();
+
   /* Make sure that the packet is longer or equal to the shortest
      packet length. */
   transmit_len = packetbuf_totlen();
@@ -628,9 +632,6 @@ send_packet(mac_callback_t mac_callback, void *mac_callback_ptr,
     transmit_len = SHORTEST_PACKET_SIZE;
   }
 
-
-  packetbuf_compact();
-
 #ifdef NETSTACK_ENCRYPT
   NETSTACK_ENCRYPT();
 #endif /* NETSTACK_ENCRYPT */
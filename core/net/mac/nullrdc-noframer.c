@@ -48,6 +48,7 @@ static void
 send_packet(mac_callback_t sent, void *ptr)
 {
   int ret;
+  packetbuf_compact();
   if(NETSTACK_RADIO.send(packetbuf_hdrptr(), packetbuf_totlen()) == RADIO_TX_OK) {
     ret = MAC_TX_OK;
   } else {
@@ -99,6 +99,8 @@ send_packet(mac_callback_t sent, void *ptr)
   frame802154_t params;
   uint8_t len;
 
+  packetbuf_compact();
+
   /* init to zeros */
   memset(&params, 0, sizeof(params));
 
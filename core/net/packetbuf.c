@@ -64,6 +64,16 @@ static uint8_t *packetbuf = (uint8_t *)packetbuf_aligned;
 
 static uint8_t *packetbufptr;
 
+/* External segments chained after the data, see
+   packetbuf_reference_append(). */
+struct packetbuf_segment {
+  const uint8_t *ptr;
+  uint16_t len;
+};
+static struct packetbuf_segment chain[PACKETBUF_CHAIN_LEN];
+static uint8_t chainnum;
+static uint16_t chainlen;
+
 #define DEBUG 0
 #if DEBUG
 #include <stdio.h>
@@ -78,6 +88,8 @@ packetbuf_clear(void)
 {
   buflen = bufptr = 0;
   hdrptr = PACKETBUF_HDR_SIZE;
+  chainnum = 0;
+  chainlen = 0;
 
   packetbufptr = &packetbuf[PACKETBUF_HDR_SIZE];
   packetbuf_attr_clear();
@@ -101,6 +113,17 @@ packetbuf_copyfrom(const void *from, uint16_t len)
   return l;
 }
 /*---------------------------------------------------------------------------*/
+static void
+chain_copyto(uint8_t *to)
+{
+  int i;
+
+  for(i = 0; i < chainnum; i++) {
+    memcpy(to, chain[i].ptr, chain[i].len);
+    to += chain[i].len;
+  }
+}
+/*---------------------------------------------------------------------------*/
 void
 packetbuf_compact(void)
 {
@@ -110,13 +133,20 @@ packetbuf_compact(void)
     memcpy(&packetbuf[PACKETBUF_HDR_SIZE], packetbuf_reference_ptr(),
 	   packetbuf_datalen());
   } else if(bufptr > 0) {
-    len = packetbuf_datalen() + PACKETBUF_HDR_SIZE;
+    len = buflen + PACKETBUF_HDR_SIZE;
     for(i = PACKETBUF_HDR_SIZE; i < len; i++) {
       packetbuf[i] = packetbuf[bufptr + i];
     }
 
     bufptr = 0;
   }
+
+  if(chainnum > 0) {
+    chain_copyto(&packetbuf[PACKETBUF_HDR_SIZE + bufptr + buflen]);
+    buflen += chainlen;
+    chainnum = 0;
+    chainlen = 0;
+  }
 }
 /*---------------------------------------------------------------------------*/
 int
@@ -158,14 +188,15 @@ packetbuf_copyto(void *to)
     PRINTF("packetbuf_write: data: %s\n", buffer);
   }
 #endif /* DEBUG_LEVEL */
-  if(PACKETBUF_HDR_SIZE - hdrptr + buflen > PACKETBUF_SIZE) {
+  if(PACKETBUF_HDR_SIZE - hdrptr + buflen + chainlen > PACKETBUF_SIZE) {
     /* Too large packet */
     return 0;
   }
   memcpy(to, packetbuf + hdrptr, PACKETBUF_HDR_SIZE - hdrptr);
   memcpy((uint8_t *)to + PACKETBUF_HDR_SIZE - hdrptr, packetbufptr + bufptr,
 	 buflen);
-  return PACKETBUF_HDR_SIZE - hdrptr + buflen;
+  chain_copyto((uint8_t *)to + PACKETBUF_HDR_SIZE - hdrptr + buflen);
+  return PACKETBUF_HDR_SIZE - hdrptr + buflen + chainlen;
 }
 /*---------------------------------------------------------------------------*/
 int
@@ -235,10 +266,30 @@ packetbuf_reference_ptr(void)
   return packetbufptr;
 }
 /*---------------------------------------------------------------------------*/
+int
+packetbuf_reference_append(const void *ptr, uint16_t len)
+{
+  if(packetbuf_is_reference() || chainnum >= PACKETBUF_CHAIN_LEN ||
+     packetbuf_totlen() + len > PACKETBUF_SIZE) {
+    return 0;
+  }
+  chain[chainnum].ptr = ptr;
+  chain[chainnum].len = len;
+  chainnum++;
+  chainlen += len;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+uint16_t
+packetbuf_chainlen(void)
+{
+  return chainlen;
+}
+/*---------------------------------------------------------------------------*/
 uint16_t
 packetbuf_datalen(void)
 {
-  return buflen;
+  return buflen + chainlen;
 }
 /*---------------------------------------------------------------------------*/
 uint8_t
@@ -73,6 +73,16 @@
 #define PACKETBUF_HDR_SIZE 48
 #endif
 
+/**
+ * \brief      The maximum number of external segments that can be
+ *             chained after the data in the packetbuf
+ */
+#ifdef PACKETBUF_CONF_CHAIN_LEN
+#define PACKETBUF_CHAIN_LEN PACKETBUF_CONF_CHAIN_LEN
+#else
+#define PACKETBUF_CHAIN_LEN 2
+#endif
+
 /**
  * \brief      Clear and reset the packetbuf
  *
@@ -176,7 +186,9 @@ uint16_t packetbuf_totlen(void);
  *
  *             For outbound packets, the packetbuf consists of two
  *             parts: header and data. This function is used to set
- *             the length of the data in the packetbuf.
+ *             the length of the data in the packetbuf. Segments
+ *             chained with packetbuf_reference_append() are not
+ *             included in this length.
  */
 void packetbuf_set_datalen(uint16_t len);
 
@@ -218,6 +230,34 @@ int packetbuf_is_reference(void);
  */
 void *packetbuf_reference_ptr(void);
 
+/**
+ * \brief      Chain an external segment after the data in the packetbuf
+ * \param ptr  A pointer to the external data
+ * \param len  The length of the external data
+ * \retval     Non-zero if the segment was chained, zero if the chain is
+ *             full or the packet would not fit in the packetbuf
+ *
+ *             For outbound packets, the data portion of the packetbuf
+ *             may be followed by up to PACKETBUF_CHAIN_LEN segments
+ *             of external data. This lets an upper layer write only
+ *             its own header into the packetbuf and leave the payload
+ *             where it already is (e.g., in uip_buf). The chained
+ *             segments are counted by packetbuf_datalen() and are
+ *             gathered by packetbuf_copyto() and packetbuf_compact(),
+ *             so the external data must stay valid until the packet
+ *             has been queued or compacted.
+ *
+ *             Chained segments cannot be combined with
+ *             packetbuf_reference().
+ */
+int packetbuf_reference_append(const void *ptr, uint16_t len);
+
+/**
+ * \brief      Get the length of the external segments chained after the data
+ * \return     The total length of the chained segments
+ */
+uint16_t packetbuf_chainlen(void);
+
 /**
  * \brief      Compact the packetbuf
  *
@@ -225,7 +265,8 @@ void *packetbuf_reference_ptr(void);
  *             portion of the packetbuf so that becomes consecutive to
  *             the header. It also copies external data that has
  *             previously been referenced with packetbuf_reference()
- *             into the packetbuf.
+ *             or chained with packetbuf_reference_append() into the
+ *             packetbuf.
  *
  *             This function is called by the Rime code before a
  *             packet is to be sent by a device driver. This assures
@@ -52,11 +52,13 @@
 #include "net/rime/collect-neighbor.h"
 #include "net/rime/collect.h"
 
-#ifdef COLLECT_NEIGHBOR_CONF_MAX_COLLECT_NEIGHBORS
+#ifdef COLLECT_NBR_TABLE_CONF_MAX_NEIGHBORS
+#define MAX_COLLECT_NEIGHBORS COLLECT_NBR_TABLE_CONF_MAX_NEIGHBORS
+#elif defined(COLLECT_NEIGHBOR_CONF_MAX_COLLECT_NEIGHBORS)
 #define MAX_COLLECT_NEIGHBORS COLLECT_NEIGHBOR_CONF_MAX_COLLECT_NEIGHBORS
-#else /* COLLECT_NEIGHBOR_CONF_MAX_COLLECT_NEIGHBORS */
-#define MAX_COLLECT_NEIGHBORS 8
-#endif /* COLLECT_NEIGHBOR_CONF_MAX_COLLECT_NEIGHBORS */
+#else /* COLLECT_NBR_TABLE_CONF_MAX_NEIGHBORS */
+#define MAX_COLLECT_NEIGHBORS 16
+#endif /* COLLECT_NBR_TABLE_CONF_MAX_NEIGHBORS */
 
 #define RTMETRIC_MAX COLLECT_MAX_DEPTH
 
@@ -77,12 +79,70 @@ MEMB(collect_neighbors_mem, struct collect_neighbor, MAX_COLLECT_NEIGHBORS);
 #define PRINTF(...)
 #endif
 
+/*---------------------------------------------------------------------------*/
+static uint16_t
+best_rtmetric(struct collect_neighbor_list *neighbors_list)
+{
+  if(neighbors_list->best == NULL) {
+    return RTMETRIC_MAX;
+  }
+  return collect_neighbor_rtmetric_link_estimate(neighbors_list->best);
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Keep the cached best neighbor of the list that n is on up to date
+ * after the rtmetric + link estimate of n has changed from
+ * old_rtmetric. A neighbor that improves past the cached best simply
+ * replaces it. Only when the cached best itself gets worse does the
+ * next call to collect_neighbor_list_best() have to scan the list.
+ */
+static void
+rtmetric_changed(struct collect_neighbor *n, uint16_t old_rtmetric)
+{
+  struct collect_neighbor_list *neighbors_list;
+  uint16_t rtmetric;
+
+  neighbors_list = n->neighbor_list;
+  if(neighbors_list == NULL || !neighbors_list->best_valid) {
+    return;
+  }
+
+  rtmetric = collect_neighbor_rtmetric_link_estimate(n);
+  if(neighbors_list->best == n) {
+    if(rtmetric > old_rtmetric) {
+      neighbors_list->best_valid = 0;
+    }
+  } else if(rtmetric < best_rtmetric(neighbors_list)) {
+    neighbors_list->best = n;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+remove_neighbor(struct collect_neighbor_list *neighbors_list,
+                struct collect_neighbor *n)
+{
+  if(neighbors_list->best == n) {
+    neighbors_list->best = NULL;
+    neighbors_list->best_valid = 0;
+  }
+  list_remove(neighbors_list->list, n);
+  memb_free(&collect_neighbors_mem, n);
+}
+/*---------------------------------------------------------------------------*/
+static int
+is_parent(struct collect_neighbor_list *neighbors_list,
+          struct collect_neighbor *n)
+{
+  return neighbors_list->parent != NULL &&
+    rimeaddr_cmp(&n->addr, neighbors_list->parent);
+}
 /*---------------------------------------------------------------------------*/
 static void
 periodic(void *ptr)
 {
   struct collect_neighbor_list *neighbor_list;
-  struct collect_neighbor *n;
+  struct collect_neighbor *n, *next;
+  uint16_t old_rtmetric;
 
   neighbor_list = ptr;
 
@@ -91,15 +151,16 @@ periodic(void *ptr)
     n->age++;
     n->le_age++;
   }
-  for(n = list_head(neighbor_list->list); n != NULL; n = list_item_next(n)) {
+  for(n = list_head(neighbor_list->list); n != NULL; n = next) {
+    next = list_item_next(n);
     if(n->le_age == MAX_LE_AGE) {
+      old_rtmetric = collect_neighbor_rtmetric_link_estimate(n);
       collect_link_estimate_new(&n->le);
       n->le_age = 0;
+      rtmetric_changed(n, old_rtmetric);
     }
     if(n->age == MAX_AGE) {
-      memb_free(&collect_neighbors_mem, n);
-      list_remove(neighbor_list->list, n);
-      n = list_head(neighbor_list->list);
+      remove_neighbor(neighbor_list, n);
     }
   }
   ctimer_set(&neighbor_list->periodic, PERIODIC_INTERVAL,
@@ -121,9 +182,21 @@ collect_neighbor_list_new(struct collect_neighbor_list *neighbors_list)
 {
   LIST_STRUCT_INIT(neighbors_list, list);
   list_init(neighbors_list->list);
+  neighbors_list->best = NULL;
+  neighbors_list->best_valid = 0;
+  neighbors_list->parent = NULL;
   ctimer_set(&neighbors_list->periodic, CLOCK_SECOND, periodic, neighbors_list);
 }
 /*---------------------------------------------------------------------------*/
+void
+collect_neighbor_list_set_parent(struct collect_neighbor_list *neighbors_list,
+                                 const rimeaddr_t *parent)
+{
+  if(neighbors_list != NULL) {
+    neighbors_list->parent = parent;
+  }
+}
+/*---------------------------------------------------------------------------*/
 struct collect_neighbor *
 collect_neighbor_list_find(struct collect_neighbor_list *neighbors_list,
                            const rimeaddr_t *addr)
@@ -145,6 +218,8 @@ collect_neighbor_list_add(struct collect_neighbor_list *neighbors_list,
                           const rimeaddr_t *addr, uint16_t nrtmetric)
 {
   struct collect_neighbor *n;
+  uint16_t old_rtmetric;
+  int on_list;
 
   if(addr == NULL) {
     PRINTF("collect_neighbor_list_add: attempt to add NULL addr\n");
@@ -165,6 +240,7 @@ collect_neighbor_list_add(struct collect_neighbor_list *neighbors_list,
       break;
     }
   }
+  on_list = n != NULL;
 
   /* If the collect_neighbor was not on the list, we try to allocate memory
      for it. */
@@ -178,46 +254,53 @@ collect_neighbor_list_add(struct collect_neighbor_list *neighbors_list,
   }
 
   /* If we could not allocate memory, we try to recycle an old
-     neighbor. XXX Should also look for the one with the worst
-     rtmetric (not link esimate). XXX Also make sure that we don't
-     replace a neighbor with a neighbor that has a worse metric. */
+     neighbor. */
   if(n == NULL) {
-    uint16_t worst_rtmetric;
-    struct collect_neighbor *worst_neighbor;
+    struct collect_neighbor *lru_neighbor;
 
-    /* Find the neighbor that has the highest rtmetric. This is the
-       neighbor that we are least likely to be using in the
-       future. But we also need to make sure that the neighbor we are
-       currently adding is not worst than the one we would be
-       replacing. If so, we don't put the new neighbor on the list. */
-    worst_rtmetric = 0;
-    worst_neighbor = NULL;
+    /* Find the neighbor that we have not heard from for the longest
+       time, preferring the one with the highest rtmetric among those
+       that are equally old. This is the neighbor that we are least
+       likely to be using in the future. Our current parent and our
+       best parent candidate are never recycled. */
+    lru_neighbor = NULL;
 
     for(n = list_head(neighbors_list->list);
         n != NULL; n = list_item_next(n)) {
-      if(n->rtmetric > worst_rtmetric) {
-        worst_neighbor = n;
-        worst_rtmetric = n->rtmetric;
+      if(is_parent(neighbors_list, n) ||
+         (neighbors_list->best_valid && neighbors_list->best == n)) {
+        continue;
+      }
+      if(lru_neighbor == NULL || n->age > lru_neighbor->age ||
+         (n->age == lru_neighbor->age &&
+          n->rtmetric > lru_neighbor->rtmetric)) {
+        lru_neighbor = n;
       }
     }
 
-    /* Only add this new neighbor if its rtmetric is lower than the
-       one it would replace. */
-    if(nrtmetric < worst_rtmetric) {
-      n = worst_neighbor;
-    }
-    if(n != NULL) {
+    /* A neighbor that we have heard from recently is only replaced
+       by one with a lower rtmetric. */
+    if(lru_neighbor != NULL &&
+       (lru_neighbor->age > 0 || nrtmetric < lru_neighbor->rtmetric)) {
+      n = lru_neighbor;
       PRINTF("collect_neighbor_add: not on list, not allocated, recycling %d.%d\n",
              n->addr.u8[0], n->addr.u8[1]);
     }
   }
 
   if(n != NULL) {
+    if(on_list) {
+      old_rtmetric = collect_neighbor_rtmetric_link_estimate(n);
+    } else {
+      old_rtmetric = RTMETRIC_MAX;
+    }
+    n->neighbor_list = neighbors_list;
     n->age = 0;
     rimeaddr_copy(&n->addr, addr);
     n->rtmetric = nrtmetric;
     collect_link_estimate_new(&n->le);
     n->le_age = 0;
+    rtmetric_changed(n, old_rtmetric);
     return 1;
   }
   return 0;
@@ -246,8 +329,7 @@ collect_neighbor_list_remove(struct collect_neighbor_list *neighbors_list,
   n = collect_neighbor_list_find(neighbors_list, addr);
 
   if(n != NULL) {
-    list_remove(neighbors_list->list, n);
-    memb_free(&collect_neighbors_mem, n);
+    remove_neighbor(neighbors_list, n);
   }
 }
 /*---------------------------------------------------------------------------*/
@@ -266,6 +348,12 @@ collect_neighbor_list_best(struct collect_neighbor_list *neighbors_list)
     return NULL;
   }
 
+  /* The cached best neighbor stays valid until its rtmetric or link
+     estimate gets worse or it is removed from the list. */
+  if(neighbors_list->best_valid) {
+    return neighbors_list->best;
+  }
+
   /*  PRINTF("%d: ", node_id);*/
   PRINTF("collect_neighbor_best: ");
 
@@ -282,6 +370,8 @@ collect_neighbor_list_best(struct collect_neighbor_list *neighbors_list)
   }
   PRINTF("\n");
 
+  neighbors_list->best = best;
+  neighbors_list->best_valid = 1;
   return best;
 }
 /*---------------------------------------------------------------------------*/
@@ -330,6 +420,8 @@ collect_neighbor_list_purge(struct collect_neighbor_list *neighbors_list)
   while(list_head(neighbors_list->list) != NULL) {
     memb_free(&collect_neighbors_mem, list_pop(neighbors_list->list));
   }
+  neighbors_list->best = NULL;
+  neighbors_list->best_valid = 0;
 }
 /*---------------------------------------------------------------------------*/
 void
@@ -339,7 +431,11 @@ collect_neighbor_update_rtmetric(struct collect_neighbor *n, uint16_t rtmetric)
     PRINTF("%d.%d: collect_neighbor_update %d.%d rtmetric %d\n",
            rimeaddr_node_addr.u8[0], rimeaddr_node_addr.u8[1],
            n->addr.u8[0], n->addr.u8[1], rtmetric);
-    n->rtmetric = rtmetric;
+    if(n->rtmetric != rtmetric) {
+      uint16_t old_rtmetric = collect_neighbor_rtmetric_link_estimate(n);
+      n->rtmetric = rtmetric;
+      rtmetric_changed(n, old_rtmetric);
+    }
     n->age = 0;
   }
 }
@@ -347,10 +443,14 @@ collect_neighbor_update_rtmetric(struct collect_neighbor *n, uint16_t rtmetric)
 void
 collect_neighbor_tx_fail(struct collect_neighbor *n, uint16_t num_tx)
 {
+  uint16_t old_rtmetric;
+
   if(n == NULL) {
     return;
   }
+  old_rtmetric = collect_neighbor_rtmetric_link_estimate(n);
   collect_link_estimate_update_tx_fail(&n->le, num_tx);
+  rtmetric_changed(n, old_rtmetric);
   n->le_age = 0;
   n->age = 0;
 }
@@ -358,10 +458,14 @@ collect_neighbor_tx_fail(struct collect_neighbor *n, uint16_t num_tx)
 void
 collect_neighbor_tx(struct collect_neighbor *n, uint16_t num_tx)
 {
+  uint16_t old_rtmetric;
+
   if(n == NULL) {
     return;
   }
+  old_rtmetric = collect_neighbor_rtmetric_link_estimate(n);
   collect_link_estimate_update_tx(&n->le, num_tx);
+  rtmetric_changed(n, old_rtmetric);
   n->le_age = 0;
   n->age = 0;
 }
@@ -58,10 +58,14 @@
 struct collect_neighbor_list {
   LIST_STRUCT(list);
   struct ctimer periodic;
+  struct collect_neighbor *best;
+  uint8_t best_valid;
+  const rimeaddr_t *parent;
 };
 
 struct collect_neighbor {
   struct collect_neighbor *next;
+  struct collect_neighbor_list *neighbor_list;
   rimeaddr_t addr;
   uint16_t rtmetric;
   uint16_t age;
@@ -75,6 +79,8 @@ void collect_neighbor_init(void);
 list_t collect_neighbor_list(struct collect_neighbor_list *neighbor_list);
 
 void collect_neighbor_list_new(struct collect_neighbor_list *neighbor_list);
+void collect_neighbor_list_set_parent(struct collect_neighbor_list *neighbor_list,
+                                      const rimeaddr_t *parent);
 
 int collect_neighbor_list_add(struct collect_neighbor_list *neighbor_list,
                               const rimeaddr_t *addr, uint16_t rtmetric);
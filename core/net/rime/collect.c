@@ -1291,6 +1291,7 @@ collect_open(struct collect_conn *tc, uint16_t channels,
   tc->eseqno = 0;
   LIST_STRUCT_INIT(tc, send_queue_list);
   collect_neighbor_list_new(&tc->neighbor_list);
+  collect_neighbor_list_set_parent(&tc->neighbor_list, &tc->parent);
   tc->send_queue.list = &(tc->send_queue_list);
   tc->send_queue.memb = &send_queue_memb;
   collect_neighbor_init();
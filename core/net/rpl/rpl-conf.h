@@ -186,4 +186,74 @@
 #define RPL_DEFAULT_LIFETIME            RPL_CONF_DEFAULT_LIFETIME
 #endif
 
+/*
+ * Number of expired routes collected by one route purge before they
+ * are advertised to the preferred parent. All of them travel in a
+ * single No-Path DAO, split further only if the targets do not fit
+ * in the uIP buffer.
+ */
+#ifndef RPL_CONF_NOPATH_BATCH
+#define RPL_NOPATH_BATCH                8
+#else
+#define RPL_NOPATH_BATCH                RPL_CONF_NOPATH_BATCH
+#endif
+
+/*
+ * DAO aggregation. Instead of forwarding every DAO received from a
+ * child on its own, a router collects the targets during
+ * RPL_DAO_AGGREGATION_WINDOW and sends them upwards in as few
+ * multi-target DAOs as possible. At most RPL_DAO_AGGREGATION_TARGETS
+ * targets are held; a full set is sent at once.
+ */
+#ifndef RPL_CONF_DAO_AGGREGATION
+#define RPL_DAO_AGGREGATION             1
+#else
+#define RPL_DAO_AGGREGATION             RPL_CONF_DAO_AGGREGATION
+#endif
+
+#ifndef RPL_CONF_DAO_AGGREGATION_WINDOW
+#define RPL_DAO_AGGREGATION_WINDOW      (CLOCK_SECOND / 16)
+#else
+#define RPL_DAO_AGGREGATION_WINDOW      RPL_CONF_DAO_AGGREGATION_WINDOW
+#endif
+
+/*
+ * Non-storing mode of operation (RFC 6550 section 9.7). Nodes keep no
+ * downward routes: DAOs go to the root, which records the parent of
+ * every node and sends downward traffic with an RPL source routing
+ * header (RFC 6554). When enabled, RPL_MOP_NON_STORING becomes the
+ * default mode of operation.
+ */
+#ifndef RPL_CONF_WITH_NON_STORING
+#define RPL_WITH_NON_STORING            0
+#else
+#define RPL_WITH_NON_STORING            RPL_CONF_WITH_NON_STORING
+#endif
+
+/* Number of child-to-parent links the non-storing root can hold. */
+#ifndef RPL_NS_CONF_LINK_NUM
+#define RPL_NS_LINK_NUM                 32
+#else
+#define RPL_NS_LINK_NUM                 RPL_NS_CONF_LINK_NUM
+#endif
+
+/* Longest source route, in hops, and number of cached source routes. */
+#ifndef RPL_NS_CONF_MAX_HOPS
+#define RPL_NS_MAX_HOPS                 8
+#else
+#define RPL_NS_MAX_HOPS                 RPL_NS_CONF_MAX_HOPS
+#endif
+
+#ifndef RPL_NS_CONF_PATH_CACHE
+#define RPL_NS_PATH_CACHE               4
+#else
+#define RPL_NS_PATH_CACHE               RPL_NS_CONF_PATH_CACHE
+#endif
+
+#ifndef RPL_CONF_DAO_AGGREGATION_TARGETS
+#define RPL_DAO_AGGREGATION_TARGETS     8
+#else
+#define RPL_DAO_AGGREGATION_TARGETS     RPL_CONF_DAO_AGGREGATION_TARGETS
+#endif
+
 #endif /* RPL_CONF_H */
@@ -73,11 +73,29 @@ extern char check_dao_ack;
 /*---------------------------------------------------------------------------*/
 /* Per-parent RPL information */
 NBR_TABLE(rpl_parent_t, rpl_parents);
+/* Candidate parents of all DAGs, linked through their next field and
+   sorted by increasing path cost. Parents with an infinite rank are
+   left out. */
+static rpl_parent_t *candidates;
 /*---------------------------------------------------------------------------*/
 /* Allocate instance table. */
 rpl_instance_t instance_table[RPL_MAX_INSTANCES];
 rpl_instance_t *default_instance;
 
+/*---------------------------------------------------------------------------*/
+static void
+candidate_unlink(rpl_parent_t *p)
+{
+  rpl_parent_t **pp;
+
+  for(pp = &candidates; *pp != NULL; pp = &(*pp)->next) {
+    if(*pp == p) {
+      *pp = p->next;
+      break;
+    }
+  }
+  p->next = NULL;
+}
 /*---------------------------------------------------------------------------*/
 static void
 nbr_callback(void *ptr)
@@ -560,6 +578,12 @@ rpl_add_parent(rpl_dag_t *dag, rpl_dio_t *dio, uip_ipaddr_t *addr)
   PRINT6ADDR(addr);
   PRINTF("\n");
   if(lladdr != NULL) {
+    /* The entry is cleared if it already exists, so take it out of the
+       candidate list first. */
+    p = nbr_table_get_from_lladdr(rpl_parents, (rimeaddr_t *)lladdr);
+    if(p != NULL) {
+      candidate_unlink(p);
+    }
     /* Add parent in rpl_parents */
     p = nbr_table_add_lladdr(rpl_parents, (rimeaddr_t *)lladdr);
     if(p == NULL) {
@@ -572,6 +596,7 @@ rpl_add_parent(rpl_dag_t *dag, rpl_dio_t *dio, uip_ipaddr_t *addr)
 #if RPL_DAG_MC != RPL_DAG_MC_NONE
       memcpy(&p->mc, &dio->mc, sizeof(p->mc));
 #endif /* RPL_DAG_MC != RPL_DAG_MC_NONE */
+      rpl_reorder_parent(p);
     }
   }
 
@@ -720,26 +745,54 @@ rpl_select_dag(rpl_instance_t *instance, rpl_parent_t *p)
   return best_dag;
 }
 /*---------------------------------------------------------------------------*/
+void
+rpl_reorder_parent(rpl_parent_t *p)
+{
+  rpl_parent_t **pp;
+  rpl_of_t *of;
+  uint16_t cost;
+
+  /* Called whenever the rank, metric container or link metric of a
+     parent changes: only this parent moves, the others keep their
+     place in the list. */
+  candidate_unlink(p);
+  if(p->dag == NULL || p->rank == INFINITE_RANK) {
+    return;
+  }
+
+  of = p->dag->instance->of;
+  cost = of->parent_path_cost(p);
+  for(pp = &candidates; *pp != NULL; pp = &(*pp)->next) {
+    if(of->parent_path_cost(*pp) > cost) {
+      break;
+    }
+  }
+  p->next = *pp;
+  *pp = p;
+}
+/*---------------------------------------------------------------------------*/
 static rpl_parent_t *
 best_parent(rpl_dag_t *dag)
 {
-  rpl_parent_t *p, *best;
+  rpl_parent_t *p, *preferred;
 
-  best = NULL;
+  p = candidates;
+  while(p != NULL && p->dag != dag) {
+    p = p->next;
+  }
+  if(p == NULL) {
+    return NULL;
+  }
 
-  p = nbr_table_head(rpl_parents);
-  while(p != NULL) {
-    if(p->rank == INFINITE_RANK) {
-      /* ignore this neighbor */
-    } else if(best == NULL) {
-      best = p;
-    } else {
-      best = dag->instance->of->best_parent(best, p);
-    }
-    p = nbr_table_next(rpl_parents, p);
+  /* The cheapest candidate only replaces the preferred parent if the
+     objective function finds the difference large enough. */
+  preferred = dag->preferred_parent;
+  if(preferred != NULL && preferred != p &&
+     preferred->dag == dag && preferred->rank != INFINITE_RANK) {
+    return dag->instance->of->best_parent(p, preferred);
   }
 
-  return best;
+  return p;
 }
 /*---------------------------------------------------------------------------*/
 rpl_parent_t *
@@ -763,6 +816,7 @@ rpl_remove_parent(rpl_parent_t *parent)
 
   rpl_nullify_parent(parent);
 
+  candidate_unlink(parent);
   nbr_table_remove(rpl_parents, parent);
 }
 /*---------------------------------------------------------------------------*/
@@ -1288,6 +1342,7 @@ rpl_process_dio(uip_ipaddr_t *from, rpl_dio_t *dio, int mobility)
       }
     } else {
       p->rank = dio->rank;
+      rpl_reorder_parent(p);
     }
   }
 
@@ -1322,6 +1377,7 @@ rpl_process_dio(uip_ipaddr_t *from, rpl_dio_t *dio, int mobility)
   if(mobility == 0) {
 #if RPL_DAG_MC != RPL_DAG_MC_NONE
     memcpy(&p->mc, &dio->mc, sizeof(p->mc));
+    rpl_reorder_parent(p);
 #endif /* RPL_DAG_MC != RPL_DAG_MC_NONE */
     if(rpl_process_parent_event(instance, p) == 0) {
       PRINTF("RPL: The candidate parent is rejected\n");
@@ -45,6 +45,7 @@
 #include "net/uip.h"
 #include "net/tcpip.h"
 #include "net/uip-ds6.h"
+#include "net/uip-icmp6.h"
 #include "net/rpl/rpl-private.h"
 
 #define DEBUG DEBUG_NONE
@@ -168,6 +169,237 @@ set_rpl_opt(unsigned uip_ext_opt_offset)
   }
 }
 /*---------------------------------------------------------------------------*/
+#if RPL_WITH_NON_STORING
+/*---------------------------------------------------------------------------*/
+/* RFC 6554 source routing header, used in non-storing mode. */
+#define RPL_RH_TYPE_SRH           3
+#define RPL_SRH_LEN               8
+
+static void
+set_linklocal_from_global(uip_ipaddr_t *ll, const uip_ipaddr_t *addr)
+{
+  uip_create_linklocal_prefix(ll);
+  memcpy(&ll->u8[8], &addr->u8[8], 8);
+}
+/*---------------------------------------------------------------------------*/
+/* Returns the offset in uip_buf where a routing header would go, that
+   is after the IPv6 header and a RPL hop-by-hop option if there is
+   one. *next is set to the next header field that precedes it. */
+static int
+srh_position(uint8_t **next)
+{
+  int offset;
+
+  offset = UIP_LLH_LEN + UIP_IPH_LEN;
+  *next = &UIP_IP_BUF->proto;
+  if(**next == UIP_PROTO_HBHO) {
+    *next = &((struct uip_ext_hdr *)&uip_buf[offset])->next;
+    offset += (((struct uip_ext_hdr *)&uip_buf[offset])->len << 3) + 8;
+  }
+  return offset;
+}
+/*---------------------------------------------------------------------------*/
+static uint8_t *
+srh_find(void)
+{
+  uint8_t *next;
+  int offset;
+
+  offset = srh_position(&next);
+  if(*next == UIP_PROTO_ROUTING &&
+     ((struct uip_routing_hdr *)&uip_buf[offset])->routing_type ==
+     RPL_RH_TYPE_SRH) {
+    return &uip_buf[offset];
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static int
+insert_srh(rpl_ns_node_t **hops, int len)
+{
+  uint8_t *next;
+  uint8_t *rh;
+  uint8_t cmpr;
+  uint8_t pad;
+  int offset;
+  int size;
+  int n;
+  int i;
+  int j;
+
+  /* The first hop becomes the IPv6 destination; the remaining hops,
+     ending with the final destination, are carried in the header with
+     the prefix they share with the first hop elided. */
+  n = len - 1;
+  cmpr = 15;
+  for(i = 1; i < len; i++) {
+    for(j = 0; j < cmpr; j++) {
+      if(hops[i]->addr.u8[j] != hops[0]->addr.u8[j]) {
+        break;
+      }
+    }
+    cmpr = j;
+  }
+
+  size = RPL_SRH_LEN + n * (16 - cmpr);
+  pad = (8 - (size & 7)) & 7;
+  size += pad;
+
+  if(uip_len + size > UIP_BUFSIZE - UIP_LLH_LEN) {
+    PRINTF("RPL: Packet too long: impossible to add source routing header\n");
+    return 0;
+  }
+
+  offset = srh_position(&next);
+  memmove(&uip_buf[offset + size], &uip_buf[offset],
+          UIP_LLH_LEN + uip_len - offset);
+
+  rh = &uip_buf[offset];
+  memset(rh, 0, size);
+  rh[0] = *next;
+  *next = UIP_PROTO_ROUTING;
+  rh[1] = size / 8 - 1;
+  rh[2] = RPL_RH_TYPE_SRH;
+  rh[3] = n;
+  rh[4] = (cmpr << 4) | cmpr;
+  rh[5] = pad << 4;
+  for(i = 0; i < n; i++) {
+    memcpy(&rh[RPL_SRH_LEN + i * (16 - cmpr)], &hops[i + 1]->addr.u8[cmpr],
+           16 - cmpr);
+  }
+
+  uip_ipaddr_copy(&UIP_IP_BUF->destipaddr, &hops[0]->addr);
+  uip_len += size;
+  UIP_IP_BUF->len[0] = (uip_len - UIP_IPH_LEN) >> 8;
+  UIP_IP_BUF->len[1] = (uip_len - UIP_IPH_LEN) & 0xff;
+
+  PRINTF("RPL: Inserted source routing header, %d hops, %d bytes\n", n, size);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static int
+ns_root_path(rpl_ns_node_t ***hops)
+{
+  rpl_dag_t *dag;
+
+  if(default_instance == NULL ||
+     default_instance->mop != RPL_MOP_NON_STORING) {
+    return -1;
+  }
+  dag = default_instance->current_dag;
+  if(dag == NULL || !dag->joined || dag->rank != ROOT_RANK(default_instance)) {
+    return -1;
+  }
+  return rpl_ns_get_path(dag, &UIP_IP_BUF->destipaddr, hops);
+}
+/*---------------------------------------------------------------------------*/
+int
+rpl_srh_output(uip_ipaddr_t *nexthop)
+{
+  rpl_ns_node_t **hops;
+  int len;
+
+  if(srh_find() == NULL) {
+    len = ns_root_path(&hops);
+    if(len <= 0) {
+      return 0;
+    }
+    if(len > 1 && !insert_srh(hops, len)) {
+      return -1;
+    }
+  }
+
+  /* Nodes on a source route are addressed by their global address;
+     the next hop is reached through the link-local address with the
+     same interface identifier. */
+  set_linklocal_from_global(nexthop, &UIP_IP_BUF->destipaddr);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+/* Processes the source routing header rh, which sits at uip_ext_len
+   past the IPv6 header. Returns 1 if the packet is to be forwarded
+   to the new destination, 2 if the header is malformed and an ICMPv6
+   Parameter Problem has been built in uip_buf (RFC 6554, section
+   4.2), -1 if the packet is to be dropped silently and 0 if rh is
+   not a source routing header. */
+int
+rpl_srh_process(struct uip_routing_hdr *rh)
+{
+  uint8_t *p;
+  uint8_t cmpri;
+  uint8_t cmpre;
+  uint8_t pad;
+  uint16_t offset;
+  uint16_t addr_len;
+  uint16_t n;
+  uint16_t i;
+
+  if(rh->routing_type != RPL_RH_TYPE_SRH) {
+    return 0;
+  }
+
+  p = (uint8_t *)rh;
+  offset = UIP_IPH_LEN + uip_ext_len;
+  cmpri = p[4] >> 4;
+  cmpre = p[4] & 0x0f;
+  pad = p[5] >> 4;
+
+  /* The header must lie within the packet and its addresses must
+     hold at least the last, CmprE-compressed, one. Anything else
+     would have us read past the packet when copying the next hop. */
+  addr_len = rh->len * 8;
+  if(uip_len < offset + RPL_SRH_LEN + addr_len ||
+     addr_len < pad + (16 - cmpre)) {
+    PRINTF("RPL: Bad source routing header length %u\n", rh->len);
+    uip_icmp6_error_output(ICMP6_PARAM_PROB, ICMP6_PARAMPROB_HEADER,
+                           offset + 1);
+    return 2;
+  }
+
+  n = (addr_len - pad - (16 - cmpre)) / (16 - cmpri) + 1;
+  if(rh->seg_left > n) {
+    PRINTF("RPL: Bad source routing header (%u > %u)\n", rh->seg_left, n);
+    uip_icmp6_error_output(ICMP6_PARAM_PROB, ICMP6_PARAMPROB_HEADER,
+                           offset + 3);
+    return 2;
+  }
+
+  rh->seg_left--;
+  i = n - rh->seg_left;
+  if(i == n) {
+    memcpy(&UIP_IP_BUF->destipaddr.u8[cmpre],
+           &p[RPL_SRH_LEN + (i - 1) * (16 - cmpri)], 16 - cmpre);
+  } else {
+    memcpy(&UIP_IP_BUF->destipaddr.u8[cmpri],
+           &p[RPL_SRH_LEN + (i - 1) * (16 - cmpri)], 16 - cmpri);
+  }
+
+  if(uip_is_addr_mcast(&UIP_IP_BUF->destipaddr) ||
+     uip_ds6_is_my_addr(&UIP_IP_BUF->destipaddr)) {
+    PRINTF("RPL: Bad source routing header destination\n");
+    return -1;
+  }
+
+  PRINTF("RPL: Source routing to ");
+  PRINT6ADDR(&UIP_IP_BUF->destipaddr);
+  PRINTF(", %u segments left\n", rh->seg_left);
+  return 1;
+}
+#endif /* RPL_WITH_NON_STORING */
+/*---------------------------------------------------------------------------*/
+static int
+downward_route_exists(void)
+{
+#if RPL_WITH_NON_STORING
+  rpl_ns_node_t **hops;
+
+  if(srh_find() != NULL || ns_root_path(&hops) > 0) {
+    return 1;
+  }
+#endif /* RPL_WITH_NON_STORING */
+  return uip_ds6_route_lookup(&UIP_IP_BUF->destipaddr) != NULL;
+}
+/*---------------------------------------------------------------------------*/
 void
 rpl_update_header_empty(void)
 {
@@ -217,7 +449,7 @@ rpl_update_header_empty(void)
        general not go back up again. If this happens, a
        RPL_HDR_OPT_FWD_ERR should be flagged. */
     if((UIP_EXT_HDR_OPT_RPL_BUF->flags & RPL_HDR_OPT_DOWN)) {
-      if(uip_ds6_route_lookup(&UIP_IP_BUF->destipaddr) == NULL) {
+      if(!downward_route_exists()) {
         UIP_EXT_HDR_OPT_RPL_BUF->flags |= RPL_HDR_OPT_FWD_ERR;
         PRINTF("RPL forwarding error\n");
       }
@@ -225,7 +457,7 @@ rpl_update_header_empty(void)
       /* Set the down extension flag correctly as described in Section
          11.2 of RFC6550. If the packet progresses along a DAO route,
          the down flag should be set. */
-      if(uip_ds6_route_lookup(&UIP_IP_BUF->destipaddr) == NULL) {
+      if(!downward_route_exists()) {
         /* No route was found, so this packet will go towards the RPL
            root. If so, we should not set the down flag. */
         UIP_EXT_HDR_OPT_RPL_BUF->flags &= ~RPL_HDR_OPT_DOWN;
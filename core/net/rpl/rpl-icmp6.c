@@ -139,6 +139,15 @@ static struct etimer dios_input;
 /* DAO delay upon best parent DIO processing */
 struct ctimer dao_period;
 
+#if RPL_DAO_AGGREGATION
+/* Targets learned from child DAOs, waiting to be sent upwards. */
+static struct ctimer dao_aggr_timer;
+static rpl_instance_t *dao_aggr_instance;
+static uip_ipaddr_t dao_aggr_targets[RPL_DAO_AGGREGATION_TARGETS];
+static uint8_t dao_aggr_lifetimes[RPL_DAO_AGGREGATION_TARGETS];
+static uint8_t dao_aggr_count;
+#endif /* RPL_DAO_AGGREGATION */
+
 /*---------------------------------------------------------------------------*/
 static int get_global_addr(uip_ipaddr_t *addr)
 {
@@ -443,6 +452,7 @@ if ((nbr = uip_ds6_nbr_lookup(&from)) == NULL) {
 			NBR_REACHABLE)) != NULL) {
 		/* set reachable timer */
 		stimer_set(&nbr->reachable, UIP_ND6_REACHABLE_TIME / 1000);
+		uip_ds6_schedule_stimer(&nbr->reachable);
 		PRINTF("RPL: Neighbor added to neighbor cache "); PRINT6ADDR(&from); PRINTF(", "); PRINTLLADDR((uip_lladdr_t *)packetbuf_addr(PACKETBUF_ADDR_SENDER)); PRINTF("\n");
 	} else {
 		PRINTF("RPL: Out of Memory, dropping DIO from "); PRINT6ADDR(&from); PRINTF(", "); PRINTLLADDR((uip_lladdr_t *)packetbuf_addr(PACKETBUF_ADDR_SENDER)); PRINTF("\n");
@@ -949,6 +959,144 @@ uip_icmp6_send(uc_addr, ICMP6_RPL, RPL_CODE_DIO, pos);
 #endif /* RPL_LEAF_ONLY */
 }
 /*---------------------------------------------------------------------------*/
+#if RPL_DAO_AGGREGATION
+static void dao_aggregate_flush(void *ptr) {
+rpl_dag_t *dag;
+uip_ipaddr_t addr;
+uint8_t lifetime;
+int i;
+int n;
+int sent;
+
+ctimer_stop(&dao_aggr_timer);
+if (dao_aggr_count == 0 || dao_aggr_instance == NULL) {
+dao_aggr_count = 0;
+return;
+}
+dag = dao_aggr_instance->current_dag;
+if (dag == NULL || dag->preferred_parent == NULL) {
+PRINTF("RPL: No parent, dropping %u aggregated DAO targets\n", dao_aggr_count);
+dao_aggr_count = 0;
+return;
+}
+
+while (dao_aggr_count > 0) {
+/* Move the targets sharing the lifetime of the first one to the front,
+ they can travel in the same DAO. */
+lifetime = dao_aggr_lifetimes[0];
+n = 0;
+for (i = 0; i < dao_aggr_count; i++) {
+	if (dao_aggr_lifetimes[i] == lifetime) {
+		uip_ipaddr_copy(&addr, &dao_aggr_targets[i]);
+		uip_ipaddr_copy(&dao_aggr_targets[i], &dao_aggr_targets[n]);
+		uip_ipaddr_copy(&dao_aggr_targets[n], &addr);
+		dao_aggr_lifetimes[i] = dao_aggr_lifetimes[n];
+		dao_aggr_lifetimes[n] = lifetime;
+		n++;
+	}
+}
+PRINTF("RPL: Sending %d aggregated DAO targets, lifetime %u\n", n, lifetime);
+for (i = 0; i < n; i += sent) {
+	sent = dao_output_targets(dag->preferred_parent, &dao_aggr_targets[i],
+			n - i, lifetime);
+	if (sent <= 0) {
+		break;
+	}
+}
+/* Drop the group just sent. */
+dao_aggr_count -= n;
+for (i = 0; i < dao_aggr_count; i++) {
+	uip_ipaddr_copy(&dao_aggr_targets[i], &dao_aggr_targets[n + i]);
+	dao_aggr_lifetimes[i] = dao_aggr_lifetimes[n + i];
+}
+}
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Queue a target for the next aggregated DAO. This may run while uip_buf
+ * still holds the DAO being parsed, so nothing is sent from here: a full
+ * set is flushed by the timer right away. Returns 0 if the target could
+ * not be queued and has to be forwarded as before.
+ */
+static int dao_aggregate(rpl_instance_t *instance, uip_ipaddr_t *prefix,
+uint8_t lifetime) {
+int i;
+
+if (dao_aggr_count > 0 && dao_aggr_instance != instance) {
+return 0;
+}
+dao_aggr_instance = instance;
+
+/* A newer registration of a pending target replaces the older one. */
+for (i = 0; i < dao_aggr_count; i++) {
+if (uip_ipaddr_cmp(&dao_aggr_targets[i], prefix)) {
+	dao_aggr_lifetimes[i] = lifetime;
+	return 1;
+}
+}
+if (dao_aggr_count == RPL_DAO_AGGREGATION_TARGETS) {
+return 0;
+}
+
+uip_ipaddr_copy(&dao_aggr_targets[dao_aggr_count], prefix);
+dao_aggr_lifetimes[dao_aggr_count++] = lifetime;
+if (dao_aggr_count == RPL_DAO_AGGREGATION_TARGETS) {
+ctimer_set(&dao_aggr_timer, 0, dao_aggregate_flush, NULL);
+} else if (dao_aggr_count == 1) {
+ctimer_set(&dao_aggr_timer, RPL_DAO_AGGREGATION_WINDOW,
+		dao_aggregate_flush, NULL);
+}
+return 1;
+}
+#endif /* RPL_DAO_AGGREGATION */
+/*---------------------------------------------------------------------------*/
+static int dao_transit(unsigned char *buffer, int pos, uint8_t lifetime) {
+buffer[pos++] = RPL_OPTION_TRANSIT;
+buffer[pos++] = 4;
+buffer[pos++] = 0; /* flags - ignored */
+buffer[pos++] = 0; /* path control - ignored */
+buffer[pos++] = 0; /* path seq - ignored */
+buffer[pos++] = lifetime;
+return pos;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Rewrite the received DAO in place so that it only carries the targets
+ * marked in forward[], each run of equal lifetime followed by one Transit
+ * option, and return its new length (0 if there is nothing to forward).
+ * The first header_len bytes are kept as received. Targets only move
+ * towards the front, and a lifetime change means that a Transit option
+ * of at least the same size lay in between, so no unread target is
+ * overwritten.
+ */
+static int dao_forward_targets(unsigned char *buffer, int header_len,
+uint16_t *target_pos, uint8_t *target_lifetime, uint8_t *forward,
+int ntargets) {
+int pos;
+int len;
+int last;
+int t;
+
+pos = header_len;
+last = -1;
+for (t = 0; t < ntargets; t++) {
+if (!forward[t]) {
+	continue;
+}
+if (last >= 0 && target_lifetime[t] != target_lifetime[last]) {
+	pos = dao_transit(buffer, pos, target_lifetime[last]);
+}
+len = 2 + buffer[target_pos[t] + 1];
+memmove(buffer + pos, buffer + target_pos[t], len);
+pos += len;
+last = t;
+}
+if (last < 0 || pos + 6 > UIP_BUFSIZE - uip_l2_l3_icmp_hdr_len) {
+return 0;
+}
+return dao_transit(buffer, pos, target_lifetime[last]);
+}
+/*---------------------------------------------------------------------------*/
 static void dao_input(void) {
 uip_ipaddr_t dao_sender_addr;
 rpl_dag_t *dag;
@@ -966,13 +1114,25 @@ uint8_t subopt_type;
  */
 uip_ipaddr_t prefix;
 uip_ds6_route_t *rep;
-uint8_t buffer_length;
+uint16_t buffer_length;
 int pos;
 int len;
 int i;
 int learned_from;
 rpl_parent_t *p;
 uip_ds6_nbr_t *nbr;
+uint16_t target_pos[RPL_DAO_MAX_TARGETS];
+uint8_t target_lifetime[RPL_DAO_MAX_TARGETS];
+uint8_t target_forward[RPL_DAO_MAX_TARGETS];
+#if RPL_WITH_NON_STORING
+uint16_t target_transit[RPL_DAO_MAX_TARGETS];
+#endif /* RPL_WITH_NON_STORING */
+int ntargets;
+int group;
+int t;
+uint8_t forward;
+uint8_t ack;
+uint8_t registered;
 
 prefixlen = 0;
 
@@ -1013,33 +1173,108 @@ pos += 16;
 /* Perhaps, there are verification to do but ... */
 }
 
-/* Check if there are any RPL options present. */
+/*
+ * Check if there are any RPL options present. A Transit option applies
+ * to all the Target options that precede it, so the targets are only
+ * collected here and handled together below.
+ */
+ntargets = 0;
+group = 0;
 for (i = pos; i < buffer_length; i += len) {
 subopt_type = buffer[i];
 if (subopt_type == RPL_OPTION_PAD1) {
 	len = 1;
-} else {
+} else if (i + 1 < buffer_length) {
 	/* The option consists of a two-byte header and a payload. */
 	len = 2 + buffer[i + 1];
+} else {
+	len = 2;
+}
+
+if (len + i > buffer_length) {
+	PRINTF("RPL: Invalid DAO packet\n"); RPL_STAT(rpl_stats.malformed_msgs++);
+	return;
 }
 
 switch (subopt_type) {
 case RPL_OPTION_TARGET:
 	/* Handle the target option. */
-	prefixlen = buffer[i + 3];
-	memset(&prefix, 0, sizeof(prefix));
-	memcpy(&prefix, buffer + i + 4, (prefixlen + 7) / CHAR_BIT);
+	if (len < 4 || buffer[i + 3] > 128
+			|| (buffer[i + 3] + 7) / CHAR_BIT > len - 4) {
+		PRINTF("RPL: Invalid DAO target\n"); RPL_STAT(rpl_stats.malformed_msgs++);
+	} else if (ntargets < RPL_DAO_MAX_TARGETS) {
+		target_pos[ntargets] = i;
+		target_forward[ntargets] = 0;
+		target_lifetime[ntargets++] = lifetime;
+	} else {
+		PRINTF("RPL: Too many targets in DAO, ignoring the rest\n");
+	}
 	break;
 case RPL_OPTION_TRANSIT:
+	if (len < 6) {
+		PRINTF("RPL: Invalid DAO transit\n"); RPL_STAT(rpl_stats.malformed_msgs++);
+		break;
+	}
 	/* The path sequence and control are ignored. */
 	/*      pathcontrol = buffer[i + 3];
 	 pathsequence = buffer[i + 4]; */
-	lifetime = buffer[i + 5];
-	/* The parent address is also ignored. */
+	/* The parent address is only used in non-storing mode. */
+	for (; group < ntargets; group++) {
+		target_lifetime[group] = buffer[i + 5];
+#if RPL_WITH_NON_STORING
+		target_transit[group] = i;
+#endif /* RPL_WITH_NON_STORING */
+	}
 	break;
 }
 }
 
+#if RPL_WITH_NON_STORING
+if (instance->mop == RPL_MOP_NON_STORING) {
+/* Only the root keeps downward state in non-storing mode: record the
+ parent of each target instead of a route through the sender. */
+if (dag->rank != ROOT_RANK(instance)) {
+	PRINTF("RPL: Ignoring a non-storing DAO, not the root\n");
+	return;
+}
+for (t = 0; t < group; t++) {
+	i = target_pos[t];
+	if (buffer[target_transit[t] + 1] < 20) {
+		PRINTF("RPL: Non-storing DAO target without a parent address\n");
+		continue;
+	}
+	prefixlen = buffer[i + 3];
+	memset(&prefix, 0, sizeof(prefix));
+	memcpy(&prefix, buffer + i + 4, (prefixlen + 7) / CHAR_BIT);
+	lifetime = target_lifetime[t];
+	PRINTF("RPL: Non-storing DAO lifetime: %u, target: ", (unsigned)lifetime); PRINT6ADDR(&prefix); PRINTF("\n");
+	rpl_ns_update_node(dag, &prefix,
+			(uip_ipaddr_t *)(buffer + target_transit[t] + 6),
+			lifetime == RPL_ZERO_LIFETIME ? 0 : RPL_LIFETIME(instance, lifetime));
+}
+if (flags & RPL_DAO_K_FLAG) {
+	dao_ack_output(instance, &dao_sender_addr, sequence);
+}
+return;
+}
+#endif /* RPL_WITH_NON_STORING */
+
+learned_from =
+	uip_is_addr_mcast(&dao_sender_addr) ?
+	RPL_ROUTE_FROM_MULTICAST_DAO :
+											RPL_ROUTE_FROM_UNICAST_DAO;
+forward = 0;
+ack = 0;
+registered = 0;
+p = NULL;
+
+for (t = 0; t < ntargets; t++) {
+i = target_pos[t];
+lifetime = target_lifetime[t];
+prefixlen = buffer[i + 3];
+memset(&prefix, 0, sizeof(prefix));
+memcpy(&prefix, buffer + i + 4, (prefixlen + 7) / CHAR_BIT);
+
 PRINTF("RPL: DAO lifetime: %u, prefix length: %u prefix: ",
 	(unsigned)lifetime, (unsigned)prefixlen); PRINT6ADDR(&prefix); PRINTF("\n");
 
@@ -1058,24 +1293,20 @@ uip_ipaddr_cmp(uip_ds6_route_nexthop(rep), &dao_sender_addr)) {
 
 	/* We forward the incoming no-path DAO to our parent, if we have
 	 one. */
-	if (dag->preferred_parent != NULL
-			&& rpl_get_parent_ipaddr(dag->preferred_parent) != NULL) {
-		PRINTF("RPL: Forwarding no-path DAO to parent "); PRINT6ADDR(rpl_get_parent_ipaddr(dag->preferred_parent)); PRINTF("\n");
-		uip_icmp6_send(rpl_get_parent_ipaddr(dag->preferred_parent),
-		ICMP6_RPL, RPL_CODE_DAO, buffer_length);
-	}
-	if (flags & RPL_DAO_K_FLAG) {
-		dao_ack_output(instance, &dao_sender_addr, sequence);
+#if RPL_DAO_AGGREGATION
+	if (dag->rank == ROOT_RANK(instance)
+			|| !dao_aggregate(instance, &prefix, RPL_ZERO_LIFETIME)) {
+		target_forward[t] = forward = 1;
 	}
+#else /* RPL_DAO_AGGREGATION */
+	target_forward[t] = forward = 1;
+#endif /* RPL_DAO_AGGREGATION */
+	ack = 1;
 }
-return;
+continue;
 }
 
-learned_from =
-	uip_is_addr_mcast(&dao_sender_addr) ?
-	RPL_ROUTE_FROM_MULTICAST_DAO :
-											RPL_ROUTE_FROM_UNICAST_DAO;
-
+if (!registered) {
 PRINTF("RPL: DAO from %s\n",
 	learned_from ==
 	RPL_ROUTE_FROM_UNICAST_DAO ? "unicast" : "multicast");
@@ -1090,6 +1321,7 @@ DAG_RANK(p->rank, instance) < DAG_RANK(dag->rank, instance)) {
 	("RPL: Loop detected when receiving a unicast DAO from a node with a lower rank! (%u < %u)\n",
 			DAG_RANK(p->rank, instance), DAG_RANK(dag->rank, instance));
 	p->rank = INFINITE_RANK;
+	rpl_reorder_parent(p);
 	p->updated = 1;
 	return;
 }
@@ -1099,6 +1331,7 @@ if (p != NULL && p == dag->preferred_parent) {
 	PRINTF
 	("RPL: Loop detected when receiving a unicast DAO from our parent\n");
 	p->rank = INFINITE_RANK;
+	rpl_reorder_parent(p);
 	p->updated = 1;
 	return;
 }
@@ -1112,6 +1345,7 @@ if ((nbr = uip_ds6_nbr_add(&dao_sender_addr,
 		NBR_REACHABLE)) != NULL) {
 	/* set reachable timer */
 	stimer_set(&nbr->reachable, UIP_ND6_REACHABLE_TIME / 1000);
+	uip_ds6_schedule_stimer(&nbr->reachable);
 	PRINTF("RPL: Neighbor added to neighbor cache "); PRINT6ADDR(&dao_sender_addr); PRINTF(", "); PRINTLLADDR((uip_lladdr_t *)packetbuf_addr(PACKETBUF_ADDR_SENDER)); PRINTF("\n");
 } else {
 	PRINTF("RPL: Out of Memory, dropping DAO from "); PRINT6ADDR(&dao_sender_addr); PRINTF(", "); PRINTLLADDR((uip_lladdr_t *)packetbuf_addr(PACKETBUF_ADDR_SENDER)); PRINTF("\n");
@@ -1122,28 +1356,48 @@ PRINTF("RPL: Neighbor already in neighbor cache\n");
 }
 
 rpl_lock_parent(p);
+registered = 1;
+}
 
 rep = rpl_add_route(dag, &prefix, prefixlen, &dao_sender_addr);
 if (rep == NULL) {
 RPL_STAT(rpl_stats.mem_overflows++); PRINTF("RPL: Could not add a route after receiving a DAO\n");
-return;
+continue;
 }
 
 rep->state.lifetime = RPL_LIFETIME(instance, lifetime);
 rep->state.learned_from = learned_from;
 
 if (learned_from == RPL_ROUTE_FROM_UNICAST_DAO) {
-if (dag->preferred_parent != NULL
+#if RPL_DAO_AGGREGATION
+if (dag->rank == ROOT_RANK(instance)
+		|| !dao_aggregate(instance, &prefix, lifetime)) {
+	target_forward[t] = forward = 1;
+}
+#else /* RPL_DAO_AGGREGATION */
+target_forward[t] = forward = 1;
+#endif /* RPL_DAO_AGGREGATION */
+ack = 1;
+}
+}
+
+/* The targets that we accepted and did not aggregate go upwards in
+ one DAO, whatever their number. Rejected targets are left out: a
+ stale No-Path would remove a valid route at our parent. */
+if (forward && dag->preferred_parent != NULL
 		&& rpl_get_parent_ipaddr(dag->preferred_parent) != NULL) {
-	PRINTF("RPL: Forwarding DAO to parent "); PRINT6ADDR(rpl_get_parent_ipaddr(dag->preferred_parent)); PRINTF("\n");
-	uip_icmp6_send(rpl_get_parent_ipaddr(dag->preferred_parent),
-	ICMP6_RPL, RPL_CODE_DAO, buffer_length);
+	len = dao_forward_targets(buffer, pos, target_pos, target_lifetime,
+			target_forward, ntargets);
+	if (len > 0) {
+		PRINTF("RPL: Forwarding DAO to parent "); PRINT6ADDR(rpl_get_parent_ipaddr(dag->preferred_parent)); PRINTF("\n");
+		uip_icmp6_send(rpl_get_parent_ipaddr(dag->preferred_parent),
+		ICMP6_RPL, RPL_CODE_DAO, len);
+	}
 }
-if (flags & RPL_DAO_K_FLAG) {
+if (ack && (flags & RPL_DAO_K_FLAG)) {
 	dao_ack_output(instance, &dao_sender_addr, sequence);
 }
 }
-}
 /*---------------------------------------------------------------------------*/
 void dao_output(rpl_parent_t *parent, uint8_t lifetime) {
 /* Destination Advertisement Object */
@@ -1154,45 +1408,73 @@ PRINTF("RPL: No global address set for this node - suppressing DAO\n");
 return;
 }
 
+#if RPL_DAO_AGGREGATION
+/* Let our own target ride along with the ones waiting for this parent */
+if (dao_aggr_count > 0 && dao_aggr_instance != NULL
+		&& dao_aggr_instance->current_dag != NULL
+		&& dao_aggr_instance->current_dag->preferred_parent == parent) {
+if (dao_aggregate(dao_aggr_instance, &prefix, lifetime)) {
+	dao_aggregate_flush(NULL);
+	return;
+}
+}
+#endif /* RPL_DAO_AGGREGATION */
+
 /* Sending a DAO with own prefix as target */
 dao_output_target(parent, &prefix, lifetime);
 }
 /*---------------------------------------------------------------------------*/
 void dao_output_target(rpl_parent_t *parent, uip_ipaddr_t *prefix,
 uint8_t lifetime) {
+if (prefix == NULL) {
+PRINTF("RPL dao_output_target error prefix NULL\n");
+return;
+}
+dao_output_targets(parent, prefix, 1, lifetime);
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Send a DAO carrying one Target option per prefix, all sharing the
+ * Transit option that follows them. Returns the number of prefixes
+ * that fit in the message; the caller sends the rest in another DAO.
+ */
+int dao_output_targets(rpl_parent_t *parent, uip_ipaddr_t *prefixes,
+int count, uint8_t lifetime) {
 rpl_dag_t *dag;
 rpl_instance_t *instance;
 unsigned char *buffer;
 uint8_t prefixlen;
 int pos;
+int max;
+int n;
 
 /* Destination Advertisement Object */
 
 /* If we are in feather mode, we should not send any DAOs */
 if (rpl_get_mode() == RPL_MODE_FEATHER) {
-return;
+return count;
 }
 
 if (parent == NULL) {
 PRINTF("RPL dao_output_target error parent NULL\n");
-return;
+return count;
 }
 
 dag = parent->dag;
 if (dag == NULL) {
 PRINTF("RPL dao_output_target error dag NULL\n");
-return;
+return count;
 }
 
 instance = dag->instance;
 
 if (instance == NULL) {
 PRINTF("RPL dao_output_target error instance NULL\n");
-return;
+return count;
 }
-if (prefix == NULL) {
+if (prefixes == NULL || count <= 0) {
 PRINTF("RPL dao_output_target error prefix NULL\n");
-return;
+return 0;
 }
 #ifdef RPL_DEBUG_DAO_OUTPUT
 RPL_DEBUG_DAO_OUTPUT(parent);
@@ -1219,24 +1501,59 @@ memcpy(buffer + pos, &dag->dag_id, sizeof(dag->dag_id));
 pos += sizeof(dag->dag_id);
 #endif /* RPL_DAO_SPECIFY_DAG */
 
-/* create target subopt */
-prefixlen = sizeof(*prefix) * CHAR_BIT;
+/* create target subopts, keeping room for the transit subopt */
+prefixlen = sizeof(*prefixes) * CHAR_BIT;
+max = UIP_BUFSIZE - uip_l2_l3_icmp_hdr_len - RPL_HOP_BY_HOP_LEN - 6;
+#if RPL_WITH_NON_STORING
+if (instance->mop == RPL_MOP_NON_STORING) {
+	/* The transit subopt also carries our global address */
+	max -= 16;
+}
+#endif /* RPL_WITH_NON_STORING */
+for (n = 0; n < count &&
+		pos + 4 + (prefixlen + 7) / CHAR_BIT <= max; n++) {
 buffer[pos++] = RPL_OPTION_TARGET;
 buffer[pos++] = 2 + ((prefixlen + 7) / CHAR_BIT);
 buffer[pos++] = 0; /* reserved */
 buffer[pos++] = prefixlen;
-memcpy(buffer + pos, prefix, (prefixlen + 7) / CHAR_BIT);
+memcpy(buffer + pos, &prefixes[n], (prefixlen + 7) / CHAR_BIT);
 pos += ((prefixlen + 7) / CHAR_BIT);
+PRINTF("RPL: Sending DAO with prefix "); PRINT6ADDR(&prefixes[n]); PRINTF(" to "); PRINT6ADDR(rpl_get_parent_ipaddr(parent)); PRINTF("\n");
+}
+if (n == 0) {
+return 0;
+}
 
 /* Create a transit information sub-option. */
 buffer[pos++] = RPL_OPTION_TRANSIT;
+#if RPL_WITH_NON_STORING
+if (instance->mop == RPL_MOP_NON_STORING) {
+buffer[pos++] = 20;
+} else {
+buffer[pos++] = 4;
+}
+#else /* RPL_WITH_NON_STORING */
 buffer[pos++] = 4;
+#endif /* RPL_WITH_NON_STORING */
 buffer[pos++] = 0; /* flags - ignored */
 buffer[pos++] = 0; /* path control - ignored */
 buffer[pos++] = 0; /* path seq - ignored */
 buffer[pos++] = lifetime;
 
-PRINTF("RPL: Sending DAO with prefix "); PRINT6ADDR(prefix); PRINTF(" to "); PRINT6ADDR(rpl_get_parent_ipaddr(parent)); PRINTF("\n");
+#if RPL_WITH_NON_STORING
+if (instance->mop == RPL_MOP_NON_STORING) {
+/* The DAO goes straight to the root. The parent address is its global
+ address, built from the DAG prefix and its link-local identifier. */
+if (rpl_get_parent_ipaddr(parent) == NULL) {
+	return n;
+}
+memcpy(buffer + pos, &dag->dag_id, 8);
+memcpy(buffer + pos + 8, &rpl_get_parent_ipaddr(parent)->u8[8], 8);
+pos += 16;
+uip_icmp6_send(&dag->dag_id, ICMP6_RPL, RPL_CODE_DAO, pos);
+return n;
+}
+#endif /* RPL_WITH_NON_STORING */
 
 if (rpl_get_parent_ipaddr(parent) != NULL) {
 uip_icmp6_send(rpl_get_parent_ipaddr(parent), ICMP6_RPL, RPL_CODE_DAO, pos);
@@ -1251,6 +1568,7 @@ uip_icmp6_send(rpl_get_parent_ipaddr(parent), ICMP6_RPL, RPL_CODE_DAO, pos);
 /*if(mobility_flag && check_dao_ack) {
  ctimer_set(&dao_period, CLOCK_SECOND / 4, rpl_schedule_dao, instance);
  }*/
+return n;
 }
 /*---------------------------------------------------------------------------*/
 static void dao_ack_input(void) {
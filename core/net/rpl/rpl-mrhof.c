@@ -61,6 +61,7 @@ static int bad_etx_flag;
 static void reset(rpl_dag_t *);
 static void neighbor_link_callback(rpl_parent_t *, int, int);
 static rpl_parent_t *best_parent(rpl_parent_t *, rpl_parent_t *);
+static uint16_t parent_path_cost(rpl_parent_t *);
 static rpl_dag_t *best_dag(rpl_dag_t *, rpl_dag_t *);
 static rpl_rank_t calculate_rank(rpl_parent_t *, rpl_rank_t);
 static void update_metric_container(rpl_instance_t *);
@@ -69,6 +70,7 @@ rpl_of_t rpl_mrhof = {
   reset,
   neighbor_link_callback,
   best_parent,
+  parent_path_cost,
   best_dag,
   calculate_rank,
   update_metric_container,
@@ -146,6 +148,7 @@ neighbor_link_callback(rpl_parent_t *p, int status, int numtx)
            (unsigned)(new_etx / RPL_DAG_MC_ETX_DIVISOR),
            (unsigned)(packet_etx / RPL_DAG_MC_ETX_DIVISOR));
     p->link_metric = new_etx;
+    rpl_reorder_parent(p);
 	/*
 	 *  Unreachability detection timer.
 	 *  If there's no DATA input for NO_DATA_PERIOD, check current parent.
@@ -216,6 +219,11 @@ best_dag(rpl_dag_t *d1, rpl_dag_t *d2)
 
   return d1->rank < d2->rank ? d1 : d2;
 }
+static uint16_t
+parent_path_cost(rpl_parent_t *p)
+{
+  return calculate_path_metric(p);
+}
 static rpl_parent_t *
 best_parent(rpl_parent_t *p1, rpl_parent_t *p2)
 {
@@ -0,0 +1,231 @@
+/**
+ * \addtogroup uip6
+ * @{
+ */
+/*
+ * Copyright (c) 2026, the smart-HOP contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+/**
+ * \file
+ *         RPL non-storing mode: the DODAG root's view of the network.
+ *
+ *         Every DAO received by the root records the parent of its
+ *         targets. Downward source routes are obtained by walking
+ *         these parent links from the destination up to the root;
+ *         the most recent paths are cached until the graph changes.
+ */
+
+#include "net/uip.h"
+#include "net/uip-ds6.h"
+#include "net/rpl/rpl-private.h"
+#include "lib/list.h"
+#include "lib/memb.h"
+
+#define DEBUG DEBUG_NONE
+#include "net/uip-debug.h"
+
+#include <string.h>
+
+#if UIP_CONF_IPV6 && RPL_WITH_NON_STORING
+
+struct rpl_ns_path {
+  rpl_ns_node_t *hops[RPL_NS_MAX_HOPS];
+  uint16_t version;
+  uint8_t len;
+};
+
+LIST(nodelist);
+MEMB(nodememb, rpl_ns_node_t, RPL_NS_LINK_NUM);
+
+static struct rpl_ns_path path_cache[RPL_NS_PATH_CACHE];
+static uint8_t path_cache_next;
+
+/* Bumped whenever a parent link changes; cached paths of an older
+   version are stale. */
+static uint16_t graph_version = 1;
+/*---------------------------------------------------------------------------*/
+static int
+is_root_addr(rpl_dag_t *dag, const uip_ipaddr_t *addr)
+{
+  return uip_ipaddr_cmp(&dag->dag_id, addr) ||
+    uip_ds6_is_my_addr((uip_ipaddr_t *)addr);
+}
+/*---------------------------------------------------------------------------*/
+rpl_ns_node_t *
+rpl_ns_node_lookup(rpl_dag_t *dag, const uip_ipaddr_t *addr)
+{
+  rpl_ns_node_t *n;
+
+  for(n = list_head(nodelist); n != NULL; n = list_item_next(n)) {
+    if(n->dag == dag && uip_ipaddr_cmp(&n->addr, addr)) {
+      return n;
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static void
+node_rm(rpl_ns_node_t *n)
+{
+  PRINTF("RPL: NS removing link ");
+  PRINT6ADDR(&n->addr);
+  PRINTF("\n");
+  list_remove(nodelist, n);
+  memb_free(&nodememb, n);
+  graph_version++;
+}
+/*---------------------------------------------------------------------------*/
+int
+rpl_ns_update_node(rpl_dag_t *dag, const uip_ipaddr_t *child,
+                   const uip_ipaddr_t *parent, uint32_t lifetime)
+{
+  rpl_ns_node_t *n;
+
+  n = rpl_ns_node_lookup(dag, child);
+
+  if(lifetime == 0) {
+    /* A No-Path DAO only removes the link it names. */
+    if(n != NULL && uip_ipaddr_cmp(&n->parent, parent)) {
+      node_rm(n);
+    }
+    return 0;
+  }
+
+  if(n == NULL) {
+    n = memb_alloc(&nodememb);
+    if(n == NULL) {
+      PRINTF("RPL: NS link table full\n");
+      return -1;
+    }
+    uip_ipaddr_copy(&n->addr, child);
+    n->dag = dag;
+    list_add(nodelist, n);
+    graph_version++;
+  } else if(!uip_ipaddr_cmp(&n->parent, parent)) {
+    graph_version++;
+  }
+
+  uip_ipaddr_copy(&n->parent, parent);
+  n->lifetime = lifetime;
+
+  PRINTF("RPL: NS link ");
+  PRINT6ADDR(child);
+  PRINTF(" -> ");
+  PRINT6ADDR(parent);
+  PRINTF(" lifetime %lu\n", (unsigned long)lifetime);
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+void
+rpl_ns_periodic(void)
+{
+  rpl_ns_node_t *n;
+  rpl_ns_node_t *next;
+
+  for(n = list_head(nodelist); n != NULL; n = next) {
+    next = list_item_next(n);
+    if(n->lifetime <= 1) {
+      node_rm(n);
+    } else {
+      n->lifetime--;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+rpl_ns_free_dag(rpl_dag_t *dag)
+{
+  rpl_ns_node_t *n;
+  rpl_ns_node_t *next;
+
+  for(n = list_head(nodelist); n != NULL; n = next) {
+    next = list_item_next(n);
+    if(n->dag == dag) {
+      node_rm(n);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+int
+rpl_ns_get_path(rpl_dag_t *dag, const uip_ipaddr_t *dest,
+                rpl_ns_node_t ***hops)
+{
+  struct rpl_ns_path *path;
+  rpl_ns_node_t *n;
+  int i;
+  int len;
+
+  for(i = 0; i < RPL_NS_PATH_CACHE; i++) {
+    path = &path_cache[i];
+    if(path->version == graph_version && path->len > 0 &&
+       path->hops[path->len - 1]->dag == dag &&
+       uip_ipaddr_cmp(&path->hops[path->len - 1]->addr, dest)) {
+      *hops = path->hops;
+      return path->len;
+    }
+  }
+
+  n = rpl_ns_node_lookup(dag, dest);
+  if(n == NULL) {
+    return -1;
+  }
+
+  /* Walk up to the root, filling the path from its end. */
+  path = &path_cache[path_cache_next];
+  path->len = 0;
+  len = 0;
+  while(n != NULL) {
+    if(len == RPL_NS_MAX_HOPS) {
+      PRINTF("RPL: NS path too long or looping\n");
+      return -1;
+    }
+    path->hops[RPL_NS_MAX_HOPS - 1 - len++] = n;
+    if(is_root_addr(dag, &n->parent)) {
+      break;
+    }
+    n = rpl_ns_node_lookup(dag, &n->parent);
+  }
+  if(n == NULL) {
+    PRINTF("RPL: NS path does not reach the root\n");
+    return -1;
+  }
+
+  memmove(&path->hops[0], &path->hops[RPL_NS_MAX_HOPS - len],
+          len * sizeof(path->hops[0]));
+  path->len = len;
+  path->version = graph_version;
+  path_cache_next = (path_cache_next + 1) % RPL_NS_PATH_CACHE;
+
+  *hops = path->hops;
+  return len;
+}
+/*---------------------------------------------------------------------------*/
+#endif /* UIP_CONF_IPV6 && RPL_WITH_NON_STORING */
+/** @} */
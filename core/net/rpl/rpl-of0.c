@@ -46,6 +46,7 @@
 
 static void reset(rpl_dag_t *);
 static rpl_parent_t *best_parent(rpl_parent_t *, rpl_parent_t *);
+static uint16_t parent_path_cost(rpl_parent_t *);
 static rpl_dag_t *best_dag(rpl_dag_t *, rpl_dag_t *);
 static rpl_rank_t calculate_rank(rpl_parent_t *, rpl_rank_t);
 static void update_metric_container(rpl_instance_t *);
@@ -54,6 +55,7 @@ rpl_of_t rpl_of0 = {
   reset,
   NULL,
   best_parent,
+  parent_path_cost,
   best_dag,
   calculate_rank,
   update_metric_container,
@@ -116,6 +118,12 @@ best_dag(rpl_dag_t *d1, rpl_dag_t *d2)
     return d1;
   }
 }
+static uint16_t
+parent_path_cost(rpl_parent_t *p)
+{
+  return DAG_RANK(p->rank, p->dag->instance) * RPL_MIN_HOPRANKINC +
+    p->link_metric;
+}
 static rpl_parent_t *
 best_parent(rpl_parent_t *p1, rpl_parent_t *p2)
 {
@@ -90,6 +90,11 @@
 
 #define RPL_DAO_K_FLAG                   0x80   /* DAO ACK requested */
 #define RPL_DAO_D_FLAG                   0x40   /* DODAG ID present */
+
+/* Target options handled in one incoming DAO. A full IPv6 prefix
+   takes 20 bytes, hence the bound given by the uIP buffer. */
+#define RPL_DAO_MAX_TARGETS \
+  ((UIP_BUFSIZE - UIP_LLH_LEN - UIP_IPICMPH_LEN) / 20)
 /*---------------------------------------------------------------------------*/
 /* RPL IPv6 extension header option. */
 #define RPL_HDR_OPT_LEN     4
@@ -178,6 +183,8 @@
 
 #ifdef  RPL_CONF_MOP
 #define RPL_MOP_DEFAULT                 RPL_CONF_MOP
+#elif RPL_WITH_NON_STORING
+#define RPL_MOP_DEFAULT                 RPL_MOP_NON_STORING
 #else
 #define RPL_MOP_DEFAULT                 RPL_MOP_STORING_NO_MULTICAST
 #endif
@@ -298,6 +305,7 @@ void dis_output(uip_ipaddr_t *addr, uint8_t flags, uint8_t counter, uint8_t rssi
 void dio_output(rpl_instance_t *, uip_ipaddr_t * uc_addr, uint8_t flags);
 void dao_output(rpl_parent_t *, uint8_t lifetime);
 void dao_output_target(rpl_parent_t *, uip_ipaddr_t *, uint8_t lifetime);
+int dao_output_targets(rpl_parent_t *, uip_ipaddr_t *, int count, uint8_t lifetime);
 void dao_ack_output(rpl_instance_t *, uip_ipaddr_t *, uint8_t);
 
 /* RPL logic functions. */
@@ -322,6 +330,7 @@ void rpl_nullify_parent(rpl_parent_t *);
 void rpl_remove_parent(rpl_parent_t *);
 void rpl_move_parent(rpl_dag_t * dag_src, rpl_dag_t * dag_dst,
                      rpl_parent_t * parent);
+void rpl_reorder_parent(rpl_parent_t *);
 rpl_parent_t *rpl_select_parent(rpl_dag_t * dag);
 rpl_dag_t *rpl_select_dag(rpl_instance_t * instance, rpl_parent_t * parent);
 void rpl_recalculate_ranks(void);
@@ -333,6 +342,23 @@ uip_ds6_route_t *rpl_add_route(rpl_dag_t * dag, uip_ipaddr_t * prefix,
                                int prefix_len, uip_ipaddr_t * next_hop);
 void rpl_purge_routes(void);
 
+/* Non-storing mode: child-to-parent links learned by the root. */
+typedef struct rpl_ns_node {
+  struct rpl_ns_node *next;
+  uip_ipaddr_t addr;
+  uip_ipaddr_t parent;
+  rpl_dag_t *dag;
+  uint32_t lifetime;
+} rpl_ns_node_t;
+
+rpl_ns_node_t *rpl_ns_node_lookup(rpl_dag_t *dag, const uip_ipaddr_t *addr);
+int rpl_ns_update_node(rpl_dag_t *dag, const uip_ipaddr_t *child,
+                       const uip_ipaddr_t *parent, uint32_t lifetime);
+int rpl_ns_get_path(rpl_dag_t *dag, const uip_ipaddr_t *dest,
+                    rpl_ns_node_t ***hops);
+void rpl_ns_periodic(void);
+void rpl_ns_free_dag(rpl_dag_t *dag);
+
 /* Lock a parent in the neighbor cache. */
 void rpl_lock_parent(rpl_parent_t * p);
 
@@ -98,53 +98,70 @@ rpl_set_mode(enum rpl_mode m)
   return oldmode;
 }
 /*---------------------------------------------------------------------------*/
+static void
+send_nopath(rpl_dag_t *dag, uip_ipaddr_t *targets, int count)
+{
+  int sent;
+
+  while(count > 0) {
+    sent = dao_output_targets(dag->preferred_parent, targets, count,
+                              RPL_ZERO_LIFETIME);
+    if(sent <= 0) {
+      break;
+    }
+    targets += sent;
+    count -= sent;
+  }
+}
+/*---------------------------------------------------------------------------*/
 void
 rpl_purge_routes(void)
 {
+  static uip_ipaddr_t expired[RPL_NOPATH_BATCH];
   uip_ds6_route_t *r;
-  uip_ipaddr_t prefix;
+  uip_ds6_route_t *next;
   rpl_dag_t *dag;
+  int nexpired;
 
-  /* First pass, decrement lifetime */
-  r = uip_ds6_route_head();
+  dag = default_instance != NULL ? default_instance->current_dag : NULL;
+  nexpired = 0;
 
-  while(r != NULL) {
+  /*
+   * Decrement the lifetimes and remove the dead routes in a single
+   * pass. A route at lifetime 1 is set to 0 and removed right away,
+   * which achieves the same as the original code that would delete
+   * lifetime <= 1.
+   */
+  for(r = uip_ds6_route_head(); r != NULL; r = next) {
+    next = uip_ds6_route_next(r);
     if(r->state.lifetime >= 1) {
-      /*
-       * If a route is at lifetime == 1, set it to 0, scheduling it for
-       * immediate removal below. This achieves the same as the original code,
-       * which would delete lifetime <= 1
-       */
       r->state.lifetime--;
     }
-    r = uip_ds6_route_next(r);
-  }
-
-  /* Second pass, remove dead routes */
-  r = uip_ds6_route_head();
-
-  while(r != NULL) {
     if(r->state.lifetime < 1) {
-      /* Routes with lifetime == 1 have only just been decremented from 2 to 1,
-       * thus we want to keep them. Hence < and not <= */
-      uip_ipaddr_copy(&prefix, &r->ipaddr);
-      uip_ds6_route_rm(r);
-      r = uip_ds6_route_head();
       PRINTF("No more routes to ");
-      PRINT6ADDR(&prefix);
-      dag = default_instance->current_dag;
+      PRINT6ADDR(&r->ipaddr);
+      PRINTF("\n");
       /* Propagate this information with a No-Path DAO to preferred parent if we are not a RPL Root */
-      if(dag->rank != ROOT_RANK(default_instance)) {
-        PRINTF(" -> generate No-Path DAO\n");
-        dao_output_target(dag->preferred_parent, &prefix, RPL_ZERO_LIFETIME);
-        /* Don't schedule more than 1 No-Path DAO, let next iteration handle that */
-        return;
+      if(dag != NULL && dag->rank != ROOT_RANK(default_instance)) {
+        uip_ipaddr_copy(&expired[nexpired], &r->ipaddr);
+        if(++nexpired == RPL_NOPATH_BATCH) {
+          PRINTF("RPL: generate No-Path DAO for %d targets\n", nexpired);
+          send_nopath(dag, expired, nexpired);
+          nexpired = 0;
+        }
       }
-      PRINTF("\n");
-    } else {
-      r = uip_ds6_route_next(r);
+      uip_ds6_route_rm(r);
     }
   }
+
+  if(nexpired > 0) {
+    PRINTF("RPL: generate No-Path DAO for %d targets\n", nexpired);
+    send_nopath(dag, expired, nexpired);
+  }
+
+#if RPL_WITH_NON_STORING
+  rpl_ns_periodic();
+#endif /* RPL_WITH_NON_STORING */
 }
 /*---------------------------------------------------------------------------*/
 void
@@ -152,6 +169,10 @@ rpl_remove_routes(rpl_dag_t *dag)
 {
   uip_ds6_route_t *r;
 
+#if RPL_WITH_NON_STORING
+  rpl_ns_free_dag(dag);
+#endif /* RPL_WITH_NON_STORING */
+
   r = uip_ds6_route_head();
 
   while(r != NULL) {
@@ -248,6 +269,7 @@ rpl_ipv6_neighbor_callback(uip_ds6_nbr_t *nbr)
       p = rpl_find_parent_any_dag(instance, &nbr->ipaddr);
       if(p != NULL) {
         p->rank = INFINITE_RANK;
+        rpl_reorder_parent(p);
         /* Trigger DAG rank recalculation. */
         PRINTF("RPL: rpl_ipv6_neighbor_callback infinite rank\n");
         p->updated = 1;
@@ -162,6 +162,11 @@ typedef struct rpl_instance rpl_instance_t;
  *
  *  Compares two parents and returns the best one, according to the OF.
  *
+ * parent_path_cost(parent)
+ *
+ *  Returns the cost of the path to the root through "parent". The
+ *  candidate parents are kept sorted by this value, lowest first.
+ *
  * best_dag(dag1, dag2)
  *
  *  Compares two DAGs and returns the best one, according to the OF.
@@ -183,6 +188,7 @@ struct rpl_of {
   void (*reset)(struct rpl_dag *);
   void (*neighbor_link_callback)(rpl_parent_t *, int, int);
   rpl_parent_t *(*best_parent)(rpl_parent_t *, rpl_parent_t *);
+  uint16_t (*parent_path_cost)(rpl_parent_t *);
   rpl_dag_t *(*best_dag)(rpl_dag_t *, rpl_dag_t *);
   rpl_rank_t (*calculate_rank)(rpl_parent_t *, rpl_rank_t);
   void (*update_metric_container)( rpl_instance_t *);
@@ -242,6 +248,10 @@ int rpl_verify_header(int);
 void rpl_insert_header(void);
 void rpl_remove_header(void);
 uint8_t rpl_invert_header(void);
+#if RPL_WITH_NON_STORING
+int rpl_srh_output(uip_ipaddr_t *nexthop);
+int rpl_srh_process(struct uip_routing_hdr *rh);
+#endif /* RPL_WITH_NON_STORING */
 uip_ipaddr_t *rpl_get_parent_ipaddr(rpl_parent_t *nbr);
 rpl_rank_t rpl_get_parent_rank(uip_lladdr_t *addr);
 uint16_t rpl_get_parent_link_metric(const uip_lladdr_t *addr);
@@ -63,6 +63,7 @@
 #include "net/tcpip.h"
 #include "net/uip.h"
 #include "net/uip-ds6.h"
+#include "net/uip-reass.h"
 #include "net/rime.h"
 #include "net/sicslowpan.h"
 #include "net/netstack.h"
@@ -104,6 +105,14 @@ void uip_log(char *msg);
 #define SICSLOWPAN_MAX_MAC_TRANSMISSIONS 4
 #endif
 
+/* When enabled, the payload of outbound packets is chained to the
+   packetbuf by reference instead of being copied from uip_buf. */
+#ifdef SICSLOWPAN_CONF_ZERO_COPY
+#define SICSLOWPAN_ZERO_COPY SICSLOWPAN_CONF_ZERO_COPY
+#else
+#define SICSLOWPAN_ZERO_COPY 1
+#endif
+
 #ifndef SICSLOWPAN_COMPRESSION
 #ifdef SICSLOWPAN_CONF_COMPRESSION
 #define SICSLOWPAN_COMPRESSION SICSLOWPAN_CONF_COMPRESSION
@@ -224,10 +233,17 @@ static uint16_t sicslowpan_len;
 /**
  * The buffer used for the 6lowpan reassembly.
  * This buffer contains only the IPv6 packet (no MAC header, 6lowpan, etc).
- * It has a fix size as we do not use dynamic memory allocation.
+ * It is taken from the reassembly pool shared with IPv6 (uip-reass.h)
+ * when the first fragment of a packet arrives, and returned when the
+ * packet is complete or reassembly is abandoned.
+ */
+static uint8_t *sicslowpan_reassbuf;
+
+/**
+ * The buffer the incoming packet is uncompressed into: the reassembly
+ * buffer for fragments, uip_buf for packets that are not fragmented.
  */
-static uip_buf_t sicslowpan_aligned_buf;
-#define sicslowpan_buf (sicslowpan_aligned_buf.u8)
+static uint8_t *sicslowpan_buf;
 
 /** The total length of the IPv6 packet in the sicslowpan_buf. */
 
@@ -249,6 +265,16 @@ rimeaddr_t frag_sender;
 /** Reassembly %process %timer. */
 static struct timer reass_timer;
 
+/*--------------------------------------------------------------------*/
+/** \brief Abandon or finish reassembly and return the buffer to the pool */
+static void
+reass_release(void)
+{
+  uip_reass_buf_free(sicslowpan_reassbuf, processed_ip_in_len);
+  sicslowpan_reassbuf = NULL;
+  sicslowpan_len = 0;
+  processed_ip_in_len = 0;
+}
 /** @} */
 #else /* SICSLOWPAN_CONF_FRAG */
 /** The buffer used for the 6lowpan processing is uip_buf.
@@ -1348,6 +1374,29 @@ send_packet(rimeaddr_t *dest)
   watchdog_periodic();
 }
 /*--------------------------------------------------------------------*/
+/**
+ * \brief Attach a part of the IP packet in uip_buf as the rime payload
+ * \param offset offset of the payload from the start of the IP header
+ * \param len length of the payload
+ *
+ * The rime header must already be in the packetbuf at rime_ptr. The
+ * payload is chained after it by reference when possible, so that it
+ * is copied once, when the MAC queues the packet, rather than first
+ * into the packetbuf and then again into a queuebuf.
+ */
+static void
+set_rime_payload(uint16_t offset, uint16_t len)
+{
+#if SICSLOWPAN_ZERO_COPY
+  packetbuf_set_datalen(rime_hdr_len);
+  if(packetbuf_reference_append((uint8_t *)UIP_IP_BUF + offset, len)) {
+    return;
+  }
+#endif /* SICSLOWPAN_ZERO_COPY */
+  memcpy(rime_ptr + rime_hdr_len, (uint8_t *)UIP_IP_BUF + offset, len);
+  packetbuf_set_datalen(rime_hdr_len + len);
+}
+/*--------------------------------------------------------------------*/
 /** \brief Take an IP packet and format it to be sent on an 802.15.4
  *  network using 6lowpan.
  *  \param localdest The MAC address of the destination
@@ -1453,7 +1502,12 @@ output(const uip_lladdr_t *localdest)
 
   if((int)uip_len - (int)uncomp_hdr_len > (int)MAC_MAX_PAYLOAD - framer_hdrlen - (int)rime_hdr_len) {
 #if SICSLOWPAN_CONF_FRAG
-    struct queuebuf *q;
+    /* The attributes of the first fragment are reused for the
+       following ones, whose header is rebuilt in the packetbuf after
+       each transmission. */
+    struct packetbuf_attr frag_attrs[PACKETBUF_NUM_ATTRS];
+    struct packetbuf_addr frag_addrs[PACKETBUF_NUM_ADDRS];
+    uint16_t frag_tag;
     /*
      * The outbound IPv6 packet is too large to fit into a single 15.4
      * packet, so we fragment it into multiple packets and send them.
@@ -1479,25 +1533,17 @@ output(const uip_lladdr_t *localdest)
     SET16(RIME_FRAG_PTR, RIME_FRAG_DISPATCH_SIZE,
           ((SICSLOWPAN_DISPATCH_FRAG1 << 8) | uip_len));
 /*     RIME_FRAG_BUF->tag = uip_htons(my_tag); */
-    SET16(RIME_FRAG_PTR, RIME_FRAG_TAG, my_tag);
+    frag_tag = my_tag;
+    SET16(RIME_FRAG_PTR, RIME_FRAG_TAG, frag_tag);
     my_tag++;
 
-    /* Copy payload and send */
+    /* Attach payload and send */
     rime_hdr_len += SICSLOWPAN_FRAG1_HDR_LEN;
     rime_payload_len = (MAC_MAX_PAYLOAD - framer_hdrlen - rime_hdr_len) & 0xfffffff8;
     PRINTFO("(len %d, tag %d)\n", rime_payload_len, my_tag);
-    memcpy(rime_ptr + rime_hdr_len,
-           (uint8_t *)UIP_IP_BUF + uncomp_hdr_len, rime_payload_len);
-    packetbuf_set_datalen(rime_payload_len + rime_hdr_len);
-    q = queuebuf_new_from_packetbuf();
-    if(q == NULL) {
-      PRINTFO("could not allocate queuebuf for first fragment, dropping packet\n");
-      return 0;
-    }
+    set_rime_payload(uncomp_hdr_len, rime_payload_len);
+    packetbuf_attr_copyto(frag_attrs, frag_addrs);
     send_packet(&dest);
-    queuebuf_to_packetbuf(q);
-    queuebuf_free(q);
-    q = NULL;
 
     /* Check tx result. */
     if((last_tx_status == MAC_TX_COLLISION) ||
@@ -1516,34 +1562,29 @@ output(const uip_lladdr_t *localdest)
      * FRAGN dispatch and for each fragment, the offset
      */
     rime_hdr_len = SICSLOWPAN_FRAGN_HDR_LEN;
-/*     RIME_FRAG_BUF->dispatch_size = */
-/*       uip_htons((SICSLOWPAN_DISPATCH_FRAGN << 8) | uip_len); */
-    SET16(RIME_FRAG_PTR, RIME_FRAG_DISPATCH_SIZE,
-          ((SICSLOWPAN_DISPATCH_FRAGN << 8) | uip_len));
     rime_payload_len = (MAC_MAX_PAYLOAD - framer_hdrlen - rime_hdr_len) & 0xfffffff8;
     while(processed_ip_out_len < uip_len) {
       PRINTFO("sicslowpan output: fragment ");
+      /* The MAC has consumed the previous fragment; rebuild the
+         packetbuf with its attributes and a FRAGN header. */
+      packetbuf_clear();
+      packetbuf_attr_copyfrom(frag_attrs, frag_addrs);
+/*       RIME_FRAG_BUF->dispatch_size = */
+/*         uip_htons((SICSLOWPAN_DISPATCH_FRAGN << 8) | uip_len); */
+      SET16(RIME_FRAG_PTR, RIME_FRAG_DISPATCH_SIZE,
+            ((SICSLOWPAN_DISPATCH_FRAGN << 8) | uip_len));
+      SET16(RIME_FRAG_PTR, RIME_FRAG_TAG, frag_tag);
       RIME_FRAG_PTR[RIME_FRAG_OFFSET] = processed_ip_out_len >> 3;
       
-      /* Copy payload and send */
+      /* Attach payload and send */
       if(uip_len - processed_ip_out_len < rime_payload_len) {
         /* last fragment */
         rime_payload_len = uip_len - processed_ip_out_len;
       }
       PRINTFO("(offset %d, len %d, tag %d)\n",
              processed_ip_out_len >> 3, rime_payload_len, my_tag);
-      memcpy(rime_ptr + rime_hdr_len,
-             (uint8_t *)UIP_IP_BUF + processed_ip_out_len, rime_payload_len);
-      packetbuf_set_datalen(rime_payload_len + rime_hdr_len);
-      q = queuebuf_new_from_packetbuf();
-      if(q == NULL) {
-        PRINTFO("could not allocate queuebuf, dropping fragment\n");
-        return 0;
-      }
+      set_rime_payload(processed_ip_out_len, rime_payload_len);
       send_packet(&dest);
-      queuebuf_to_packetbuf(q);
-      queuebuf_free(q);
-      q = NULL;
       processed_ip_out_len += rime_payload_len;
 
       /* Check tx result. */
@@ -1562,11 +1603,9 @@ output(const uip_lladdr_t *localdest)
 
     /*
      * The packet does not need to be fragmented
-     * copy "payload" and send
+     * attach "payload" and send
      */
-    memcpy(rime_ptr + rime_hdr_len, (uint8_t *)UIP_IP_BUF + uncomp_hdr_len,
-           uip_len - uncomp_hdr_len);
-    packetbuf_set_datalen(uip_len - uncomp_hdr_len + rime_hdr_len);
+    set_rime_payload(uncomp_hdr_len, uip_len - uncomp_hdr_len);
     send_packet(&dest);
   }
   return 1;
@@ -1612,8 +1651,7 @@ input(void)
 #if SICSLOWPAN_CONF_FRAG
   /* if reassembly timed out, cancel it */
   if(timer_expired(&reass_timer)) {
-    sicslowpan_len = 0;
-    processed_ip_in_len = 0;
+    reass_release();
   }
   /*
    * Since we don't support the mesh and broadcast header, the first header
@@ -1674,12 +1712,10 @@ input(void)
 
   if(!is_fragment) {
     /* Prioritize non-fragment packets too. */
-    sicslowpan_len = 0;
-    processed_ip_in_len = 0;
+    reass_release();
   } else if(processed_ip_in_len > 0 && first_fragment
       && !rimeaddr_cmp(&frag_sender, packetbuf_addr(PACKETBUF_ADDR_SENDER))) {
-    sicslowpan_len = 0;
-    processed_ip_in_len = 0;
+    reass_release();
   }
 #endif /* PRIORITIZE_NEW_PACKETS */
 
@@ -1710,6 +1746,15 @@ input(void)
         return;
       }
 
+      /* Reuse the buffer if the previous first fragment was dropped
+         before any of it was stored. */
+      if(sicslowpan_reassbuf == NULL) {
+        sicslowpan_reassbuf = uip_reass_buf_alloc();
+      }
+      if(sicslowpan_reassbuf == NULL) {
+        PRINTFI("sicslowpan input: no reassembly buffer\n");
+        return;
+      }
       sicslowpan_len = frag_size;
       reass_tag = frag_tag;
       timer_set(&reass_timer, SICSLOWPAN_REASS_MAXAGE * CLOCK_SECOND / 16);
@@ -1719,6 +1764,17 @@ input(void)
     }
   }
 
+  /* Fragments are collected in the reassembly buffer, other packets are
+     uncompressed directly into uip_buf. */
+  if(frag_size > 0) {
+    sicslowpan_buf = sicslowpan_reassbuf;
+    if(sicslowpan_buf == NULL) {
+      return;
+    }
+  } else {
+    sicslowpan_buf = uip_buf;
+  }
+
   if(rime_hdr_len == SICSLOWPAN_FRAGN_HDR_LEN) {
     /* this is a FRAGN, skip the header compression dispatch section */
     goto copypayload;
@@ -1754,6 +1810,9 @@ input(void)
       /* unknown header */
       PRINTFI("sicslowpan input: unknown dispatch: %u\n",
              RIME_HC1_PTR[RIME_HC1_DISPATCH]);
+#if SICSLOWPAN_CONF_FRAG
+      reass_release();
+#endif /* SICSLOWPAN_CONF_FRAG */
       return;
   }
    
@@ -1770,6 +1829,9 @@ input(void)
    */
   if(packetbuf_datalen() < rime_hdr_len) {
     PRINTF("SICSLOWPAN: packet dropped due to header > total packet\n");
+#if SICSLOWPAN_CONF_FRAG
+    reass_release();
+#endif /* SICSLOWPAN_CONF_FRAG */
     return;
   }
   rime_payload_len = packetbuf_datalen() - rime_hdr_len;
@@ -1778,11 +1840,14 @@ input(void)
   {
     int req_size = UIP_LLH_LEN + uncomp_hdr_len + (uint16_t)(frag_offset << 3)
         + rime_payload_len;
-    if(req_size > sizeof(sicslowpan_buf)) {
+    if(req_size > UIP_BUFSIZE) {
       PRINTF(
           "SICSLOWPAN: packet dropped, minimum required SICSLOWPAN_IP_BUF size: %d+%d+%d+%d=%d (current size: %d)\n",
           UIP_LLH_LEN, uncomp_hdr_len, (uint16_t)(frag_offset << 3),
-          rime_payload_len, req_size, sizeof(sicslowpan_buf));
+          rime_payload_len, req_size, UIP_BUFSIZE);
+#if SICSLOWPAN_CONF_FRAG
+      reass_release();
+#endif /* SICSLOWPAN_CONF_FRAG */
       return;
     }
   }
@@ -1793,6 +1858,7 @@ input(void)
 
 #if SICSLOWPAN_CONF_FRAG
   if(frag_size > 0) {
+    uint16_t prev_len = processed_ip_in_len;
     /* Add the size of the header only for the first fragment. */
     if(first_fragment != 0) {
       processed_ip_in_len += uncomp_hdr_len;
@@ -1804,6 +1870,7 @@ input(void)
     } else {
       processed_ip_in_len += rime_payload_len;
     }
+    uip_reass_buf_hold(processed_ip_in_len - prev_len);
     PRINTF("processed_ip_in_len %d, rime_payload_len %d\n", processed_ip_in_len, rime_payload_len);
 
   } else {
@@ -1821,10 +1888,11 @@ input(void)
   if(processed_ip_in_len == 0 || (processed_ip_in_len == sicslowpan_len)) {
     PRINTFI("sicslowpan input: IP packet ready (length %d)\n",
            sicslowpan_len);
-    memcpy((uint8_t *)UIP_IP_BUF, (uint8_t *)SICSLOWPAN_IP_BUF, sicslowpan_len);
+    if(sicslowpan_buf != uip_buf) {
+      memcpy((uint8_t *)UIP_IP_BUF, (uint8_t *)SICSLOWPAN_IP_BUF, sicslowpan_len);
+    }
     uip_len = sicslowpan_len;
-    sicslowpan_len = 0;
-    processed_ip_in_len = 0;
+    reass_release();
 #endif /* SICSLOWPAN_CONF_FRAG */
 
 #if DEBUG
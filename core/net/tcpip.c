@@ -255,6 +255,25 @@ void reset_packet_input(void)
 	rssi_sum = 0;
 }
 /*---------------------------------------------------------------------------*/
+#if UIP_TCP_SNDBUF_SIZE > 0
+/* uip_process() builds one segment at a time; send from the connection's
+   send buffer until its window is full. */
+static void
+tcp_output_window(struct uip_conn *conn)
+{
+  if(conn == NULL) {
+    return;
+  }
+  for(;;) {
+    uip_tcp_output_conn(conn);
+    if(uip_len == 0) {
+      break;
+    }
+    tcpip_ipv6_output();
+  }
+}
+#endif /* UIP_TCP_SNDBUF_SIZE > 0 */
+/*---------------------------------------------------------------------------*/
 static void
 packet_input(void)
 {
@@ -265,6 +284,7 @@ packet_input(void)
 	int rssi_temp;
 	uint8_t send_rssi;
 	rimeaddr_t packet_from_addr;
+	int8_t buf;
 
 	packet_from_addr = *packetbuf_addr(PACKETBUF_ADDR_SENDER);
 	instance = &instance_table[0];
@@ -285,7 +305,10 @@ packet_input(void)
       PRINTF("packet input count = %d\n", packet_input_count);
       if(rssi_sum <= -90) {
         send_rssi = rssi_sum + 255 + 46;
+        /* Keep the received packet; dis_output() builds in uip_buf. */
+        buf = uip_buf_push();
         dis_output(NULL, 1, 0, send_rssi, ip6id);
+        uip_buf_pop(buf);
       }
       rssi_sum = 0;
       packet_input_count = 0;
@@ -299,6 +322,9 @@ packet_input(void)
     if(uip_fw_forward() == UIP_FW_LOCAL) {
       tcpip_is_forwarding = 0;
       check_for_tcp_syn();
+#if UIP_TCP_SNDBUF_SIZE > 0
+      uip_conn = NULL;
+#endif /* UIP_TCP_SNDBUF_SIZE > 0 */
       uip_input();
       if(uip_len > 0) {
 #if UIP_CONF_TCP_SPLIT
@@ -312,12 +338,23 @@ packet_input(void)
 #endif
 #endif /* UIP_CONF_TCP_SPLIT */
       }
+#if UIP_TCP_SNDBUF_SIZE > 0
+      /* uip_input() only sets uip_conn for a segment that belongs to a
+         TCP connection; anything else leaves the send buffers to the
+         periodic and poll handling. */
+      if(uip_conn != NULL) {
+        tcp_output_window(uip_conn);
+      }
+#endif /* UIP_TCP_SNDBUF_SIZE > 0 */
     }
     tcpip_is_forwarding = 0;
   }
 #else /* UIP_CONF_IP_FORWARD */
   if(uip_len > 0) {
     check_for_tcp_syn();
+#if UIP_TCP_SNDBUF_SIZE > 0
+    uip_conn = NULL;
+#endif /* UIP_TCP_SNDBUF_SIZE > 0 */
     uip_input();
     if(uip_len > 0) {
 #if UIP_CONF_TCP_SPLIT
@@ -331,6 +368,12 @@ packet_input(void)
 #endif
 #endif /* UIP_CONF_TCP_SPLIT */
     }
+#if UIP_TCP_SNDBUF_SIZE > 0
+    /* See above. */
+    if(uip_conn != NULL) {
+      tcp_output_window(uip_conn);
+    }
+#endif /* UIP_TCP_SNDBUF_SIZE > 0 */
   }
 #endif /* UIP_CONF_IP_FORWARD */
 }
@@ -545,6 +588,9 @@ eventhandler(process_event_t ev, process_data_t data)
           uip_periodic(i);
 #if UIP_CONF_IPV6
           tcpip_ipv6_output();
+#if UIP_TCP_SNDBUF_SIZE > 0
+          tcp_output_window(&uip_conns[i]);
+#endif /* UIP_TCP_SNDBUF_SIZE > 0 */
 #else
           if(uip_len > 0) {
             PRINTF("tcpip_output from periodic len %d\n", uip_len);
@@ -603,6 +649,9 @@ eventhandler(process_event_t ev, process_data_t data)
       uip_poll_conn(data);
 #if UIP_CONF_IPV6
       tcpip_ipv6_output();
+#if UIP_TCP_SNDBUF_SIZE > 0
+      tcp_output_window(data);
+#endif /* UIP_TCP_SNDBUF_SIZE > 0 */
 #else /* UIP_CONF_IPV6 */
       if(uip_len > 0) {
         PRINTF("tcpip_output from tcp poll len %d\n", uip_len);
@@ -663,6 +712,10 @@ tcpip_ipv6_output(void)
 {
   uip_ds6_nbr_t *nbr = NULL;
   uip_ipaddr_t *nexthop;
+#if UIP_CONF_IPV6_RPL && RPL_WITH_NON_STORING
+  static uip_ipaddr_t srh_nexthop;
+  int srh;
+#endif /* UIP_CONF_IPV6_RPL && RPL_WITH_NON_STORING */
 
   if(uip_len == 0) {
     return;
@@ -687,6 +740,16 @@ tcpip_ipv6_output(void)
     /* We first check if the destination address is on our immediate
        link. If so, we simply use the destination address as our
        nexthop address. */
+#if UIP_CONF_IPV6_RPL && RPL_WITH_NON_STORING
+    srh = rpl_srh_output(&srh_nexthop);
+    if(srh < 0) {
+      uip_len = 0;
+      return;
+    }
+    if(srh > 0) {
+      nexthop = &srh_nexthop;
+    } else
+#endif /* UIP_CONF_IPV6_RPL && RPL_WITH_NON_STORING */
     if(uip_ds6_is_addr_onlink(&UIP_IP_BUF->destipaddr)) {
       nexthop = &UIP_IP_BUF->destipaddr;
     } else {
@@ -797,6 +860,7 @@ tcpip_ipv6_output(void)
 
         stimer_set(&nbr->sendns, uip_ds6_if.retrans_timer / 1000);
         nbr->nscount = 1;
+        uip_ds6_schedule_stimer(&nbr->sendns);
       }
 #endif /* UIP_ND6_SEND_NA */
     } else {
@@ -820,6 +884,7 @@ tcpip_ipv6_output(void)
         nbr->state = NBR_DELAY;
         stimer_set(&nbr->reachable, UIP_ND6_DELAY_FIRST_PROBE_TIME);
         nbr->nscount = 0;
+        uip_ds6_schedule_stimer(&nbr->reachable);
         PRINTF("tcpip_ipv6_output: nbr cache entry stale moving to delay\n");
       }
 #endif /* UIP_ND6_SEND_NA */
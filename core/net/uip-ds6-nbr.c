@@ -209,6 +209,7 @@ uip_ds6_link_neighbor_callback(int status, int numtx)
          nbr->state == NBR_PROBE)) {
       nbr->state = NBR_REACHABLE;
       stimer_set(&nbr->reachable, UIP_ND6_REACHABLE_TIME / 1000);
+      uip_ds6_schedule_stimer(&nbr->reachable);
       PRINTF("uip-ds6-neighbor : received a link layer ACK : ");
       PRINTLLADDR((uip_lladdr_t *)dest);
       PRINTF(" is reachable.\n");
@@ -223,6 +224,9 @@ uip_ds6_neighbor_periodic(void)
 {
   /* Periodic processing on neighbors */
   uip_ds6_nbr_t *nbr = nbr_table_head(ds6_neighbors);
+#if UIP_ND6_SEND_NA
+  int8_t buf;
+#endif /* UIP_ND6_SEND_NA */
   while(nbr != NULL) {
     switch(nbr->state) {
     case NBR_REACHABLE:
@@ -231,18 +235,24 @@ uip_ds6_neighbor_periodic(void)
         PRINT6ADDR(&nbr->ipaddr);
         PRINTF(")\n");
         nbr->state = NBR_STALE;
+      } else {
+        uip_ds6_schedule_stimer(&nbr->reachable);
       }
       break;
 #if UIP_ND6_SEND_NA
     case NBR_INCOMPLETE:
       if(nbr->nscount >= UIP_ND6_MAX_MULTICAST_SOLICIT) {
         uip_ds6_nbr_rm(nbr);
-      } else if(stimer_expired(&nbr->sendns) && (uip_len == 0)) {
+        break;
+      } else if(stimer_expired(&nbr->sendns) &&
+                (buf = uip_ds6_control_buf_begin()) != UIP_DS6_CONTROL_BUF_NONE) {
         nbr->nscount++;
         PRINTF("NBR_INCOMPLETE: NS %u\n", nbr->nscount);
         uip_nd6_ns_output(NULL, NULL, &nbr->ipaddr);
+        uip_ds6_control_buf_end(buf);
         stimer_set(&nbr->sendns, uip_ds6_if.retrans_timer / 1000);
       }
+      uip_ds6_schedule_stimer(&nbr->sendns);
       break;
     case NBR_DELAY:
       if(stimer_expired(&nbr->reachable)) {
@@ -250,6 +260,9 @@ uip_ds6_neighbor_periodic(void)
         nbr->nscount = 0;
         PRINTF("DELAY: moving to PROBE\n");
         stimer_set(&nbr->sendns, 0);
+        uip_ds6_schedule_stimer(&nbr->sendns);
+      } else {
+        uip_ds6_schedule_stimer(&nbr->reachable);
       }
       break;
     case NBR_PROBE:
@@ -262,12 +275,16 @@ uip_ds6_neighbor_periodic(void)
           }
         }
         uip_ds6_nbr_rm(nbr);
-      } else if(stimer_expired(&nbr->sendns) && (uip_len == 0)) {
+        break;
+      } else if(stimer_expired(&nbr->sendns) &&
+                (buf = uip_ds6_control_buf_begin()) != UIP_DS6_CONTROL_BUF_NONE) {
         nbr->nscount++;
         PRINTF("PROBE: NS %u\n", nbr->nscount);
         uip_nd6_ns_output(NULL, &nbr->ipaddr, &nbr->ipaddr);
+        uip_ds6_control_buf_end(buf);
         stimer_set(&nbr->sendns, uip_ds6_if.retrans_timer / 1000);
       }
+      uip_ds6_schedule_stimer(&nbr->sendns);
       break;
 #endif /* UIP_ND6_SEND_NA */
     default:
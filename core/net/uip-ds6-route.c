@@ -513,6 +513,7 @@ uip_ds6_defrt_add(uip_ipaddr_t *ipaddr, unsigned long interval)
   if(interval != 0) {
     stimer_set(&d->lifetime, interval);
     d->isinfinite = 0;
+    uip_ds6_schedule_stimer(&d->lifetime);
   } else {
     d->isinfinite = 1;
   }
@@ -617,6 +618,9 @@ uip_ds6_defrt_periodic(void)
       uip_ds6_defrt_rm(d);
       d = list_head(defaultrouterlist);
     } else {
+      if(!d->isinfinite) {
+        uip_ds6_schedule_stimer(&d->lifetime);
+      }
       d = list_item_next(d);
     }
   }
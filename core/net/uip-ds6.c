@@ -47,6 +47,7 @@
 #include "net/uip-nd6.h"
 #include "net/uip-ds6.h"
 #include "net/uip-packetqueue.h"
+#include "net/tcpip.h"
 
 #if UIP_CONF_IPV6
 
@@ -86,6 +87,10 @@ static uip_ds6_maddr_t *locmaddr;
 static uip_ds6_aaddr_t *locaaddr;
 static uip_ds6_prefix_t *locprefix;
 
+/* Earliest deadline collected while uip_ds6_periodic() is running */
+static clock_time_t next_period;
+static uint8_t in_periodic;
+
 /*---------------------------------------------------------------------------*/
 void
 uip_ds6_init(void)
@@ -140,10 +145,92 @@ uip_ds6_init(void)
 }
 
 
+/*---------------------------------------------------------------------------*/
+int8_t
+uip_ds6_control_buf_begin(void)
+{
+  int8_t previous;
+
+  if(uip_len == 0) {
+    return -1;
+  }
+  previous = uip_buf_push();
+  return previous < 0 ? UIP_DS6_CONTROL_BUF_NONE : previous;
+}
+/*---------------------------------------------------------------------------*/
+void
+uip_ds6_control_buf_end(int8_t previous)
+{
+  if(previous >= 0) {
+    tcpip_ipv6_output();
+    uip_buf_pop(previous);
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+uip_ds6_schedule(clock_time_t interval)
+{
+  clock_time_t left;
+
+  if(interval < UIP_DS6_PERIOD) {
+    interval = UIP_DS6_PERIOD;
+  } else if(interval > UIP_DS6_MAX_PERIOD) {
+    interval = UIP_DS6_MAX_PERIOD;
+  }
+  if(in_periodic) {
+    /* uip_ds6_periodic() arms the timer once it has seen every entry */
+    if(interval < next_period) {
+      next_period = interval;
+    }
+    return;
+  }
+  if(etimer_expired(&uip_ds6_timer_periodic)) {
+    /* A pass is already pending, it will pick the new deadline up */
+    return;
+  }
+  left = etimer_expiration_time(&uip_ds6_timer_periodic) - clock_time();
+  if(left <= interval || left > UIP_DS6_MAX_PERIOD) {
+    return;
+  }
+  PROCESS_CONTEXT_BEGIN(&tcpip_process);
+  etimer_set(&uip_ds6_timer_periodic, interval);
+  PROCESS_CONTEXT_END(&tcpip_process);
+}
+/*---------------------------------------------------------------------------*/
+void
+uip_ds6_schedule_timer(struct timer *t)
+{
+  uip_ds6_schedule(timer_expired(t) ? 0 : timer_remaining(t));
+}
+/*---------------------------------------------------------------------------*/
+void
+uip_ds6_schedule_stimer(struct stimer *t)
+{
+  unsigned long left;
+
+  left = stimer_expired(t) ? 0 : stimer_remaining(t);
+  if(left > UIP_DS6_MAX_PERIOD / CLOCK_SECOND) {
+    uip_ds6_schedule(UIP_DS6_MAX_PERIOD);
+  } else {
+    uip_ds6_schedule(left * CLOCK_SECOND);
+  }
+}
 /*---------------------------------------------------------------------------*/
 void
 uip_ds6_periodic(void)
 {
+#if UIP_ND6_DEF_MAXDADNS > 0 || (UIP_CONF_ROUTER & UIP_ND6_SEND_RA)
+  int8_t buf;
+#endif
+
+  /*
+   * Every entry reports its next deadline through uip_ds6_schedule(),
+   * the timer is then armed for the earliest one instead of a fixed
+   * period. Work that could not get a buffer is retried after
+   * UIP_DS6_PERIOD.
+   */
+  in_periodic = 1;
+  next_period = UIP_DS6_MAX_PERIOD;
 
   /* Periodic processing on unicast addresses */
   for(locaddr = uip_ds6_if.addr_list;
@@ -151,14 +238,24 @@ uip_ds6_periodic(void)
     if(locaddr->isused) {
       if((!locaddr->isinfinite) && (stimer_expired(&locaddr->vlifetime))) {
         uip_ds6_addr_rm(locaddr);
+        continue;
+      }
+      if(!locaddr->isinfinite) {
+        uip_ds6_schedule_stimer(&locaddr->vlifetime);
+      }
 #if UIP_ND6_DEF_MAXDADNS > 0
-      } else if((locaddr->state == ADDR_TENTATIVE)
-                && (locaddr->dadnscount <= uip_ds6_if.maxdadns)
-                && (timer_expired(&locaddr->dadtimer))
-                && (uip_len == 0)) {
-        uip_ds6_dad(locaddr);
-#endif /* UIP_ND6_DEF_MAXDADNS > 0 */
+      if((locaddr->state == ADDR_TENTATIVE)
+         && (locaddr->dadnscount <= uip_ds6_if.maxdadns)) {
+        if((timer_expired(&locaddr->dadtimer))
+           && ((buf = uip_ds6_control_buf_begin()) != UIP_DS6_CONTROL_BUF_NONE)) {
+          uip_ds6_dad(locaddr);
+          uip_ds6_control_buf_end(buf);
+        }
+        if(locaddr->state == ADDR_TENTATIVE) {
+          uip_ds6_schedule_timer(&locaddr->dadtimer);
+        }
       }
+#endif /* UIP_ND6_DEF_MAXDADNS > 0 */
     }
   }
 
@@ -177,9 +274,12 @@ uip_ds6_periodic(void)
   for(locprefix = uip_ds6_prefix_list;
       locprefix < uip_ds6_prefix_list + UIP_DS6_PREFIX_NB;
       locprefix++) {
-    if(locprefix->isused && !locprefix->isinfinite
-       && stimer_expired(&(locprefix->vlifetime))) {
-      uip_ds6_prefix_rm(locprefix);
+    if(locprefix->isused && !locprefix->isinfinite) {
+      if(stimer_expired(&(locprefix->vlifetime))) {
+        uip_ds6_prefix_rm(locprefix);
+      } else {
+        uip_ds6_schedule_stimer(&locprefix->vlifetime);
+      }
     }
   }
 #endif /* !UIP_CONF_ROUTER */
@@ -188,11 +288,16 @@ uip_ds6_periodic(void)
 
 #if UIP_CONF_ROUTER & UIP_ND6_SEND_RA
   /* Periodic RA sending */
-  if(stimer_expired(&uip_ds6_timer_ra) && (uip_len == 0)) {
+  if(stimer_expired(&uip_ds6_timer_ra)
+     && ((buf = uip_ds6_control_buf_begin()) != UIP_DS6_CONTROL_BUF_NONE)) {
     uip_ds6_send_ra_periodic();
+    uip_ds6_control_buf_end(buf);
   }
+  uip_ds6_schedule_stimer(&uip_ds6_timer_ra);
 #endif /* UIP_CONF_ROUTER & UIP_ND6_SEND_RA */
-  etimer_reset(&uip_ds6_timer_periodic);
+
+  in_periodic = 0;
+  etimer_set(&uip_ds6_timer_periodic, next_period);
   return;
 }
 
@@ -269,6 +374,7 @@ uip_ds6_prefix_add(uip_ipaddr_t *ipaddr, uint8_t ipaddrlen,
     if(interval != 0) {
       stimer_set(&(locprefix->vlifetime), interval);
       locprefix->isinfinite = 0;
+      uip_ds6_schedule_stimer(&locprefix->vlifetime);
     } else {
       locprefix->isinfinite = 1;
     }
@@ -332,6 +438,7 @@ uip_ds6_addr_add(uip_ipaddr_t *ipaddr, unsigned long vlifetime, uint8_t type)
     } else {
       locaddr->isinfinite = 0;
       stimer_set(&(locaddr->vlifetime), vlifetime);
+      uip_ds6_schedule_stimer(&locaddr->vlifetime);
     }
 #if UIP_ND6_DEF_MAXDADNS > 0
     locaddr->state = ADDR_TENTATIVE;
@@ -339,6 +446,7 @@ uip_ds6_addr_add(uip_ipaddr_t *ipaddr, unsigned long vlifetime, uint8_t type)
               random_rand() % (UIP_ND6_MAX_RTR_SOLICITATION_DELAY *
                                CLOCK_SECOND));
     locaddr->dadnscount = 0;
+    uip_ds6_schedule_timer(&locaddr->dadtimer);
 #else /* UIP_ND6_DEF_MAXDADNS > 0 */
     locaddr->state = ADDR_PREFERRED;
 #endif /* UIP_ND6_DEF_MAXDADNS > 0 */
@@ -635,6 +743,7 @@ uip_ds6_send_ra_sollicited(void)
                  stimer_elapsed(&uip_ds6_timer_ra));
   */ } else {
       stimer_set(&uip_ds6_timer_ra, rand_time);
+      uip_ds6_schedule_stimer(&uip_ds6_timer_ra);
     }
   }
 }
@@ -131,7 +131,12 @@
 #define  ADDR_MANUAL 3
 
 /** \brief General DS6 definitions */
-#define UIP_DS6_PERIOD   (CLOCK_SECOND/10)  /** Period for uip-ds6 periodic task*/
+#define UIP_DS6_PERIOD   (CLOCK_SECOND/10)  /** Shortest delay between two uip-ds6 periodic passes */
+#ifndef UIP_CONF_DS6_MAX_PERIOD
+#define UIP_DS6_MAX_PERIOD (60 * CLOCK_SECOND) /** Longest delay between two uip-ds6 periodic passes */
+#else
+#define UIP_DS6_MAX_PERIOD UIP_CONF_DS6_MAX_PERIOD
+#endif
 #define FOUND 0
 #define FREESPACE 1
 #define NOSPACE 2
@@ -240,6 +245,25 @@ void uip_ds6_init(void);
 /** \brief Periodic processing of data structures */
 void uip_ds6_periodic(void);
 
+/** \brief Make sure uip_ds6_periodic() runs within interval. To be
+ *  called whenever a DS6 timer is (re)started, the periodic task only
+ *  wakes up at the earliest deadline it knows of. */
+void uip_ds6_schedule(clock_time_t interval);
+
+/** \brief Schedule the periodic task for the expiry of a DS6 timer */
+void uip_ds6_schedule_timer(struct timer *t);
+void uip_ds6_schedule_stimer(struct stimer *t);
+
+/** \brief Pick a buffer for a periodic ND message. Returns -1 if the
+ *  message goes into the empty active buffer (to be sent by the caller),
+ *  the handle to restore if a spare buffer was activated, or
+ *  UIP_DS6_CONTROL_BUF_NONE if the message has to wait. */
+#define UIP_DS6_CONTROL_BUF_NONE -2
+int8_t uip_ds6_control_buf_begin(void);
+
+/** \brief Send the message built in a spare buffer and release it */
+void uip_ds6_control_buf_end(int8_t previous);
+
 /** \brief Generic loop routine on an abstract data structure, which generalizes
  * all data structures used in DS6 */
 uint8_t uip_ds6_list_loop(uip_ds6_element_t *list, uint8_t size,
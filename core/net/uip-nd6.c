@@ -484,6 +484,7 @@ uip_nd6_na_input(void)
 
         /* reachable time is stored in ms */
         stimer_set(&(nbr->reachable), uip_ds6_if.reachable_time / 1000);
+        uip_ds6_schedule_stimer(&nbr->reachable);
 
       } else {
         nbr->state = NBR_STALE;
@@ -506,6 +507,7 @@ uip_nd6_na_input(void)
             nbr->state = NBR_REACHABLE;
             /* reachable time is stored in ms */
             stimer_set(&(nbr->reachable), uip_ds6_if.reachable_time / 1000);
+            uip_ds6_schedule_stimer(&nbr->reachable);
           } else {
             if(nd6_opt_llao != 0 && is_llchange) {
               nbr->state = NBR_STALE;
@@ -872,6 +874,7 @@ uip_nd6_ra_input(void)
               stimer_set(&prefix->vlifetime,
                          uip_ntohl(nd6_opt_prefix_info->validlt));
               prefix->isinfinite = 0;
+              uip_ds6_schedule_stimer(&prefix->vlifetime);
               break;
             }
           }
@@ -904,6 +907,7 @@ uip_nd6_ra_input(void)
                 PRINTF("new value %lu\n", (unsigned long)(2 * 60 * 60));
               }
               addr->isinfinite = 0;
+              uip_ds6_schedule_stimer(&addr->vlifetime);
             } else {
               addr->isinfinite = 1;
             }
@@ -939,6 +943,7 @@ uip_nd6_ra_input(void)
     } else {
       stimer_set(&(defrt->lifetime),
                  (unsigned long)(uip_ntohs(UIP_ND6_RA_BUF->router_lifetime)));
+      uip_ds6_schedule_stimer(&defrt->lifetime);
     }
   } else {
     if(defrt != NULL) {
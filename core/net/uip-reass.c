@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2026, the smart-HOP contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         Pool of buffers shared by IPv6 and 6LoWPAN fragment reassembly
+ */
+
+#include "net/uip-reass.h"
+#include "lib/memb.h"
+
+#if UIP_REASS_BUFFERS > 0
+
+MEMB(reass_bufs, uip_buf_t, UIP_REASS_BUFFERS);
+
+struct uip_reass_stats uip_reass_stats;
+
+/*---------------------------------------------------------------------------*/
+uint8_t *
+uip_reass_buf_alloc(void)
+{
+  uip_buf_t *b;
+
+  b = memb_alloc(&reass_bufs);
+  if(b == NULL) {
+    uip_reass_stats.failed++;
+    return NULL;
+  }
+  if(++uip_reass_stats.used > uip_reass_stats.max_used) {
+    uip_reass_stats.max_used = uip_reass_stats.used;
+  }
+  return b->u8;
+}
+/*---------------------------------------------------------------------------*/
+void
+uip_reass_buf_free(uint8_t *buf, uint16_t held)
+{
+  if(buf == NULL) {
+    return;
+  }
+  if(memb_free(&reass_bufs, buf) == 0) {
+    uip_reass_stats.used--;
+    uip_reass_stats.held -= held < uip_reass_stats.held ?
+      held : uip_reass_stats.held;
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+uip_reass_buf_hold(uint16_t len)
+{
+  uip_reass_stats.held += len;
+  if(uip_reass_stats.held > uip_reass_stats.max_held) {
+    uip_reass_stats.max_held = uip_reass_stats.held;
+  }
+}
+/*---------------------------------------------------------------------------*/
+#endif /* UIP_REASS_BUFFERS > 0 */
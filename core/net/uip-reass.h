@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2026, the smart-HOP contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         Pool of buffers shared by IPv6 and 6LoWPAN fragment reassembly
+ *
+ *         uip6.c keeps one buffer per IPv6 datagram being reassembled
+ *         and sicslowpan.c one per 6LoWPAN datagram. Taking both from
+ *         one pool lets the buffers go where the fragments are, and
+ *         keeps account of how much memory reassembly holds.
+ */
+
+#ifndef UIP_REASS_H_
+#define UIP_REASS_H_
+
+#include "net/uip.h"
+
+/**
+ * The number of buffers in the pool. By default there is one for each
+ * IPv6 reassembly context and one for 6LoWPAN reassembly.
+ */
+#ifdef UIP_CONF_REASS_BUFFERS
+#define UIP_REASS_BUFFERS UIP_CONF_REASS_BUFFERS
+#else /* UIP_CONF_REASS_BUFFERS */
+#define UIP_REASS_BUFFERS ((UIP_CONF_IPV6_REASSEMBLY ? UIP_REASS_CONTEXTS : 0) + \
+                           (SICSLOWPAN_CONF_FRAG ? 1 : 0))
+#endif /* UIP_CONF_REASS_BUFFERS */
+
+/** Memory accounting for the reassembly pool. */
+struct uip_reass_stats {
+  uint8_t used;       /**< Buffers currently allocated. */
+  uint8_t max_used;   /**< Most buffers allocated at the same time. */
+  uint16_t held;      /**< Fragment bytes currently held in the buffers. */
+  uint16_t max_held;  /**< Most fragment bytes held at the same time. */
+  uint16_t failed;    /**< Allocations that found the pool empty. */
+};
+
+extern struct uip_reass_stats uip_reass_stats;
+
+/**
+ * \brief      Allocate a reassembly buffer
+ * \return     A buffer of UIP_BUFSIZE bytes, or NULL if the pool is empty
+ */
+uint8_t *uip_reass_buf_alloc(void);
+
+/**
+ * \brief      Return a reassembly buffer to the pool
+ * \param buf  The buffer
+ * \param held The number of fragment bytes accounted to the buffer
+ *             with uip_reass_buf_hold()
+ */
+void uip_reass_buf_free(uint8_t *buf, uint16_t held);
+
+/**
+ * \brief      Account fragment bytes copied into a reassembly buffer
+ * \param len  The number of bytes
+ */
+void uip_reass_buf_hold(uint16_t len);
+
+#endif /* UIP_REASS_H_ */
@@ -426,6 +426,23 @@ void uip_setipid(uint16_t id);
 #define uip_poll_conn(conn) do { uip_conn = conn;       \
     uip_process(UIP_POLL_REQUEST); } while (0)
 
+#if UIP_TCP_SNDBUF_SIZE > 0
+/**
+ * Send the next segment from the send buffer of a connection.
+ *
+ * uip_process() builds at most one segment at a time in uip_buf. The
+ * device driver should call this after sending the packet produced
+ * by uip_input(), uip_periodic_conn() or uip_poll_conn(), and keep
+ * calling it, sending the packet each time, until uip_len is zero.
+ *
+ * \param conn A pointer to the uip_conn struct for the connection.
+ *
+ * \hideinitializer
+ */
+#define uip_tcp_output_conn(conn) do { uip_conn = conn; \
+    uip_process(UIP_TCP_OUTPUT); } while (0)
+#endif /* UIP_TCP_SNDBUF_SIZE > 0 */
+
 #endif /* UIP_TCP */
 
 #if UIP_UDP
@@ -517,7 +534,51 @@ typedef union {
 } uip_buf_t;
 
 CCIF extern uip_buf_t uip_aligned_buf;
+#if UIP_CONF_IPV6 && UIP_BUF_POOL_SIZE > 1
+CCIF extern uip_buf_t *uip_bufp;
+#define uip_buf (uip_bufp->u8)
+#else
 #define uip_buf (uip_aligned_buf.u8)
+#endif
+
+/**
+ * \name Packet buffer pool (IPv6)
+ *
+ * With UIP_CONF_BUF_POOL_SIZE > 1, uip_buf, uip_len, uip_ext_len and
+ * uip_appdata refer to the active buffer of a small pool. Buffer 0
+ * (uip_aligned_buf) receives incoming packets; code that has to send
+ * while the active buffer holds a packet switches to a spare one:
+ *
+ \code
+ int8_t prev = uip_buf_push();
+ if(prev >= 0) {
+   ... build and send the message ...
+   uip_buf_pop(prev);
+ }
+ \endcode
+ *
+ * With a single buffer, uip_buf_push() always fails.
+ * @{
+ */
+#if UIP_CONF_IPV6 && UIP_BUF_POOL_SIZE > 1
+/* Allocate a spare buffer; returns its handle, or -1. */
+int8_t uip_buf_alloc(void);
+/* Release a buffer that is not active. */
+void uip_buf_free(int8_t handle);
+/* Activate a buffer; returns the handle of the previously active one. */
+int8_t uip_buf_switch(int8_t handle);
+/* The handle of the active buffer. */
+int8_t uip_buf_current(void);
+/* Allocate and activate a spare buffer; returns the previous handle, or -1. */
+int8_t uip_buf_push(void);
+/* Release the active buffer and reactivate the one returned by uip_buf_push(). */
+void uip_buf_pop(int8_t previous);
+#else
+#define uip_buf_current()  0
+#define uip_buf_push()     (-1)
+#define uip_buf_pop(previous)
+#endif
+/** @} */
 
 
 /** @} */
@@ -1321,6 +1382,36 @@ extern uint16_t uip_urglen, uip_surglen;
 #endif /* UIP_URGDATA > 0 */
 
 
+#if UIP_TCP_SNDBUF_SIZE > 0
+/**
+ * \internal
+ *
+ * The send buffer of a TCP connection.
+ *
+ * The buffer holds the data from snd_nxt (the oldest unacknowledged
+ * byte) onwards. The first uip_conn->len bytes are in flight, the
+ * rest has not been sent yet.
+ */
+struct uip_tcp_sndbuf {
+  uint16_t len;          /**< Number of bytes in the buffer. */
+  uint16_t wnd;          /**< The window last advertised by the peer. */
+  uint16_t cwnd;         /**< Congestion window. */
+  uint16_t ssthresh;     /**< Slow start threshold. */
+  uint8_t recover[4];    /**< Highest sequence number sent when fast
+                            recovery started. */
+  uint8_t dupacks;       /**< Consecutive duplicate ACKs. */
+  uint8_t flags;         /**< UIP_TCP_SNDBUF_* flags. */
+  uint8_t data[UIP_TCP_SNDBUF_SIZE];
+};
+
+#define UIP_TCP_SNDBUF_APPWAIT  0x01 /* The application has sent data
+                                        and waits for uip_acked(). */
+#define UIP_TCP_SNDBUF_RECOVERY 0x02 /* In fast recovery. */
+#define UIP_TCP_SNDBUF_REXMIT   0x04 /* Retransmit the first segment. */
+#define UIP_TCP_SNDBUF_CLOSE    0x08 /* Send a FIN once the buffer has
+                                        been acknowledged. */
+#endif /* UIP_TCP_SNDBUF_SIZE > 0 */
+
 /**
  * Representation of a uIP TCP connection.
  *
@@ -1357,6 +1448,10 @@ struct uip_conn {
   uint8_t nrtx;          /**< The number of retransmissions for the last
 			 segment sent. */
 
+#if UIP_TCP_SNDBUF_SIZE > 0
+  struct uip_tcp_sndbuf sndbuf; /**< Unacknowledged and unsent data. */
+#endif /* UIP_TCP_SNDBUF_SIZE > 0 */
+
   /** The application state. */
   uip_tcp_appstate_t appstate;
 };
@@ -1591,6 +1686,10 @@ void uip_process(uint8_t flag);
 #if UIP_UDP
 #define UIP_UDP_TIMER     5
 #endif /* UIP_UDP */
+#if UIP_TCP_SNDBUF_SIZE > 0
+#define UIP_TCP_OUTPUT    6     /* Tells uIP to send the next segment
+				   from a connection's send buffer. */
+#endif /* UIP_TCP_SNDBUF_SIZE > 0 */
 
 /* The TCP states used in the uip_conn->tcpstateflags. */
 #define UIP_CLOSED      0
@@ -2191,6 +2290,21 @@ uint16_t uip_udpchksum(void);
  */
 uint16_t uip_icmp6chksum(void);
 
+/**
+ * Update a checksum after a 16-bit word it covers has changed.
+ *
+ * Spares recomputing the checksum over the whole packet when only a
+ * header field is rewritten. All three values must be in the same
+ * byte order.
+ *
+ * \param chksum The checksum field before the change.
+ * \param old_word The word before the change.
+ * \param new_word The word after the change.
+ * \return The new value of the checksum field (RFC 1624).
+ */
+uint16_t uip_chksum_update(uint16_t chksum, uint16_t old_word,
+                           uint16_t new_word);
+
 
 #endif /* UIP_H_ */
 
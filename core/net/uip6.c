@@ -75,6 +75,7 @@
 #include "net/uip-icmp6.h"
 #include "net/uip-nd6.h"
 #include "net/uip-ds6.h"
+#include "net/uip-reass.h"
 
 #include <string.h>
 
@@ -143,7 +144,7 @@ uint8_t uip_ext_opt_offset = 0;
 /** \name Buffer defines
  *  @{
  */
-#define FBUF                             ((struct uip_tcpip_hdr *)&uip_reassbuf[0])
+#define FBUF(ctx)                        ((struct uip_tcpip_hdr *)(ctx)->buf)
 #define UIP_IP_BUF                          ((struct uip_ip_hdr *)&uip_buf[UIP_LLH_LEN])
 #define UIP_ICMP_BUF                      ((struct uip_icmp_hdr *)&uip_buf[uip_l2_l3_hdr_len])
 #define UIP_UDP_BUF                        ((struct uip_udp_hdr *)&uip_buf[UIP_LLH_LEN + UIP_IPH_LEN])
@@ -168,6 +169,22 @@ uint8_t uip_ext_opt_offset = 0;
 uip_buf_t uip_aligned_buf;
 #endif /* UIP_CONF_EXTERNAL_BUFFER */
 
+#if UIP_BUF_POOL_SIZE > 1
+/* The active buffer and the spare ones; buffer 0 is uip_aligned_buf. */
+uip_buf_t *uip_bufp = &uip_aligned_buf;
+static uip_buf_t uip_buf_pool[UIP_BUF_POOL_SIZE - 1];
+
+/* The packet state of the inactive buffers. */
+static struct {
+  void *appdata;
+  uint16_t len;
+  uint8_t ext_len;
+  uint8_t used;
+} uip_buf_state[UIP_BUF_POOL_SIZE];
+
+static int8_t uip_buf_active;
+#endif /* UIP_BUF_POOL_SIZE > 1 */
+
 /* The uip_appdata pointer points to application data. */
 void *uip_appdata;
 /* The uip_appdata pointer points to the application data which is to be sent*/
@@ -243,6 +260,10 @@ static uint8_t iss[4];
 uint8_t uip_acc32[4];
 static uint8_t opt;
 static uint16_t tmp16;
+#if UIP_TCP_SNDBUF_SIZE > 0
+/* Offset from snd_nxt of the segment being sent from the send buffer. */
+static uint16_t sndbuf_seqoff;
+#endif /* UIP_TCP_SNDBUF_SIZE > 0 */
 #endif /* UIP_TCP */
 /** @} */
 
@@ -299,6 +320,62 @@ uip_add32(uint8_t *op32, uint16_t op16)
 
 #if ! UIP_ARCH_CHKSUM
 /*---------------------------------------------------------------------------*/
+#if UIP_CHKSUM_WORDWISE
+/*
+ * The one's complement sum does not depend on the byte order (RFC 1071),
+ * so words are added as the CPU loads them and the result is swapped
+ * into network order at the end. memcpy() keeps unaligned loads legal
+ * and compiles to plain loads.
+ */
+static uint16_t
+chksum(uint16_t sum, const uint8_t *data, uint16_t len)
+{
+  uint64_t acc;
+  uint32_t w0, w1, w2, w3;
+  uint16_t w;
+  uint8_t last[2];
+
+  acc = uip_htons(sum);
+
+  while(len >= 16) {
+    memcpy(&w0, data, 4);
+    memcpy(&w1, data + 4, 4);
+    memcpy(&w2, data + 8, 4);
+    memcpy(&w3, data + 12, 4);
+    acc += (uint64_t)w0 + w1 + w2 + w3;
+    data += 16;
+    len -= 16;
+  }
+  while(len >= 4) {
+    memcpy(&w0, data, 4);
+    acc += w0;
+    data += 4;
+    len -= 4;
+  }
+  if(len >= 2) {
+    memcpy(&w, data, 2);
+    acc += w;
+    data += 2;
+    len -= 2;
+  }
+  if(len == 1) {
+    /* Pad the odd byte as the first byte of a word. */
+    last[0] = data[0];
+    last[1] = 0;
+    memcpy(&w, last, 2);
+    acc += w;
+  }
+
+  /* Fold the carries back in. */
+  acc = (acc & 0xffffffff) + (acc >> 32);
+  acc = (acc & 0xffffffff) + (acc >> 32);
+  acc = (acc & 0xffff) + (acc >> 16);
+  acc = (acc & 0xffff) + (acc >> 16);
+
+  /* Return sum in host byte order. */
+  return uip_htons((uint16_t)acc);
+}
+#else /* UIP_CHKSUM_WORDWISE */
 static uint16_t
 chksum(uint16_t sum, const uint8_t *data, uint16_t len)
 {
@@ -329,6 +406,7 @@ chksum(uint16_t sum, const uint8_t *data, uint16_t len)
   /* Return sum in host byte order. */
   return sum;
 }
+#endif /* UIP_CHKSUM_WORDWISE */
 /*---------------------------------------------------------------------------*/
 uint16_t
 uip_chksum(uint16_t *data, uint16_t len)
@@ -405,6 +483,96 @@ uip_udpchksum(void)
 #endif /* UIP_UDP && UIP_UDP_CHECKSUMS */
 #endif /* UIP_ARCH_CHKSUM */
 /*---------------------------------------------------------------------------*/
+uint16_t
+uip_chksum_update(uint16_t chksum, uint16_t old_word, uint16_t new_word)
+{
+  uint32_t sum;
+
+  /* HC' = ~(~HC + ~m + m'), RFC 1624 eqn. 3 */
+  sum = (uint16_t)~chksum + (uint32_t)(uint16_t)~old_word + new_word;
+  sum = (sum & 0xffff) + (sum >> 16);
+  sum = (sum & 0xffff) + (sum >> 16);
+  return ~sum;
+}
+/*---------------------------------------------------------------------------*/
+#if UIP_BUF_POOL_SIZE > 1
+int8_t
+uip_buf_alloc(void)
+{
+  int8_t h;
+
+  for(h = 1; h < UIP_BUF_POOL_SIZE; h++) {
+    if(!uip_buf_state[h].used) {
+      uip_buf_state[h].used = 1;
+      uip_buf_state[h].len = 0;
+      uip_buf_state[h].ext_len = 0;
+      uip_buf_state[h].appdata = NULL;
+      return h;
+    }
+  }
+  PRINTF("uip_buf_alloc: no free buffer\n");
+  return -1;
+}
+/*---------------------------------------------------------------------------*/
+void
+uip_buf_free(int8_t handle)
+{
+  if(handle > 0 && handle < UIP_BUF_POOL_SIZE && handle != uip_buf_active) {
+    uip_buf_state[handle].used = 0;
+  }
+}
+/*---------------------------------------------------------------------------*/
+int8_t
+uip_buf_switch(int8_t handle)
+{
+  int8_t previous = uip_buf_active;
+
+  if(handle < 0 || handle >= UIP_BUF_POOL_SIZE || handle == previous) {
+    return previous;
+  }
+
+  uip_buf_state[previous].len = uip_len;
+  uip_buf_state[previous].ext_len = uip_ext_len;
+  uip_buf_state[previous].appdata = uip_appdata;
+
+  uip_buf_active = handle;
+  uip_bufp = handle == 0 ? &uip_aligned_buf : &uip_buf_pool[handle - 1];
+  uip_len = uip_buf_state[handle].len;
+  uip_ext_len = uip_buf_state[handle].ext_len;
+  uip_appdata = uip_buf_state[handle].appdata;
+  return previous;
+}
+/*---------------------------------------------------------------------------*/
+int8_t
+uip_buf_current(void)
+{
+  return uip_buf_active;
+}
+/*---------------------------------------------------------------------------*/
+int8_t
+uip_buf_push(void)
+{
+  int8_t handle = uip_buf_alloc();
+
+  if(handle < 0) {
+    return -1;
+  }
+  return uip_buf_switch(handle);
+}
+/*---------------------------------------------------------------------------*/
+void
+uip_buf_pop(int8_t previous)
+{
+  int8_t handle = uip_buf_active;
+
+  if(previous < 0) {
+    return;
+  }
+  uip_buf_switch(previous);
+  uip_buf_free(handle);
+}
+#endif /* UIP_BUF_POOL_SIZE > 1 */
+/*---------------------------------------------------------------------------*/
 void
 uip_init(void)
 {
@@ -600,14 +768,31 @@ uip_listen(uint16_t port)
 #if UIP_CONF_IPV6_REASSEMBLY
 #define UIP_REASS_BUFSIZE (UIP_BUFSIZE - UIP_LLH_LEN)
 
-static uint8_t uip_reassbuf[UIP_REASS_BUFSIZE];
-
-static uint8_t uip_reassbitmap[UIP_REASS_BUFSIZE / (8 * 8)];
 /*the first byte of an IP fragment is aligned on an 8-byte boundary */
 
 static const uint8_t bitmap_bits[8] = {0xff, 0x7f, 0x3f, 0x1f,
                                     0x0f, 0x07, 0x03, 0x01};
-static uint16_t uip_reasslen;
+
+/*
+ * A datagram being reassembled, identified by its source and
+ * destination addresses (kept in the copy of the IP header at the start
+ * of buf) and the Identification of its fragments. buf is taken from
+ * the reassembly pool shared with 6LoWPAN and is NULL when the context
+ * is unused.
+ */
+struct uip_reass_ctx {
+  uint8_t *buf;
+  uint32_t id;
+  struct timer timer;
+  uint16_t len;
+  uint16_t held;
+  uint8_t flags;
+  uint8_t bitmap[UIP_REASS_BUFSIZE / (8 * 8) + 1];
+};
+
+static struct uip_reass_ctx uip_reass_ctxs[UIP_REASS_CONTEXTS];
+
+/* Flags of the context handled by the last call to uip_reass(). */
 static uint8_t uip_reassflags;
 
 #define UIP_REASS_FLAG_LASTFRAG 0x01
@@ -626,155 +811,229 @@ static uint8_t uip_reassflags;
 
 
 struct etimer uip_reass_timer; /* timer for reassembly */
-uint8_t uip_reass_on; /* equal to 1 if we are currently reassembling a packet */
+uint8_t uip_reass_on; /* number of packets currently being reassembled */
 
-static uint32_t uip_id; /* For every packet that is to be fragmented, the source
-                        node generates an Identification value that is present
-                        in all the fragments */
 #define IP_MF   0x0001
 
+/*---------------------------------------------------------------------------*/
+static void
+reass_free(struct uip_reass_ctx *ctx)
+{
+  uip_reass_buf_free(ctx->buf, ctx->held);
+  ctx->buf = NULL;
+  uip_reass_on--;
+}
+/*---------------------------------------------------------------------------*/
+/* Set uip_reass_timer to the first context to time out. */
+static void
+reass_timer_update(void)
+{
+  struct uip_reass_ctx *ctx;
+  clock_time_t next, left;
+
+  next = 0;
+  for(ctx = uip_reass_ctxs; ctx < &uip_reass_ctxs[UIP_REASS_CONTEXTS]; ctx++) {
+    if(ctx->buf != NULL) {
+      left = timer_expired(&ctx->timer) ? 1 : timer_remaining(&ctx->timer);
+      if(next == 0 || left < next) {
+        next = left;
+      }
+    }
+  }
+  if(next == 0) {
+    etimer_stop(&uip_reass_timer);
+  } else {
+    etimer_set(&uip_reass_timer, next);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Find the context of the datagram the fragment in uip_buf belongs to,
+ * or start a new one. When no context or buffer is left, the datagram
+ * that has waited the longest is given up.
+ */
+static struct uip_reass_ctx *
+reass_lookup(void)
+{
+  struct uip_reass_ctx *ctx, *unused, *oldest;
+
+  unused = oldest = NULL;
+  for(ctx = uip_reass_ctxs; ctx < &uip_reass_ctxs[UIP_REASS_CONTEXTS]; ctx++) {
+    if(ctx->buf == NULL) {
+      if(unused == NULL) {
+        unused = ctx;
+      }
+    } else if(uip_ipaddr_cmp(&FBUF(ctx)->srcipaddr, &UIP_IP_BUF->srcipaddr) &&
+              uip_ipaddr_cmp(&FBUF(ctx)->destipaddr, &UIP_IP_BUF->destipaddr) &&
+              UIP_FRAG_BUF->id == ctx->id) {
+      return ctx;
+    } else if(oldest == NULL ||
+              (clock_time_t)(ctx->timer.start - oldest->timer.start) >
+              (clock_time_t)(oldest->timer.start - ctx->timer.start)) {
+      /* Contexts are started with the same lifetime, so the one
+         started first is the oldest. */
+      oldest = ctx;
+    }
+  }
+
+  if(unused != NULL) {
+    unused->buf = uip_reass_buf_alloc();
+  }
+  if(unused == NULL || unused->buf == NULL) {
+    if(oldest == NULL) {
+      PRINTF("No buffer for reassembly\n");
+      return NULL;
+    }
+    PRINTF("Giving up reassembly of an older packet\n");
+    UIP_STAT(++uip_stat.ip.drop);
+    reass_free(oldest);
+    unused = oldest;
+    unused->buf = uip_reass_buf_alloc();
+    if(unused->buf == NULL) {
+      return NULL;
+    }
+  }
+
+  PRINTF("Starting reassembly\n");
+  ctx = unused;
+  uip_reass_on++;
+  /* We first write the unfragmentable part of IP header into the
+     reassembly buffer. */
+  memcpy(FBUF(ctx), UIP_IP_BUF, uip_ext_len + UIP_IPH_LEN);
+  /* temporary in case we do not receive the fragment with offset 0 first */
+  timer_set(&ctx->timer, UIP_REASS_MAXAGE * CLOCK_SECOND);
+  ctx->flags = 0;
+  ctx->len = 0;
+  ctx->held = 0;
+  ctx->id = UIP_FRAG_BUF->id;
+  /* Clear the bitmap. */
+  memset(ctx->bitmap, 0, sizeof(ctx->bitmap));
+  reass_timer_update();
+  return ctx;
+}
+/*---------------------------------------------------------------------------*/
 static uint16_t
 uip_reass(void)
 {
+  struct uip_reass_ctx *ctx;
   uint16_t offset=0;
   uint16_t len;
   uint16_t i;
-  
-  /* If ip_reasstmr is zero, no packet is present in the buffer */
-  /* We first write the unfragmentable part of IP header into the reassembly
-     buffer. The reset the other reassembly variables. */
-  if(uip_reass_on == 0) {
-    PRINTF("Starting reassembly\n");
-    memcpy(FBUF, UIP_IP_BUF, uip_ext_len + UIP_IPH_LEN);
-    /* temporary in case we do not receive the fragment with offset 0 first */
-    etimer_set(&uip_reass_timer, UIP_REASS_MAXAGE*CLOCK_SECOND);
-    uip_reass_on = 1;
-    uip_reassflags = 0;
-    uip_id = UIP_FRAG_BUF->id;
-    /* Clear the bitmap. */
-    memset(uip_reassbitmap, 0, sizeof(uip_reassbitmap));
+
+  uip_reassflags = 0;
+  ctx = reass_lookup();
+  if(ctx == NULL) {
+    return 0;
   }
-  /*
-   * Check if the incoming fragment matches the one currently present
-   * in the reasembly buffer. If so, we proceed with copying the fragment
-   * into the buffer.
-   */
-  if(uip_ipaddr_cmp(&FBUF->srcipaddr, &UIP_IP_BUF->srcipaddr) &&
-     uip_ipaddr_cmp(&FBUF->destipaddr, &UIP_IP_BUF->destipaddr) &&
-     UIP_FRAG_BUF->id == uip_id) {
-    len = uip_len - uip_ext_len - UIP_IPH_LEN - UIP_FRAGH_LEN;
-    offset = (uip_ntohs(UIP_FRAG_BUF->offsetresmore) & 0xfff8);
-    /* in byte, originaly in multiple of 8 bytes*/
-    PRINTF("len %d\n", len);
-    PRINTF("offset %d\n", offset);
-    if(offset == 0){
-      uip_reassflags |= UIP_REASS_FLAG_FIRSTFRAG;
-      /*
-       * The Next Header field of the last header of the Unfragmentable
-       * Part is obtained from the Next Header field of the first
-       * fragment's Fragment header.
-       */
-      *uip_next_hdr = UIP_FRAG_BUF->next;
-      memcpy(FBUF, UIP_IP_BUF, uip_ext_len + UIP_IPH_LEN);
-      PRINTF("src ");
-      PRINT6ADDR(&FBUF->srcipaddr);
-      PRINTF("dest ");
-      PRINT6ADDR(&FBUF->destipaddr);
-      PRINTF("next %d\n", UIP_IP_BUF->proto);
-      
+
+  len = uip_len - uip_ext_len - UIP_IPH_LEN - UIP_FRAGH_LEN;
+  offset = (uip_ntohs(UIP_FRAG_BUF->offsetresmore) & 0xfff8);
+  /* in byte, originaly in multiple of 8 bytes*/
+  PRINTF("len %d\n", len);
+  PRINTF("offset %d\n", offset);
+  if(offset == 0){
+    ctx->flags |= UIP_REASS_FLAG_FIRSTFRAG;
+    /*
+     * The Next Header field of the last header of the Unfragmentable
+     * Part is obtained from the Next Header field of the first
+     * fragment's Fragment header.
+     */
+    *uip_next_hdr = UIP_FRAG_BUF->next;
+    memcpy(FBUF(ctx), UIP_IP_BUF, uip_ext_len + UIP_IPH_LEN);
+    PRINTF("src ");
+    PRINT6ADDR(&FBUF(ctx)->srcipaddr);
+    PRINTF("dest ");
+    PRINT6ADDR(&FBUF(ctx)->destipaddr);
+    PRINTF("next %d\n", UIP_IP_BUF->proto);
+  }
+
+  /* If the offset or the offset + fragment length overflows the
+     reassembly buffer, we discard the entire packet. */
+  if(offset > UIP_REASS_BUFSIZE - UIP_IPH_LEN - uip_ext_len ||
+     offset + len > UIP_REASS_BUFSIZE - UIP_IPH_LEN - uip_ext_len) {
+    reass_free(ctx);
+    reass_timer_update();
+    return 0;
+  }
+
+  /* If this fragment has the More Fragments flag set to zero, it is the
+     last fragment*/
+  if((uip_ntohs(UIP_FRAG_BUF->offsetresmore) & IP_MF) == 0) {
+    ctx->flags |= UIP_REASS_FLAG_LASTFRAG;
+    /*calculate the size of the entire packet*/
+    ctx->len = offset + len;
+    PRINTF("LAST FRAGMENT reasslen %d\n", ctx->len);
+  } else {
+    /* If len is not a multiple of 8 octets and the M flag of that fragment
+       is 1, then that fragment must be discarded and an ICMP Parameter
+       Problem, Code 0, message should be sent to the source of the fragment,
+       pointing to the Payload Length field of the fragment packet. */
+    if(len % 8 != 0){
+      uip_icmp6_error_output(ICMP6_PARAM_PROB, ICMP6_PARAMPROB_HEADER, 4);
+      uip_reassflags = ctx->flags | UIP_REASS_FLAG_ERROR_MSG;
+      /* not clear if we should interrupt reassembly, but it seems so from
+         the conformance tests */
+      reass_free(ctx);
+      reass_timer_update();
+      return uip_len;
     }
-    
-    /* If the offset or the offset + fragment length overflows the
-       reassembly buffer, we discard the entire packet. */
-    if(offset > UIP_REASS_BUFSIZE ||
-       offset + len > UIP_REASS_BUFSIZE) {
-      uip_reass_on = 0;
-      etimer_stop(&uip_reass_timer);
-      return 0;
+  }
+
+  /* Copy the fragment into the reassembly buffer, at the right
+     offset. */
+  memcpy((uint8_t *)FBUF(ctx) + UIP_IPH_LEN + uip_ext_len + offset,
+         (uint8_t *)UIP_FRAG_BUF + UIP_FRAGH_LEN, len);
+  ctx->held += len;
+  uip_reass_buf_hold(len);
+
+  /* Update the bitmap. */
+  if(offset >> 6 == (offset + len) >> 6) {
+    ctx->bitmap[offset >> 6] |=
+      bitmap_bits[(offset >> 3) & 7] &
+      ~bitmap_bits[((offset + len) >> 3)  & 7];
+  } else {
+    /* If the two endpoints are in different bytes, we update the
+       bytes in the endpoints and fill the stuff inbetween with
+       0xff. */
+    ctx->bitmap[offset >> 6] |= bitmap_bits[(offset >> 3) & 7];
+
+    for(i = (1 + (offset >> 6)); i < ((offset + len) >> 6); ++i) {
+      ctx->bitmap[i] = 0xff;
     }
+    ctx->bitmap[(offset + len) >> 6] |=
+      ~bitmap_bits[((offset + len) >> 3) & 7];
+  }
 
-    /* If this fragment has the More Fragments flag set to zero, it is the
-       last fragment*/
-    if((uip_ntohs(UIP_FRAG_BUF->offsetresmore) & IP_MF) == 0) {
-      uip_reassflags |= UIP_REASS_FLAG_LASTFRAG;
-      /*calculate the size of the entire packet*/
-      uip_reasslen = offset + len;
-      PRINTF("LAST FRAGMENT reasslen %d\n", uip_reasslen);
-    } else {
-      /* If len is not a multiple of 8 octets and the M flag of that fragment
-         is 1, then that fragment must be discarded and an ICMP Parameter
-         Problem, Code 0, message should be sent to the source of the fragment,
-         pointing to the Payload Length field of the fragment packet. */
-      if(len % 8 != 0){
-        uip_icmp6_error_output(ICMP6_PARAM_PROB, ICMP6_PARAMPROB_HEADER, 4);
-        uip_reassflags |= UIP_REASS_FLAG_ERROR_MSG;
-        /* not clear if we should interrupt reassembly, but it seems so from
-           the conformance tests */
-        uip_reass_on = 0;
-        etimer_stop(&uip_reass_timer);
-        return uip_len;
+  /* Finally, we check if we have a full packet in the buffer. We do
+     this by checking if we have the last fragment and if all bits
+     in the bitmap are set. */
+  uip_reassflags = ctx->flags;
+  if(ctx->flags & UIP_REASS_FLAG_LASTFRAG) {
+    /* Check all bytes up to and including all but the last byte in
+       the bitmap. */
+    for(i = 0; i < (ctx->len >> 6); ++i) {
+      if(ctx->bitmap[i] != 0xff) {
+        return 0;
       }
     }
-    
-    /* Copy the fragment into the reassembly buffer, at the right
-       offset. */
-    memcpy((uint8_t *)FBUF + UIP_IPH_LEN + uip_ext_len + offset,
-           (uint8_t *)UIP_FRAG_BUF + UIP_FRAGH_LEN, len);
-    
-    /* Update the bitmap. */
-    if(offset >> 6 == (offset + len) >> 6) {
-      uip_reassbitmap[offset >> 6] |=
-        bitmap_bits[(offset >> 3) & 7] &
-        ~bitmap_bits[((offset + len) >> 3)  & 7];
-    } else {
-      /* If the two endpoints are in different bytes, we update the
-         bytes in the endpoints and fill the stuff inbetween with
-         0xff. */
-      uip_reassbitmap[offset >> 6] |= bitmap_bits[(offset >> 3) & 7];
- 
-      for(i = (1 + (offset >> 6)); i < ((offset + len) >> 6); ++i) {
-        uip_reassbitmap[i] = 0xff;
-      }
-      uip_reassbitmap[(offset + len) >> 6] |=
-        ~bitmap_bits[((offset + len) >> 3) & 7];
+    /* Check the last byte in the bitmap. It should contain just the
+       right amount of bits. */
+    if(ctx->bitmap[ctx->len >> 6] !=
+       (uint8_t)~bitmap_bits[(ctx->len >> 3) & 7]) {
+      return 0;
     }
-  
-    /* Finally, we check if we have a full packet in the buffer. We do
-       this by checking if we have the last fragment and if all bits
-       in the bitmap are set. */
-    
-    if(uip_reassflags & UIP_REASS_FLAG_LASTFRAG) {
-      /* Check all bytes up to and including all but the last byte in
-         the bitmap. */
-      for(i = 0; i < (uip_reasslen >> 6); ++i) {
-        if(uip_reassbitmap[i] != 0xff) {
-          return 0;
-        }
-      }
-      /* Check the last byte in the bitmap. It should contain just the
-         right amount of bits. */
-      if(uip_reassbitmap[uip_reasslen >> 6] !=
-         (uint8_t)~bitmap_bits[(uip_reasslen >> 3) & 7]) {
-        return 0;
-      }
 
-     /* If we have come this far, we have a full packet in the
-         buffer, so we copy it to uip_buf. We also reset the timer. */
-      uip_reass_on = 0;
-      etimer_stop(&uip_reass_timer);
-
-      uip_reasslen += UIP_IPH_LEN + uip_ext_len;
-      memcpy(UIP_IP_BUF, FBUF, uip_reasslen);
-      UIP_IP_BUF->len[0] = ((uip_reasslen - UIP_IPH_LEN) >> 8);
-      UIP_IP_BUF->len[1] = ((uip_reasslen - UIP_IPH_LEN) & 0xff);
-      PRINTF("REASSEMBLED PAQUET %d (%d)\n", uip_reasslen,
-             (UIP_IP_BUF->len[0] << 8) | UIP_IP_BUF->len[1]);
-   
-      return uip_reasslen;
-      
-    }
-  } else {
-    PRINTF("Already reassembling another paquet\n");
+    /* If we have come this far, we have a full packet in the
+       buffer, so we copy it to uip_buf and free the context. */
+    len = ctx->len + UIP_IPH_LEN + uip_ext_len;
+    memcpy(UIP_IP_BUF, FBUF(ctx), len);
+    UIP_IP_BUF->len[0] = ((len - UIP_IPH_LEN) >> 8);
+    UIP_IP_BUF->len[1] = ((len - UIP_IPH_LEN) & 0xff);
+    PRINTF("REASSEMBLED PAQUET %d (%d)\n", len,
+           (UIP_IP_BUF->len[0] << 8) | UIP_IP_BUF->len[1]);
+    reass_free(ctx);
+    reass_timer_update();
+    return len;
   }
   return 0;
 }
@@ -782,31 +1041,40 @@ uip_reass(void)
 void
 uip_reass_over(void)
 {
-   /* to late, we abandon the reassembly of the packet */
-
-  uip_reass_on = 0;
-  etimer_stop(&uip_reass_timer);
-
-  if(uip_reassflags & UIP_REASS_FLAG_FIRSTFRAG){
-    PRINTF("FRAG INTERRUPTED TOO LATE\n");
-    /* If the first fragment has been received, an ICMP Time Exceeded
-       -- Fragment Reassembly Time Exceeded message should be sent to the
-       source of that fragment. */
-    /** \note
-     * We don't have a complete packet to put in the error message.
-     * We could include the first fragment but since its not mandated by
-     * any RFC, we decided not to include it as it reduces the size of
-     * the packet.
-     */
-    uip_len = 0;
-    uip_ext_len = 0;
-    memcpy(UIP_IP_BUF, FBUF, UIP_IPH_LEN); /* copy the header for src
-                                              and dest address*/
-    uip_icmp6_error_output(ICMP6_TIME_EXCEEDED, ICMP6_TIME_EXCEED_REASSEMBLY, 0);
-    
-    UIP_STAT(++uip_stat.ip.sent);
-    uip_flags = 0;
+  struct uip_reass_ctx *ctx;
+
+  /* to late, we abandon the reassembly of the packets that timed out */
+  uip_len = 0;
+  for(ctx = uip_reass_ctxs; ctx < &uip_reass_ctxs[UIP_REASS_CONTEXTS]; ctx++) {
+    if(ctx->buf == NULL || !timer_expired(&ctx->timer)) {
+      continue;
+    }
+    if(ctx->flags & UIP_REASS_FLAG_FIRSTFRAG) {
+      PRINTF("FRAG INTERRUPTED TOO LATE\n");
+      /* If the first fragment has been received, an ICMP Time Exceeded
+         -- Fragment Reassembly Time Exceeded message should be sent to the
+         source of that fragment. */
+      /** \note
+       * We don't have a complete packet to put in the error message.
+       * We could include the first fragment but since its not mandated by
+       * any RFC, we decided not to include it as it reduces the size of
+       * the packet.
+       */
+      uip_ext_len = 0;
+      memcpy(UIP_IP_BUF, FBUF(ctx), UIP_IPH_LEN); /* copy the header for src
+                                                     and dest address*/
+      reass_free(ctx);
+      uip_icmp6_error_output(ICMP6_TIME_EXCEEDED, ICMP6_TIME_EXCEED_REASSEMBLY, 0);
+
+      UIP_STAT(++uip_stat.ip.sent);
+      uip_flags = 0;
+      /* uip_buf holds one message; other contexts that have timed out
+         are handled when the timer fires again right away. */
+      break;
+    }
+    reass_free(ctx);
   }
+  reass_timer_update();
 }
 
 #endif /* UIP_CONF_IPV6_REASSEMBLY */
@@ -822,6 +1090,186 @@ uip_add_rcv_nxt(uint16_t n)
   uip_conn->rcv_nxt[2] = uip_acc32[2];
   uip_conn->rcv_nxt[3] = uip_acc32[3];
 }
+/*---------------------------------------------------------------------------*/
+static void
+uip_tcp_rtt_estimate(struct uip_conn *conn)
+{
+  signed char m;
+  m = conn->rto - conn->timer;
+  /* This is taken directly from VJs original code in his paper */
+  m = m - (conn->sa >> 3);
+  conn->sa += m;
+  if(m < 0) {
+    m = -m;
+  }
+  m = m - (conn->sv >> 2);
+  conn->sv += m;
+  conn->rto = (conn->sa >> 3) + conn->sv;
+}
+#if UIP_TCP_SNDBUF_SIZE > 0
+/*---------------------------------------------------------------------------*/
+#define SNDBUF_ROOM(conn) \
+  (UIP_TCP_SNDBUF_SIZE - (conn)->sndbuf.len >= (conn)->initialmss)
+
+#define SNDBUF_DUPACK_THRESHOLD 3
+
+static uint32_t
+seq_sub(const uint8_t *a, const uint8_t *b)
+{
+  return ((((uint32_t)a[0] << 24) | ((uint32_t)a[1] << 16) |
+           ((uint32_t)a[2] << 8) | a[3]) -
+          (((uint32_t)b[0] << 24) | ((uint32_t)b[1] << 16) |
+           ((uint32_t)b[2] << 8) | b[3]));
+}
+/*---------------------------------------------------------------------------*/
+static void
+sndbuf_set_cwnd(struct uip_tcp_sndbuf *sb, uint32_t cwnd)
+{
+  sb->cwnd = cwnd > UIP_TCP_SNDBUF_SIZE ? UIP_TCP_SNDBUF_SIZE : cwnd;
+}
+/*---------------------------------------------------------------------------*/
+static void
+sndbuf_init(struct uip_conn *conn)
+{
+  struct uip_tcp_sndbuf *sb = &conn->sndbuf;
+
+  sb->len = 0;
+  sb->flags = 0;
+  sb->dupacks = 0;
+  sb->wnd = ((uint16_t)UIP_TCP_BUF->wnd[0] << 8) + UIP_TCP_BUF->wnd[1];
+  sndbuf_set_cwnd(sb, 2 * (uint32_t)conn->initialmss);
+  sb->ssthresh = UIP_TCP_SNDBUF_SIZE;
+}
+/*---------------------------------------------------------------------------*/
+/* Halve the flight size for a new slow start threshold (RFC 5681). */
+static void
+sndbuf_loss(struct uip_conn *conn)
+{
+  uint16_t half = conn->len / 2;
+
+  if(half < 2 * conn->initialmss) {
+    half = 2 * conn->initialmss;
+  }
+  conn->sndbuf.ssthresh = half;
+  conn->sndbuf.dupacks = 0;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Process the ACK in the incoming segment for a connection in the
+ * ESTABLISHED state. Acknowledged data is removed from the send
+ * buffer and the congestion window is updated. The
+ * UIP_TCP_SNDBUF_REXMIT flag is set if the first segment should be
+ * retransmitted.
+ */
+static void
+sndbuf_ack(struct uip_conn *conn)
+{
+  struct uip_tcp_sndbuf *sb = &conn->sndbuf;
+  uint32_t acked;
+  uint16_t wnd;
+
+  wnd = ((uint16_t)UIP_TCP_BUF->wnd[0] << 8) + UIP_TCP_BUF->wnd[1];
+  acked = seq_sub(UIP_TCP_BUF->ackno, conn->snd_nxt);
+
+  if(acked == 0) {
+    /* A duplicate ACK carries no data, does not change the window and
+       arrives while we have data in flight. */
+    if(conn->len > 0 && uip_len == 0 && wnd == sb->wnd) {
+      if(sb->flags & UIP_TCP_SNDBUF_RECOVERY) {
+        /* Each further duplicate means a segment has left the
+           network, so one more may be sent. */
+        sndbuf_set_cwnd(sb, (uint32_t)sb->cwnd + conn->initialmss);
+      } else if(++sb->dupacks == SNDBUF_DUPACK_THRESHOLD) {
+        PRINTF("tcp: fast retransmit\n");
+        UIP_STAT(++uip_stat.tcp.rexmit);
+        sndbuf_loss(conn);
+        sndbuf_set_cwnd(sb, (uint32_t)sb->ssthresh +
+                        SNDBUF_DUPACK_THRESHOLD * conn->initialmss);
+        uip_add32(conn->snd_nxt, conn->len);
+        memcpy(sb->recover, uip_acc32, 4);
+        sb->flags |= UIP_TCP_SNDBUF_RECOVERY | UIP_TCP_SNDBUF_REXMIT;
+      }
+    }
+    sb->wnd = wnd;
+    return;
+  }
+
+  if(acked > conn->len) {
+    /* Old or bogus ACK. */
+    return;
+  }
+
+  sb->wnd = wnd;
+  sb->dupacks = 0;
+
+  /* Do RTT estimation if everything in flight was acknowledged, and
+     nothing was retransmitted. */
+  if(conn->nrtx == 0 && acked == conn->len &&
+     !(sb->flags & UIP_TCP_SNDBUF_RECOVERY)) {
+    uip_tcp_rtt_estimate(conn);
+  }
+  conn->nrtx = 0;
+  conn->timer = conn->rto;
+
+  uip_add32(conn->snd_nxt, (uint16_t)acked);
+  memcpy(conn->snd_nxt, uip_acc32, 4);
+  conn->len -= acked;
+  sb->len -= acked;
+  memmove(sb->data, sb->data + acked, sb->len);
+
+  if(sb->flags & UIP_TCP_SNDBUF_RECOVERY) {
+    if(seq_sub(conn->snd_nxt, sb->recover) < 0x80000000UL) {
+      /* Everything sent before the loss is acknowledged. */
+      sb->cwnd = sb->ssthresh;
+      sb->flags &= ~UIP_TCP_SNDBUF_RECOVERY;
+    } else {
+      /* A partial ACK: the next segment was lost as well. Deflate the
+         window by the amount acknowledged and retransmit. */
+      sndbuf_set_cwnd(sb, (sb->cwnd > acked ? sb->cwnd - acked : 0) +
+                      (uint32_t)conn->initialmss);
+      sb->flags |= UIP_TCP_SNDBUF_REXMIT;
+    }
+  } else if(sb->cwnd < sb->ssthresh) {
+    /* Slow start. */
+    sndbuf_set_cwnd(sb, (uint32_t)sb->cwnd + conn->initialmss);
+  } else {
+    /* Congestion avoidance: one segment per round-trip. */
+    sndbuf_set_cwnd(sb, (uint32_t)sb->cwnd +
+                    (uint32_t)conn->initialmss * conn->initialmss / sb->cwnd);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Return the size of the next segment to send from the send buffer,
+ * or 0 if nothing may be sent now.
+ */
+static uint16_t
+sndbuf_segment(struct uip_conn *conn)
+{
+  struct uip_tcp_sndbuf *sb = &conn->sndbuf;
+  uint16_t wnd, seg;
+
+  seg = sb->len - conn->len;
+  if(seg > conn->initialmss) {
+    seg = conn->initialmss;
+  }
+  if(seg == 0) {
+    return 0;
+  }
+
+  wnd = sb->wnd < sb->cwnd ? sb->wnd : sb->cwnd;
+  if(conn->len == 0) {
+    /* One segment may always be in flight. If the peer has closed its
+       window, this is the probe that the retransmission timer
+       repeats. */
+    return seg;
+  }
+  if(wnd <= conn->len || seg > wnd - conn->len) {
+    return 0;
+  }
+  return seg;
+}
+#endif /* UIP_TCP_SNDBUF_SIZE > 0 */
 #endif
 /*---------------------------------------------------------------------------*/
 
@@ -921,16 +1369,50 @@ uip_process(uint8_t flag)
   }
 #endif /* UIP_UDP */
   uip_sappdata = uip_appdata = &uip_buf[UIP_IPTCPH_LEN + UIP_LLH_LEN];
+
+#if UIP_TCP_SNDBUF_SIZE > 0
+  /* Check if we were invoked to send more from a connection's send
+     buffer. If the application waits for uip_acked() and there is
+     room for more data, it gets to add that first. */
+  if(flag == UIP_TCP_OUTPUT) {
+    uip_len = uip_slen = 0;
+    uip_flags = 0;
+    if((uip_connr->tcpstateflags & UIP_TS_MASK) != UIP_ESTABLISHED) {
+      goto drop;
+    }
+    if((uip_connr->sndbuf.flags &
+        (UIP_TCP_SNDBUF_APPWAIT | UIP_TCP_SNDBUF_CLOSE)) ==
+       UIP_TCP_SNDBUF_APPWAIT && SNDBUF_ROOM(uip_connr)) {
+      uip_flags = UIP_ACKDATA;
+      UIP_APPCALL();
+      goto appsend;
+    }
+    goto sndbuf_send;
+  }
+#endif /* UIP_TCP_SNDBUF_SIZE > 0 */
    
   /* Check if we were invoked because of a poll request for a
      particular connection. */
   if(flag == UIP_POLL_REQUEST) {
 #if UIP_TCP
+#if UIP_TCP_SNDBUF_SIZE > 0
+    /* With a send buffer, the application may add data while earlier
+       data is still in flight. */
+    if((uip_connr->tcpstateflags & UIP_TS_MASK) == UIP_ESTABLISHED) {
+      if(SNDBUF_ROOM(uip_connr) &&
+         !(uip_connr->sndbuf.flags & UIP_TCP_SNDBUF_CLOSE)) {
+        uip_flags = UIP_POLL;
+        UIP_APPCALL();
+        goto appsend;
+      }
+      goto sndbuf_send;
+#else /* UIP_TCP_SNDBUF_SIZE > 0 */
     if((uip_connr->tcpstateflags & UIP_TS_MASK) == UIP_ESTABLISHED &&
        !uip_outstanding(uip_connr)) {
       uip_flags = UIP_POLL;
       UIP_APPCALL();
       goto appsend;
+#endif /* UIP_TCP_SNDBUF_SIZE > 0 */
 #if UIP_ACTIVE_OPEN
     } else if((uip_connr->tcpstateflags & UIP_TS_MASK) == UIP_SYN_SENT) {
       /* In the SYN_SENT state, we retransmit out SYN. */
@@ -1023,6 +1505,18 @@ uip_process(uint8_t flag)
 #endif /* UIP_ACTIVE_OPEN */
                      
             case UIP_ESTABLISHED:
+#if UIP_TCP_SNDBUF_SIZE > 0
+              /*
+               * With a send buffer, we go back to the first
+               * unacknowledged segment and restart slow start. The
+               * rest of the buffer is resent as ACKs come in.
+               */
+              sndbuf_loss(uip_connr);
+              uip_connr->sndbuf.cwnd = uip_connr->initialmss;
+              uip_connr->sndbuf.flags &= ~UIP_TCP_SNDBUF_RECOVERY;
+              uip_connr->len = 0;
+              goto sndbuf_rexmit;
+#else /* UIP_TCP_SNDBUF_SIZE > 0 */
               /*
                * In the ESTABLISHED state, we call upon the application
                * to do the actual retransmit after which we jump into
@@ -1032,6 +1526,7 @@ uip_process(uint8_t flag)
               uip_flags = UIP_REXMIT;
               UIP_APPCALL();
               goto apprexmit;
+#endif /* UIP_TCP_SNDBUF_SIZE > 0 */
                      
             case UIP_FIN_WAIT_1:
             case UIP_CLOSING:
@@ -1309,6 +1804,30 @@ uip_process(uint8_t flag)
 
         PRINTF("Processing Routing header\n");
         if(UIP_ROUTING_BUF->seg_left > 0) {
+#if UIP_CONF_IPV6_RPL && RPL_WITH_NON_STORING && UIP_CONF_ROUTER
+          switch(rpl_srh_process(UIP_ROUTING_BUF)) {
+          case 1:
+            /* Source routed: forward to the next address in the header */
+            if(UIP_IP_BUF->ttl <= 1) {
+              uip_icmp6_error_output(ICMP6_TIME_EXCEEDED,
+                                     ICMP6_TIME_EXCEED_TRANSIT, 0);
+              UIP_STAT(++uip_stat.ip.drop);
+              goto send;
+            }
+            rpl_update_header_empty();
+            UIP_IP_BUF->ttl = UIP_IP_BUF->ttl - 1;
+            UIP_STAT(++uip_stat.ip.forwarded);
+            goto send;
+          case 2:
+            /* Malformed header: send the Parameter Problem built by RPL */
+            UIP_STAT(++uip_stat.ip.drop);
+            UIP_LOG("ip6: bad source routing header");
+            goto send;
+          case -1:
+            UIP_STAT(++uip_stat.ip.drop);
+            goto drop;
+          }
+#endif /* UIP_CONF_IPV6_RPL && RPL_WITH_NON_STORING && UIP_CONF_ROUTER */
           uip_icmp6_error_output(ICMP6_PARAM_PROB, ICMP6_PARAMPROB_HEADER, UIP_IPH_LEN + uip_ext_len + 2);
           UIP_STAT(++uip_stat.ip.drop);
           UIP_LOG("ip6: unrecognized routing type");
@@ -1846,7 +2365,15 @@ uip_process(uint8_t flag)
   /* Next, check if the incoming segment acknowledges any outstanding
      data. If so, we update the sequence number, reset the length of
      the outstanding data, calculate RTT estimations, and reset the
-     retransmission timer. */
+     retransmission timer. With a send buffer, ACKs in the ESTABLISHED
+     state may acknowledge part of the data in flight and are handled
+     by sndbuf_ack(). */
+#if UIP_TCP_SNDBUF_SIZE > 0
+  if((UIP_TCP_BUF->flags & TCP_ACK) &&
+     (uip_connr->tcpstateflags & UIP_TS_MASK) == UIP_ESTABLISHED) {
+    sndbuf_ack(uip_connr);
+  } else
+#endif /* UIP_TCP_SNDBUF_SIZE > 0 */
   if((UIP_TCP_BUF->flags & TCP_ACK) && uip_outstanding(uip_connr)) {
     uip_add32(uip_connr->snd_nxt, uip_connr->len);
 
@@ -1862,18 +2389,7 @@ uip_process(uint8_t flag)
    
       /* Do RTT estimation, unless we have done retransmissions. */
       if(uip_connr->nrtx == 0) {
-        signed char m;
-        m = uip_connr->rto - uip_connr->timer;
-        /* This is taken directly from VJs original code in his paper */
-        m = m - (uip_connr->sa >> 3);
-        uip_connr->sa += m;
-        if(m < 0) {
-          m = -m;
-        }
-        m = m - (uip_connr->sv >> 2);
-        uip_connr->sv += m;
-        uip_connr->rto = (uip_connr->sa >> 3) + uip_connr->sv;
-
+        uip_tcp_rtt_estimate(uip_connr);
       }
       /* Set the acknowledged flag. */
       uip_flags = UIP_ACKDATA;
@@ -1901,6 +2417,9 @@ uip_process(uint8_t flag)
         uip_connr->tcpstateflags = UIP_ESTABLISHED;
         uip_flags = UIP_CONNECTED;
         uip_connr->len = 0;
+#if UIP_TCP_SNDBUF_SIZE > 0
+        sndbuf_init(uip_connr);
+#endif /* UIP_TCP_SNDBUF_SIZE > 0 */
         if(uip_len > 0) {
           uip_flags |= UIP_NEWDATA;
           uip_add_rcv_nxt(uip_len);
@@ -1963,6 +2482,9 @@ uip_process(uint8_t flag)
         uip_add_rcv_nxt(1);
         uip_flags = UIP_CONNECTED | UIP_NEWDATA;
         uip_connr->len = 0;
+#if UIP_TCP_SNDBUF_SIZE > 0
+        sndbuf_init(uip_connr);
+#endif /* UIP_TCP_SNDBUF_SIZE > 0 */
         uip_len = 0;
         uip_slen = 0;
         UIP_APPCALL();
@@ -1992,6 +2514,11 @@ uip_process(uint8_t flag)
         if(uip_outstanding(uip_connr)) {
           goto drop;
         }
+#if UIP_TCP_SNDBUF_SIZE > 0
+        if(uip_connr->sndbuf.len > 0) {
+          goto drop;
+        }
+#endif /* UIP_TCP_SNDBUF_SIZE > 0 */
         uip_add_rcv_nxt(1 + uip_len);
         uip_flags |= UIP_CLOSE;
         if(uip_len > 0) {
@@ -2027,6 +2554,15 @@ uip_process(uint8_t flag)
 #endif /* UIP_URGDATA > 0 */
       }
 
+#if UIP_TCP_SNDBUF_SIZE > 0
+      /* The application may answer incoming data with uip_mss() bytes,
+         so we only accept data when the send buffer has room for
+         them. The peer will retransmit the segment. */
+      if(!SNDBUF_ROOM(uip_connr)) {
+        uip_len = 0;
+      }
+#endif /* UIP_TCP_SNDBUF_SIZE > 0 */
+
       /* If uip_len > 0 we have TCP data in the packet, and we flag this
          by setting the UIP_NEWDATA flag and update the sequence number
          we acknowledge. If the application has stopped the dataflow
@@ -2049,12 +2585,24 @@ uip_process(uint8_t flag)
          and the application will retransmit it. This is called the
          "persistent timer" and uses the retransmission mechanim.
       */
+#if UIP_TCP_SNDBUF_SIZE == 0
       tmp16 = ((uint16_t)UIP_TCP_BUF->wnd[0] << 8) + (uint16_t)UIP_TCP_BUF->wnd[1];
       if(tmp16 > uip_connr->initialmss ||
          tmp16 == 0) {
         tmp16 = uip_connr->initialmss;
       }
       uip_connr->mss = tmp16;
+#else /* UIP_TCP_SNDBUF_SIZE == 0 */
+      /* With a send buffer, the window is taken care of by
+         sndbuf_segment() and the MSS stays at its initial value.
+         uip_acked() tells the application that its data has been
+         buffered and that there is room for more. */
+      if((uip_connr->sndbuf.flags &
+          (UIP_TCP_SNDBUF_APPWAIT | UIP_TCP_SNDBUF_CLOSE)) ==
+         UIP_TCP_SNDBUF_APPWAIT && SNDBUF_ROOM(uip_connr)) {
+        uip_flags |= UIP_ACKDATA;
+      }
+#endif /* UIP_TCP_SNDBUF_SIZE == 0 */
 
       /* If this packet constitutes an ACK for outstanding data (flagged
          by the UIP_ACKDATA flag, we should call the application since it
@@ -2085,8 +2633,33 @@ uip_process(uint8_t flag)
           goto tcp_send_nodata;
         }
 
+#if UIP_TCP_SNDBUF_SIZE > 0
+        /* Move the application's data into the send buffer. A FIN is
+           sent when everything before it has been acknowledged. */
+        if(uip_flags & UIP_ACKDATA) {
+          uip_connr->sndbuf.flags &= ~UIP_TCP_SNDBUF_APPWAIT;
+        }
+        if(uip_slen > 0) {
+          if(uip_slen > UIP_TCP_SNDBUF_SIZE - uip_connr->sndbuf.len) {
+            uip_slen = UIP_TCP_SNDBUF_SIZE - uip_connr->sndbuf.len;
+          }
+          memcpy(&uip_connr->sndbuf.data[uip_connr->sndbuf.len],
+                 uip_sappdata, uip_slen);
+          uip_connr->sndbuf.len += uip_slen;
+          uip_connr->sndbuf.flags |= UIP_TCP_SNDBUF_APPWAIT;
+          uip_slen = 0;
+        }
+        if(uip_flags & UIP_CLOSE) {
+          uip_connr->sndbuf.flags |= UIP_TCP_SNDBUF_CLOSE;
+        }
+        goto sndbuf_send;
+#endif /* UIP_TCP_SNDBUF_SIZE > 0 */
+
         if(uip_flags & UIP_CLOSE) {
           uip_slen = 0;
+#if UIP_TCP_SNDBUF_SIZE > 0
+        tcp_send_fin:
+#endif /* UIP_TCP_SNDBUF_SIZE > 0 */
           uip_connr->len = 1;
           uip_connr->tcpstateflags = UIP_FIN_WAIT_1;
           uip_connr->nrtx = 0;
@@ -2094,6 +2667,7 @@ uip_process(uint8_t flag)
           goto tcp_send_nodata;
         }
 
+#if UIP_TCP_SNDBUF_SIZE == 0
         /* If uip_slen > 0, the application has data to be sent. */
         if(uip_slen > 0) {
 
@@ -2147,8 +2721,15 @@ uip_process(uint8_t flag)
           UIP_TCP_BUF->flags = TCP_ACK;
           goto tcp_send_noopts;
         }
+#endif /* UIP_TCP_SNDBUF_SIZE == 0 */
       }
+#if UIP_TCP_SNDBUF_SIZE > 0
+      /* ACKs may have opened the window, or asked for a fast
+         retransmit. */
+      goto sndbuf_send;
+#else /* UIP_TCP_SNDBUF_SIZE > 0 */
       goto drop;
+#endif /* UIP_TCP_SNDBUF_SIZE > 0 */
     case UIP_LAST_ACK:
       /* We can close this connection if the peer has acknowledged our
          FIN. This is indicated by the UIP_ACKDATA flag. */
@@ -2215,6 +2796,54 @@ uip_process(uint8_t flag)
       }
   }
   goto drop;
+
+#if UIP_TCP_SNDBUF_SIZE > 0
+  /* We jump here to send the next segment from the send buffer of a
+     connection in the ESTABLISHED state, or to send its FIN once the
+     buffer has been acknowledged. */
+ sndbuf_send:
+  if(uip_connr->sndbuf.flags & UIP_TCP_SNDBUF_REXMIT) {
+    goto sndbuf_rexmit;
+  }
+  tmp16 = sndbuf_segment(uip_connr);
+  if(tmp16 == 0) {
+    if(uip_connr->sndbuf.len == 0 &&
+       (uip_connr->sndbuf.flags & UIP_TCP_SNDBUF_CLOSE)) {
+      uip_connr->sndbuf.flags &= ~UIP_TCP_SNDBUF_CLOSE;
+      goto tcp_send_fin;
+    }
+    if(uip_flags & UIP_NEWDATA) {
+      goto tcp_send_ack;
+    }
+    goto drop;
+  }
+  if(uip_connr->len == 0) {
+    uip_connr->timer = uip_connr->rto;
+  }
+  sndbuf_seqoff = uip_connr->len;
+  uip_connr->len += tmp16;
+  goto sndbuf_output;
+
+  /* Retransmit the first unacknowledged segment. */
+ sndbuf_rexmit:
+  uip_connr->sndbuf.flags &= ~UIP_TCP_SNDBUF_REXMIT;
+  tmp16 = uip_connr->sndbuf.len > uip_connr->initialmss ?
+    uip_connr->initialmss : uip_connr->sndbuf.len;
+  if(tmp16 == 0) {
+    goto drop;
+  }
+  if(uip_connr->len < tmp16) {
+    uip_connr->len = tmp16;
+  }
+  sndbuf_seqoff = 0;
+
+ sndbuf_output:
+  memcpy(&uip_buf[UIP_IPTCPH_LEN + UIP_LLH_LEN],
+         &uip_connr->sndbuf.data[sndbuf_seqoff], tmp16);
+  uip_len = tmp16 + UIP_TCPIP_HLEN;
+  UIP_TCP_BUF->flags = TCP_ACK | TCP_PSH;
+  goto tcp_send_noopts;
+#endif /* UIP_TCP_SNDBUF_SIZE > 0 */
   
   /* We jump here when we are ready to send the packet, and just want
      to set the appropriate TCP sequence numbers in the TCP header. */
@@ -2239,10 +2868,20 @@ uip_process(uint8_t flag)
   UIP_TCP_BUF->ackno[2] = uip_connr->rcv_nxt[2];
   UIP_TCP_BUF->ackno[3] = uip_connr->rcv_nxt[3];
   
+#if UIP_TCP_SNDBUF_SIZE > 0
+  /* Segments from the send buffer may start after snd_nxt. */
+  uip_add32(uip_connr->snd_nxt, sndbuf_seqoff);
+  sndbuf_seqoff = 0;
+  UIP_TCP_BUF->seqno[0] = uip_acc32[0];
+  UIP_TCP_BUF->seqno[1] = uip_acc32[1];
+  UIP_TCP_BUF->seqno[2] = uip_acc32[2];
+  UIP_TCP_BUF->seqno[3] = uip_acc32[3];
+#else /* UIP_TCP_SNDBUF_SIZE > 0 */
   UIP_TCP_BUF->seqno[0] = uip_connr->snd_nxt[0];
   UIP_TCP_BUF->seqno[1] = uip_connr->snd_nxt[1];
   UIP_TCP_BUF->seqno[2] = uip_connr->snd_nxt[2];
   UIP_TCP_BUF->seqno[3] = uip_connr->snd_nxt[3];
+#endif /* UIP_TCP_SNDBUF_SIZE > 0 */
 
   UIP_IP_BUF->proto = UIP_PROTO_TCP;
 
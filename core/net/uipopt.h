@@ -302,6 +302,17 @@ void uip_log(char *msg);
 #define UIP_CONF_IPV6_REASSEMBLY      0
 #endif
 
+/**
+ * The number of IPv6 datagrams that can be reassembled at the same time
+ * (default: 1). Each one takes a buffer from the reassembly pool, see
+ * uip-reass.h.
+ */
+#ifdef UIP_CONF_REASS_CONTEXTS
+#define UIP_REASS_CONTEXTS UIP_CONF_REASS_CONTEXTS
+#else
+#define UIP_REASS_CONTEXTS 1
+#endif
+
 #ifndef UIP_CONF_NETIF_MAX_ADDRESSES
 /** Default number of IPv6 addresses associated to the node's interface */
 #define UIP_CONF_NETIF_MAX_ADDRESSES  3
@@ -316,6 +327,18 @@ void uip_log(char *msg);
 /** Minimum number of default routers */
 #define UIP_CONF_DS6_DEFRT_NBU       2
 #endif
+
+/**
+ * Number of IPv6 packet buffers (default: 1). uip_buf always refers
+ * to the active one; additional buffers let control messages be
+ * built and sent while another packet is being processed, see
+ * uip_buf_push().
+ */
+#ifdef UIP_CONF_BUF_POOL_SIZE
+#define UIP_BUF_POOL_SIZE UIP_CONF_BUF_POOL_SIZE
+#else
+#define UIP_BUF_POOL_SIZE 1
+#endif
 /** @} */
 
 /*------------------------------------------------------------------------------*/
@@ -500,6 +523,30 @@ void uip_log(char *msg);
 #define UIP_RECEIVE_WINDOW (UIP_CONF_RECEIVE_WINDOW)
 #endif
 
+/**
+ * The size of the per-connection TCP send buffer, in bytes (IPv6 only).
+ *
+ * With a send buffer, uIP keeps the data an application sends until
+ * the peer has acknowledged it. Several segments may then be in
+ * flight at once, limited by the peer's window and a congestion
+ * window, and lost segments are recovered by uIP itself (fast
+ * retransmit and NewReno-style recovery) instead of by asking the
+ * application to regenerate the data. The application is never
+ * called with UIP_REXMIT, and uip_acked() means that the data from
+ * the previous uip_send() has been taken over by uIP and that there
+ * is room for another uip_mss() bytes.
+ *
+ * Each connection grows by this many bytes. Set to 0 (the default)
+ * to use the classic one-segment-in-flight behaviour.
+ *
+ * \hideinitializer
+ */
+#if defined(UIP_CONF_TCP_SNDBUF_SIZE) && UIP_CONF_IPV6
+#define UIP_TCP_SNDBUF_SIZE (UIP_CONF_TCP_SNDBUF_SIZE)
+#else
+#define UIP_TCP_SNDBUF_SIZE 0
+#endif
+
 /**
  * How long a connection should stay in the TIME_WAIT state.
  *
@@ -619,6 +666,24 @@ void uip_log(char *msg);
 #define UIP_BYTE_ORDER     (UIP_LITTLE_ENDIAN)
 #endif /* UIP_CONF_BYTE_ORDER */
 
+/**
+ * Compute the Internet checksum a machine word at a time.
+ *
+ * The checksum routine then sums 32-bit words into a 64-bit
+ * accumulator and folds the carries once at the end, instead of
+ * checking for a carry after every 16-bit addition. This pays off on
+ * 32- and 64-bit CPUs, but not on 8- and 16-bit ones. It has no
+ * effect when the architecture provides its own checksum functions
+ * (UIP_ARCH_CHKSUM).
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_CHKSUM_WORDWISE
+#define UIP_CHKSUM_WORDWISE (UIP_CONF_CHKSUM_WORDWISE)
+#else /* UIP_CONF_CHKSUM_WORDWISE */
+#define UIP_CHKSUM_WORDWISE 0
+#endif /* UIP_CONF_CHKSUM_WORDWISE */
+
 /** @} */
 /*------------------------------------------------------------------------------*/
 
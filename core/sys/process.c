@@ -44,9 +44,13 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 
 #include "sys/process.h"
 #include "sys/arg.h"
+#if PROCESS_CONF_PROFILE
+#include "sys/clock.h"
+#endif /* PROCESS_CONF_PROFILE */
 
 /*
  * Pointer to the currently running process structure.
@@ -74,6 +78,14 @@ process_num_events_t process_maxevents;
 
 static volatile unsigned char poll_requested;
 
+#if PROCESS_CONF_PROFILE
+uint16_t process_profile_histogram[PROCESS_PROFILE_EVENTS][PROCESS_PROFILE_BUCKETS];
+
+/* Time spent in processes called synchronously from the one that is
+   being timed; it is charged to them and not to their caller. */
+static rtimer_clock_t profile_nested;
+#endif /* PROCESS_CONF_PROFILE */
+
 #define PROCESS_STATE_NONE        0
 #define PROCESS_STATE_RUNNING     1
 #define PROCESS_STATE_CALLED      2
@@ -171,10 +183,58 @@ exit_process(struct process *p, struct process *fromprocess)
   process_current = old_current;
 }
 /*---------------------------------------------------------------------------*/
+#if PROCESS_CONF_PROFILE
+static void
+profile_call(struct process *p, process_event_t ev,
+             rtimer_clock_t elapsed, rtimer_clock_t nested)
+{
+  rtimer_clock_t own;
+  rtimer_clock_t t;
+  unsigned char slot;
+  unsigned char bucket;
+
+  own = elapsed - profile_nested;
+  profile_nested = nested + elapsed;
+
+  p->profile.ticks += own;
+  p->profile.calls++;
+  if(own > p->profile.max) {
+    p->profile.max = own;
+  }
+
+  slot = ev - PROCESS_EVENT_NONE;
+  if(ev < PROCESS_EVENT_NONE || slot >= PROCESS_PROFILE_EVENTS) {
+    slot = PROCESS_PROFILE_EVENTS - 1;
+  }
+  bucket = 0;
+  for(t = own; t >= 4 && bucket < PROCESS_PROFILE_BUCKETS - 1; t >>= 2) {
+    bucket++;
+  }
+  if(process_profile_histogram[slot][bucket] != 0xffff) {
+    process_profile_histogram[slot][bucket]++;
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+process_profile_reset(void)
+{
+  struct process *p;
+
+  for(p = process_list; p != NULL; p = p->next) {
+    memset(&p->profile, 0, sizeof(p->profile));
+  }
+  memset(process_profile_histogram, 0, sizeof(process_profile_histogram));
+}
+#endif /* PROCESS_CONF_PROFILE */
+/*---------------------------------------------------------------------------*/
 static void
 call_process(struct process *p, process_event_t ev, process_data_t data)
 {
   int ret;
+#if PROCESS_CONF_PROFILE
+  rtimer_clock_t start;
+  rtimer_clock_t nested;
+#endif /* PROCESS_CONF_PROFILE */
 
 #if DEBUG
   if(p->state == PROCESS_STATE_CALLED) {
@@ -187,7 +247,15 @@ call_process(struct process *p, process_event_t ev, process_data_t data)
     PRINTF("process: calling process '%s' with event %d\n", PROCESS_NAME_STRING(p), ev);
     process_current = p;
     p->state = PROCESS_STATE_CALLED;
+#if PROCESS_CONF_PROFILE
+    nested = profile_nested;
+    profile_nested = 0;
+    start = RTIMER_NOW();
+#endif /* PROCESS_CONF_PROFILE */
     ret = p->thread(&p->pt, ev, data);
+#if PROCESS_CONF_PROFILE
+    profile_call(p, ev, RTIMER_NOW() - start, nested);
+#endif /* PROCESS_CONF_PROFILE */
     if(ret == PT_EXITED ||
        ret == PT_ENDED ||
        ev == PROCESS_EVENT_EXIT) {
@@ -88,6 +88,38 @@ typedef unsigned char process_num_events_t;
 #define PROCESS_CONF_NUMEVENTS 32
 #endif /* PROCESS_CONF_NUMEVENTS */
 
+/*
+ * With PROCESS_CONF_PROFILE set, every call of a process thread is
+ * timed with the rtimer. Each process is charged for the time spent in
+ * its own thread, excluding processes it calls synchronously, and the
+ * call durations are kept in a histogram per event type.
+ */
+#ifndef PROCESS_CONF_PROFILE
+#define PROCESS_CONF_PROFILE 0
+#endif /* PROCESS_CONF_PROFILE */
+
+#if PROCESS_CONF_PROFILE
+#include "sys/rtimer.h"
+
+/* Events PROCESS_EVENT_NONE and up get a histogram each; the last
+   histogram collects all other events. */
+#ifdef PROCESS_CONF_PROFILE_EVENTS
+#define PROCESS_PROFILE_EVENTS PROCESS_CONF_PROFILE_EVENTS
+#else
+#define PROCESS_PROFILE_EVENTS 16
+#endif
+
+/* Bucket n counts calls that took from 4^n up to 4^(n+1) - 1 ticks;
+   the last bucket counts everything longer. */
+#define PROCESS_PROFILE_BUCKETS 8
+
+struct process_profile {
+  uint32_t ticks;
+  uint32_t calls;
+  rtimer_clock_t max;
+};
+#endif /* PROCESS_CONF_PROFILE */
+
 #define PROCESS_EVENT_NONE            0x80
 #define PROCESS_EVENT_INIT            0x81
 #define PROCESS_EVENT_POLL            0x82
@@ -323,6 +355,9 @@ struct process {
   PT_THREAD((* thread)(struct pt *, process_event_t, process_data_t));
   struct pt pt;
   unsigned char state, needspoll;
+#if PROCESS_CONF_PROFILE
+  struct process_profile profile;
+#endif /* PROCESS_CONF_PROFILE */
 };
 
 /**
@@ -525,6 +560,19 @@ CCIF extern struct process *process_list;
 
 #define PROCESS_LIST() process_list
 
+#if PROCESS_CONF_PROFILE
+/**
+ * Call duration histograms, indexed by event slot and bucket.
+ * Counters stop at 0xffff.
+ */
+extern uint16_t process_profile_histogram[PROCESS_PROFILE_EVENTS][PROCESS_PROFILE_BUCKETS];
+
+/**
+ * Clear the profile of all running processes and the histograms.
+ */
+void process_profile_reset(void);
+#endif /* PROCESS_CONF_PROFILE */
+
 #endif /* PROCESS_H_ */
 
 /** @} */
@@ -56,6 +56,7 @@
 #define REST_RES_BATTERY 0
 #define REST_RES_RADIO 0
 #define REST_RES_MIRROR 0 /* causes largest code size */
+#define REST_RES_STORAGE 0 /* requires CFS and CoAP-13 */
 
 
 
@@ -91,6 +92,9 @@
 #include "er-coap-12.h"
 #elif WITH_COAP == 13
 #include "er-coap-13.h"
+#if REST_RES_STORAGE
+#include "er-coap-13-block.h"
+#endif
 #else
 #warning "Erbium example without CoAP-specifc functionality"
 #endif /* CoAP-specific example */
@@ -364,6 +368,31 @@ chunks_handler(void* request, void* response, uint8_t *buffer, uint16_t preferre
 }
 #endif
 
+/******************************************************************************/
+#if REST_RES_STORAGE && WITH_COAP == 13
+/*
+ * Resources can also stream their representation from, or into, a file instead of generating it chunk by chunk.
+ * A GET is answered blockwise from the file through Block2, a PUT or POST stores a Block1 upload in it.
+ * Block 0 of an upload replaces the previous content; reading in between does not disturb an unfinished upload.
+ */
+RESOURCE(storage, METHOD_GET | METHOD_PUT | METHOD_POST, "test/storage", "title=\"Blockwise storage: GET, PUT/POST\";rt=\"Data\"");
+
+static coap_block_stream_t storage_stream;
+
+void
+storage_handler(void* request, void* response, uint8_t *buffer, uint16_t preferred_size, int32_t *offset)
+{
+  if (REST.get_method_type(request)==METHOD_GET)
+  {
+    coap_block2_stream(&storage_stream, response, buffer, preferred_size, offset);
+  }
+  else
+  {
+    coap_block1_stream(&storage_stream, request, response);
+  }
+}
+#endif
+
 /******************************************************************************/
 #if REST_RES_SEPARATE && defined (PLATFORM_HAS_BUTTON) && WITH_COAP > 3
 /* Required to manually (=not by the engine) handle the response transaction. */
@@ -819,6 +848,10 @@ PROCESS_THREAD(rest_server_example, ev, data)
 #if REST_RES_CHUNKS
   rest_activate_resource(&resource_chunks);
 #endif
+#if REST_RES_STORAGE && WITH_COAP == 13
+  coap_block_stream_init_cfs(&storage_stream, "storage");
+  rest_activate_resource(&resource_storage);
+#endif
 #if REST_RES_PUSHING
   rest_activate_periodic_resource(&periodic_resource_pushing);
 #endif
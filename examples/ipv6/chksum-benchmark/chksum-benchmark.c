@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2026, the smart-HOP contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *         Micro-benchmark of the uIP Internet checksum against the
+ *         original 16-bit-at-a-time routine. Run with
+ *         UIP_CONF_CHKSUM_WORDWISE set to 0 and 1 to compare.
+ */
+
+#include "contiki.h"
+#include "net/uip.h"
+#include "lib/random.h"
+
+#include <stdio.h> /* For printf() */
+
+#ifdef CHKSUM_BENCHMARK_CONF_MAX_LEN
+#define MAX_LEN CHKSUM_BENCHMARK_CONF_MAX_LEN
+#else
+#define MAX_LEN 1280
+#endif
+
+#ifdef CHKSUM_BENCHMARK_CONF_ROUNDS
+#define ROUNDS CHKSUM_BENCHMARK_CONF_ROUNDS
+#else
+#define ROUNDS 10000
+#endif
+
+/* +2 to also measure packets that do not start on a word boundary */
+static uint8_t data[MAX_LEN + 2];
+static const uint16_t lengths[] = { 8, 40, 127, 512, MAX_LEN };
+/*---------------------------------------------------------------------------*/
+/* The routine as it was in uip6.c */
+static uint16_t
+reference_chksum(uint16_t sum, const uint8_t *data, uint16_t len)
+{
+  uint16_t t;
+  const uint8_t *dataptr;
+  const uint8_t *last_byte;
+
+  dataptr = data;
+  last_byte = data + len - 1;
+
+  while(dataptr < last_byte) {
+    t = (dataptr[0] << 8) + dataptr[1];
+    sum += t;
+    if(sum < t) {
+      sum++;
+    }
+    dataptr += 2;
+  }
+
+  if(dataptr == last_byte) {
+    t = (dataptr[0] << 8) + 0;
+    sum += t;
+    if(sum < t) {
+      sum++;
+    }
+  }
+  return sum;
+}
+/*---------------------------------------------------------------------------*/
+PROCESS(chksum_benchmark_process, "Checksum benchmark");
+AUTOSTART_PROCESSES(&chksum_benchmark_process);
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(chksum_benchmark_process, ev, data_ptr)
+{
+  static uint8_t i;
+  static uint8_t offset;
+  static uint16_t len;
+  static uint32_t n;
+  static clock_time_t start, reference, current;
+  static volatile uint16_t sink;
+
+  PROCESS_BEGIN();
+
+  for(n = 0; n < sizeof(data); n++) {
+    data[n] = random_rand();
+  }
+
+  printf("len offset reference current (ticks for %u rounds, %u ticks/s)\n",
+         ROUNDS, CLOCK_SECOND);
+
+  for(i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+    len = lengths[i];
+    for(offset = 0; offset < 2; offset++) {
+      if(uip_chksum((uint16_t *)&data[offset], len) !=
+         uip_htons(reference_chksum(0, &data[offset], len))) {
+        printf("%u %u MISMATCH\n", len, offset);
+        continue;
+      }
+
+      start = clock_time();
+      for(n = 0; n < ROUNDS; n++) {
+        sink += reference_chksum(0, &data[offset], len);
+      }
+      reference = clock_time() - start;
+
+      start = clock_time();
+      for(n = 0; n < ROUNDS; n++) {
+        sink += uip_chksum((uint16_t *)&data[offset], len);
+      }
+      current = clock_time() - start;
+
+      printf("%u %u %lu %lu\n", len, offset,
+             (unsigned long)reference, (unsigned long)current);
+
+      /* Let the rest of the system run between measurements. */
+      PROCESS_PAUSE();
+    }
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -70,6 +70,7 @@ typedef unsigned short uip_stats_t;
 #define UIP_CONF_MAX_LISTENPORTS 40
 #define UIP_CONF_BUFFER_SIZE     420
 #define UIP_CONF_BYTE_ORDER      UIP_LITTLE_ENDIAN
+#define UIP_CONF_CHKSUM_WORDWISE 1
 #define UIP_CONF_TCP       1
 #define UIP_CONF_TCP_SPLIT       0
 #define UIP_CONF_LOGGING         0
@@ -122,11 +123,19 @@ typedef unsigned short uip_stats_t;
 
 #define UIP_CONF_IPV6_CHECKS     1
 #define UIP_CONF_IPV6_QUEUE_PKT  1
-#define UIP_CONF_IPV6_REASSEMBLY 0
+#ifndef UIP_CONF_IPV6_REASSEMBLY
+#define UIP_CONF_IPV6_REASSEMBLY 1
+#endif /* UIP_CONF_IPV6_REASSEMBLY */
+#ifndef UIP_CONF_REASS_CONTEXTS
+#define UIP_CONF_REASS_CONTEXTS  4
+#endif /* UIP_CONF_REASS_CONTEXTS */
 #define UIP_CONF_NETIF_MAX_ADDRESSES  3
 #define UIP_CONF_ND6_MAX_PREFIXES     3
 #define UIP_CONF_ND6_MAX_DEFROUTERS   2
 #define UIP_CONF_ICMP6           1
+#ifndef UIP_CONF_BUF_POOL_SIZE
+#define UIP_CONF_BUF_POOL_SIZE   3
+#endif /* UIP_CONF_BUF_POOL_SIZE */
 
 /* configure number of neighbors and routes */
 #ifndef NBR_TABLE_CONF_MAX_NEIGHBORS
@@ -0,0 +1,274 @@
+/*
+ * Copyright (c) 2026, the smart-HOP contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *	Produce a delta file for Deluge from two versions of an object.
+ *
+ *	Usage: deluge-delta <old object> <new object> <old version>
+ *	                    <new version> <delta file>
+ *
+ *	The delta file is copied into CFS as DELUGE_DELTA_FILE on the
+ *	node that disseminates the new version. See apps/deluge/deluge.h
+ *	for the format.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lib/crc16.h"
+
+/* These must match apps/deluge/deluge.h. */
+#define S_PKT		64
+#define N_PKT		4
+#define S_PAGE		(S_PKT * N_PKT)
+
+#define DELTA_LITERAL	0x80
+#define DELTA_MAX_RUN	128
+#define DELTA_MAX_SIZE	((N_PKT - 1) * S_PKT)
+
+/* Copies are three bytes long, so shorter matches are sent as
+   literals. */
+#define MIN_MATCH	4
+
+/* Bound on the candidates tried per position, to keep long runs of
+   equal bytes from making the search quadratic. */
+#define MAX_TRIES	256
+
+#define HASH_SIZE	65536
+#define HASH(p)		((((p)[0] << 8) ^ ((p)[1] << 5) ^ ((p)[2] << 2) ^ (p)[3]) \
+			 & (HASH_SIZE - 1))
+
+static unsigned char *old, *new;
+static long old_size, new_size;
+static int *hash_head, *hash_next;
+static unsigned char *unchanged;
+
+/*---------------------------------------------------------------------------*/
+static unsigned char *
+read_file(const char *name, long *size, long pad)
+{
+  FILE *fp;
+  unsigned char *buf;
+
+  fp = fopen(name, "rb");
+  if(fp == NULL) {
+    perror(name);
+    exit(1);
+  }
+  fseek(fp, 0, SEEK_END);
+  *size = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+
+  buf = calloc(1, *size + pad);
+  if(buf == NULL || fread(buf, 1, *size, fp) != *size) {
+    fprintf(stderr, "%s: read failed\n", name);
+    exit(1);
+  }
+  fclose(fp);
+  return buf;
+}
+/*---------------------------------------------------------------------------*/
+/* The receiver rewrites its object in place, in page order. While
+   page p is built, the old pages before it may already be replaced,
+   except those that did not change. */
+static int
+readable(long offset, int page)
+{
+  return offset < old_size &&
+    (offset >= (long)page * S_PAGE || unchanged[offset / S_PAGE]);
+}
+/*---------------------------------------------------------------------------*/
+static int
+match_length(const unsigned char *data, int len, int page, long offset)
+{
+  int n;
+
+  for(n = 0; n < len && n < DELTA_MAX_RUN && readable(offset + n, page) &&
+	old[offset + n] == data[n]; n++);
+  return n;
+}
+/*---------------------------------------------------------------------------*/
+static int
+find_match(const unsigned char *data, int len, int page, long same, long *src)
+{
+  long offset;
+  int n, best, tries;
+
+  if(len < MIN_MATCH) {
+    return 0;
+  }
+
+  /* Most code stays where it was, so try the same offset first. */
+  best = match_length(data, len, page, same);
+  *src = same;
+
+  for(offset = hash_head[HASH(data)], tries = 0;
+      offset >= 0 && best < DELTA_MAX_RUN && best < len && tries < MAX_TRIES;
+      offset = hash_next[offset], tries++) {
+    n = match_length(data, len, page, offset);
+    if(n > best) {
+      best = n;
+      *src = offset;
+    }
+  }
+  return best >= MIN_MATCH ? best : 0;
+}
+/*---------------------------------------------------------------------------*/
+static int
+encode_page(int page, unsigned char *out)
+{
+  const unsigned char *data;
+  unsigned short crc;
+  int i, n, len, literal;
+  long src;
+
+  data = &new[(long)page * S_PAGE];
+  crc = crc16_data(data, S_PAGE, 0);
+  out[0] = crc & 0xff;
+  out[1] = crc >> 8;
+  len = 2;
+  literal = -1;
+
+  for(i = 0; i < S_PAGE; i += n) {
+    if(len + 3 > DELTA_MAX_SIZE) {
+      return -1;
+    }
+    n = find_match(&data[i], S_PAGE - i, page, (long)page * S_PAGE + i, &src);
+    if(n > 0) {
+      out[len++] = n - 1;
+      out[len++] = src & 0xff;
+      out[len++] = src >> 8;
+      literal = -1;
+    } else {
+      n = 1;
+      if(literal < 0 || out[literal] == (DELTA_LITERAL | (DELTA_MAX_RUN - 1))) {
+	literal = len;
+	out[len++] = DELTA_LITERAL;
+      } else {
+	out[literal]++;
+      }
+      out[len++] = data[i];
+    }
+  }
+  return len <= DELTA_MAX_SIZE ? len : -1;
+}
+/*---------------------------------------------------------------------------*/
+int
+main(int argc, char **argv)
+{
+  FILE *out;
+  unsigned char header[5], record[2], delta[DELTA_MAX_SIZE + S_PAGE];
+  long i;
+  int npages, page, len;
+  int same = 0, deltas = 0, full = 0, packets = 0;
+
+  if(argc != 6) {
+    fprintf(stderr, "usage: %s <old object> <new object> <old version> "
+	    "<new version> <delta file>\n", argv[0]);
+    return 1;
+  }
+
+  old = read_file(argv[1], &old_size, S_PAGE);
+  new = read_file(argv[2], &new_size, S_PAGE);
+  npages = (new_size + S_PAGE - 1) / S_PAGE;
+  if(new_size > 0xffff || old_size > 0xffff || npages > 255) {
+    fprintf(stderr, "Objects must be smaller than 64 kB\n");
+    return 1;
+  }
+
+  /* Old pages beyond the end of the old object hold undefined data on
+     the nodes, so only whole pages can be reused as they are. */
+  unchanged = calloc(1, (old_size + S_PAGE - 1) / S_PAGE + 1);
+  for(page = 0; page < npages; page++) {
+    if((long)(page + 1) * S_PAGE <= old_size &&
+       memcmp(&old[(long)page * S_PAGE], &new[(long)page * S_PAGE],
+	      S_PAGE) == 0) {
+      unchanged[page] = 1;
+    }
+  }
+
+  hash_head = malloc(HASH_SIZE * sizeof(int));
+  hash_next = malloc((old_size + 1) * sizeof(int));
+  for(i = 0; i < HASH_SIZE; i++) {
+    hash_head[i] = -1;
+  }
+  for(i = old_size - MIN_MATCH; i >= 0; i--) {
+    hash_next[i] = hash_head[HASH(&old[i])];
+    hash_head[HASH(&old[i])] = i;
+  }
+
+  out = fopen(argv[5], "wb");
+  if(out == NULL) {
+    perror(argv[5]);
+    return 1;
+  }
+  header[0] = 'D';
+  header[1] = 'L';
+  header[2] = atoi(argv[3]);
+  header[3] = atoi(argv[4]);
+  header[4] = npages;
+  if(header[2] == 0 || header[3] <= header[2]) {
+    fprintf(stderr, "The new version must be above the old, nonzero version\n");
+    return 1;
+  }
+  fwrite(header, 1, sizeof(header), out);
+
+  for(page = 0; page < npages; page++) {
+    record[0] = page;
+    if(unchanged[page]) {
+      record[1] = 0;
+      fwrite(record, 1, sizeof(record), out);
+      same++;
+      continue;
+    }
+    len = encode_page(page, delta);
+    if(len < 0) {
+      full++;
+      packets += N_PKT;
+      continue;
+    }
+    record[1] = len;
+    fwrite(record, 1, sizeof(record), out);
+    fwrite(delta, 1, len, out);
+    deltas++;
+    packets += (len + S_PKT - 1) / S_PKT;
+  }
+  fclose(out);
+
+  fprintf(stderr, "%d pages: %d unchanged, %d delta, %d full; "
+	  "%d of %d packets\n", npages, same, deltas, full,
+	  packets, npages * N_PKT);
+  return 0;
+}
+/*---------------------------------------------------------------------------*/